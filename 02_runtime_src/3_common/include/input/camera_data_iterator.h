@@ -9,9 +9,14 @@
 #ifndef _INPUT_CAMERA_DATA_ITERATOR_H_
 #define _INPUT_CAMERA_DATA_ITERATOR_H_
 
+#include <atomic>
 #include <string>
+#include <thread>
+#include <vector>
 
 #include "data_iterator.h"
+#include "input/frame_record.h"
+#include "utils/blocking_queue.h"
 
 class CameraDataIterator : public DataIterator {
  public:
@@ -27,7 +32,11 @@ class CameraDataIterator : public DataIterator {
    *            "vio_cfg": "hb_vio_720P.json",
    *            "cam_index": 0,
    *            "cam_port": 0,
-   *            "frame_count": -1 # -1 represent infinite
+   *            "frame_count": -1, # -1 represent infinite
+   *            "record_file": "camera.rec", # record frames for replay
+   *                                         # iterator, optional
+   *            "frame_policy": "latest", # see DataIterator::Init
+   *            "max_age_ms": 100
    *        }
    * @param[in] config_string: config string
    *        same as config_file
@@ -58,11 +67,24 @@ class CameraDataIterator : public DataIterator {
    */
   bool HasNext();
 
-  ~CameraDataIterator() {}
+  ~CameraDataIterator();
 
  private:
   int LoadConfig(std::string &config_string);
 
+  /**
+   * Get one frame from the camera, block until it is captured
+   * @param[out] image_tensor: image tensor holding the camera buffer
+   * @return false if failed
+   */
+  bool Grab(ImageTensor *image_tensor);
+
+  void GrabLoop();
+
+  bool SupportFramePolicy() { return true; }
+
+  bool TryNextReady(std::vector<ImageTensor *> image_tensors);
+
  private:
   BPUCameraHandle cam_handle_;
   std::string cam_cfg_ = "";
@@ -71,6 +93,12 @@ class CameraDataIterator : public DataIterator {
   int cam_port_ = 0;
   int frame_count_ = -1;
   int count_ = 0;
+  std::string record_file_ = "";
+  FrameRecordWriter recorder_;
+  // Grabbed frames when a frame policy is set, nullptr marks grab failure
+  BlockingQueue<ImageTensor *> grab_queue_;
+  std::thread grab_thread_;
+  std::atomic<bool> stop_{false};
 };
 
 #endif  // _INPUT_CAMERA_DATA_ITERATOR_H_
@@ -9,6 +9,7 @@
 #ifndef _INPUT_DATA_ITERATOR_H
 #define _INPUT_DATA_ITERATOR_H
 
+#include <atomic>
 #include <fstream>
 #include <iostream>
 #include <string>
@@ -16,6 +17,24 @@
 
 #include "input/input_data.h"
 
+// How live sources hand out frames when downstream falls behind
+enum class FramePolicy {
+  // Process every frame in order
+  EVERY,
+  // Skip to the newest frame the source has ready
+  LATEST,
+  // Skip frames received more than max_age_ms ago
+  MAX_AGE
+};
+
+/**
+ * Parse frame policy name
+ * @param[in] name: every, latest or max_age
+ * @param[out] policy: frame policy
+ * @return 0 if success
+ */
+int parse_frame_policy(const std::string &name, FramePolicy *policy);
+
 class DataIterator {
  public:
   explicit DataIterator(std::string module_name) : module_name_(module_name) {}
@@ -23,7 +42,13 @@ class DataIterator {
   /**
    * Init Data iterator from file
    * @param[in] config_file: config file path
-   *            the config file should be in json format
+   *            the config file should be in json format,
+   *            live sources also take a frame policy, for example:
+   *            {
+   *                "frame_policy": "max_age", # every (default), latest
+   *                                           # or max_age
+   *                "max_age_ms": 100
+   *            }
    * @param[in] config_string: config string
    *            same as config_file
    * @return 0 if success
@@ -66,20 +91,72 @@ class DataIterator {
    */
   static DataIterator *GetImpl(const std::string &module_name);
 
-  virtual ~DataIterator() {}
+  /**
+   * Frames dropped by frame policy
+   * @return statistics string
+   */
+  std::string FramePolicyStatistics();
+
+  virtual ~DataIterator();
 
  protected:
   virtual int LoadConfig(std::string &config_string) { return 0; }
 
+  /**
+   * Whether the source implements TryNextReady for frame policies
+   */
+  virtual bool SupportFramePolicy() { return false; }
+
+  /**
+   * Take a frame only if the source already has one ready
+   * @param[out] image_tensors: one image tensor per modality
+   * @return false if no frame is ready
+   */
+  virtual bool TryNextReady(std::vector<ImageTensor *> image_tensors) {
+    return false;
+  }
+
+  /**
+   * Skip frames by frame policy, skipped frames are released at once
+   * @param[in|out] image_tensors: frame from the source, replaced by
+   *                the frame to hand out
+   * @return false if the frame is dropped and no newer one is ready
+   */
+  bool ApplyFramePolicy(std::vector<ImageTensor *> image_tensors);
+
+  /**
+   * Count a frame the source evicted before ApplyFramePolicy saw it,
+   * as dropped to latest, dropped as stale or dropped on overflow
+   * following the frame policy
+   * @param[in] image_tensor: evicted frame
+   */
+  void CountEvicted(const ImageTensor &image_tensor);
+
  private:
   int LoadConfigFile(std::string &config_file);
 
+  int LoadFramePolicy(std::string &config_string);
+
+  /**
+   * Whether the frame is older than max_age_ms by max_age frame policy
+   * @param[in] image_tensor: frame
+   * @return true if stale
+   */
+  bool IsStale(const ImageTensor &image_tensor);
+
  private:
   std::string module_name_;
 
  protected:
   bool is_finish_ = false;
   int last_frame_id = -1;
+  FramePolicy frame_policy_ = FramePolicy::EVERY;
+  uint64_t max_age_us_ = 0;
+  // Updated by source threads as well
+  std::atomic<int64_t> latest_dropped_count_{0};
+  std::atomic<int64_t> stale_dropped_count_{0};
+  // Evicted by a full source buffer while still fresh
+  std::atomic<int64_t> overflow_dropped_count_{0};
 };
 
 #endif  // _INPUT_DATA_ITERATOR_H
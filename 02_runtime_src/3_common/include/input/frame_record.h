@@ -0,0 +1,124 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Recorded NV12 camera stream. Little endian layout:
+//   FrameRecordHeader
+//   (FrameHeader, Y plane, UV plane) per frame
+// Planes are stored with rows of `stride` bytes, the same layout as NV12 and
+// NV12_SEPARATE tensors from prepare_image_tensor, so frames are read
+// straight into tensor memory.
+
+#ifndef _INPUT_FRAME_RECORD_H_
+#define _INPUT_FRAME_RECORD_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "bpu_predict_extension.h"
+
+// "X3FR"
+#define FRAME_RECORD_MAGIC (0x52463358)
+#define FRAME_RECORD_VERSION (1)
+
+struct FrameRecordHeader {
+  uint32_t magic;
+  uint32_t version;
+  int32_t width;
+  int32_t height;
+  int32_t stride;
+  int32_t reserved[3];
+};
+
+struct FrameHeader {
+  // Capture time in microseconds
+  uint64_t timestamp;
+  uint32_t size;
+  uint32_t reserved;
+};
+
+static_assert(sizeof(FrameRecordHeader) == 32, "FrameRecordHeader changed");
+static_assert(sizeof(FrameHeader) == 16, "FrameHeader changed");
+
+class FrameRecordWriter {
+ public:
+  /**
+   * Create record file
+   * @param[in] path: record file
+   * @param[in] width: image width
+   * @param[in] height: image height
+   * @return 0 if success
+   */
+  int Open(const std::string &path, int width, int height);
+
+  bool IsOpen() { return ofs_.is_open(); }
+
+  /**
+   * Append one frame
+   * @param[in] timestamp: capture time in microseconds
+   * @param[in] y: Y plane
+   * @param[in] y_step: row step of Y plane
+   * @param[in] uv: interleaved UV plane
+   * @param[in] uv_step: row step of UV plane
+   * @return 0 if success
+   */
+  int Write(uint64_t timestamp,
+            const uint8_t *y,
+            int y_step,
+            const uint8_t *uv,
+            int uv_step);
+
+  void Close();
+
+  ~FrameRecordWriter() { Close(); }
+
+ private:
+  std::ofstream ofs_;
+  FrameRecordHeader header_;
+  std::vector<char> padding_;
+};
+
+class FrameRecordReader {
+ public:
+  /**
+   * Open record file and read its header
+   * @param[in] path: record file
+   * @return 0 if success
+   */
+  int Open(const std::string &path);
+
+  const FrameRecordHeader &Header() { return header_; }
+
+  /**
+   * Read timestamps of all frames, the reader is rewound afterwards
+   * @param[out] timestamps: capture time of every frame
+   * @return 0 if success
+   */
+  int ReadTimestamps(std::vector<uint64_t> *timestamps);
+
+  /**
+   * Read next frame into tensor memory, data first and data_ext after
+   * @param[out] timestamp: capture time in microseconds
+   * @param[out] tensor: tensor prepared with the record size
+   * @return 0 if success, -1 at the end of record or on error
+   */
+  int Read(uint64_t *timestamp, BPU_TENSOR_S *tensor);
+
+  /**
+   * Go back to the first frame
+   */
+  void Rewind();
+
+ private:
+  std::string path_;
+  std::ifstream ifs_;
+  FrameRecordHeader header_;
+};
+
+#endif  // _INPUT_FRAME_RECORD_H_
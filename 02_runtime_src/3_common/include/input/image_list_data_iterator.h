@@ -12,6 +12,7 @@
 #include <string>
 
 #include "data_iterator.h"
+#include "input/image_prefetcher.h"
 
 class ImageListDataIterator : public DataIterator {
  public:
@@ -24,9 +25,16 @@ class ImageListDataIterator : public DataIterator {
    *        for example:
    *        {
    *            "image_list_file" : "image_list.txt" #  one image file per line
+   *                                                 # first one if ; separated
    *            "width": 214,
    *            "height": 214,
-   *            "data_type": 2
+   *            "data_type": 2,
+   *            "tensor_pool": true, # recycle input tensors, optional
+   *            "resize_mode": "letterbox", # stretch (default) or letterbox
+   *            "prefetch_depth": 8, # lines decoded ahead, 0 (default) to
+   *                                 # decode in Next
+   *            "decode_threads": 4, # decoder threads of prefetch
+   *            "jpeg_decoder": "turbojpeg" # opencv (default) or turbojpeg
    *        }
    * @param[in] config_string: config string
    *        same as config_file
@@ -63,11 +71,7 @@ class ImageListDataIterator : public DataIterator {
   int LoadConfig(std::string &config_string);
 
  private:
-  std::string image_list_file_;
-  std::ifstream ifs_;
-  int width_;
-  int height_;
-  hb_BPU_DATA_TYPE_E data_type_ = BPU_TYPE_IMG_YUV444;
+  ImageListLoader loader_;
 };
 
 #endif  // _INPUT_IMAGE_LIST_ITERATOR_H_
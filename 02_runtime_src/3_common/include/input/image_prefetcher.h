@@ -0,0 +1,219 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Read-ahead image loading. Decoder threads read up to `prefetch_depth`
+// entries of an image list ahead of the consumer and preprocess every image
+// of an entry as a separate task, frames are handed out in list order.
+// ImageListLoader puts it together with the list file & image decoding
+// shared by the image list iterators.
+
+#ifndef _INPUT_IMAGE_PREFETCHER_H_
+#define _INPUT_IMAGE_PREFETCHER_H_
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "input/input_data.h"
+#include "utils/tensor_utils.h"
+
+class ImagePrefetcher {
+ public:
+  /**
+   * Read next entry of the list, called with the prefetcher lock held
+   * @param[out] paths: image paths of the entry, one per modality
+   * @return false if no more entry
+   */
+  typedef std::function<bool(std::vector<std::string> *paths)> Reader;
+
+  /**
+   * Load one image to frame, called on decoder threads
+   * @param[in] path: image path
+   * @param[in] index: index of the image in its entry (modality)
+   * @param[out] frame: image tensor, nothing to release if failed
+   * @return 0 if success
+   */
+  typedef std::function<int(
+      const std::string &path, int index, ImageTensor *frame)>
+      Loader;
+
+  /**
+   * Release a frame that is loaded but never handed out
+   * @param[in] frame: image tensor
+   */
+  typedef std::function<void(ImageTensor *frame)> Releaser;
+
+  ImagePrefetcher() {}
+
+  /**
+   * Init prefetcher and start decoder threads
+   * @param[in] prefetch_depth: max entries read ahead
+   * @param[in] decode_threads: decoder thread count
+   * @param[in] reader: list reader
+   * @param[in] loader: image loader
+   * @param[in] releaser: frame releaser
+   * @return 0 if success
+   */
+  int Init(int prefetch_depth,
+           int decode_threads,
+           Reader reader,
+           Loader loader,
+           Releaser releaser);
+
+  /**
+   * Next entry in list order, block until it is loaded,
+   * entries failed to load are skipped
+   * @param[out] frames: frames of the entry, one per path
+   * @return false if list is finished
+   */
+  bool Next(std::vector<ImageTensor> *frames);
+
+  /**
+   * Stop decoder threads and release frames not handed out
+   */
+  void Stop();
+
+  ~ImagePrefetcher();
+
+ private:
+  struct Entry {
+    std::vector<std::string> paths;
+    std::vector<ImageTensor> frames;
+    std::vector<bool> loaded;
+    // Frames not loaded yet
+    int pending = 0;
+  };
+
+  struct Task {
+    std::shared_ptr<Entry> entry;
+    int index = 0;
+  };
+
+  void DecodeLoop();
+
+  /**
+   * Read next entry into tasks_ if read ahead is allowed,
+   * called with lock held
+   */
+  void ReadAhead();
+
+ private:
+  uint64_t prefetch_depth_ = 1;
+  Reader reader_;
+  Loader loader_;
+  Releaser releaser_;
+  std::vector<std::thread> threads_;
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  // Read entries by sequence, erased once handed out
+  std::map<uint64_t, std::shared_ptr<Entry>> entries_;
+  // Images to load, oldest entry first
+  std::deque<Task> tasks_;
+  uint64_t read_seq_ = 0;
+  uint64_t next_seq_ = 0;
+  bool list_end_ = false;
+  bool stop_ = false;
+};
+
+/**
+ * Image list reading & loading shared by the image list iterators,
+ * every line holds one image path per modality separated by ;
+ */
+class ImageListLoader {
+ public:
+  ImageListLoader() {}
+
+  /**
+   * Parse the keys shared by the image list iterators: image_list_file,
+   * width, height, data_type, tensor_pool, resize_mode, prefetch_depth,
+   * decode_threads & jpeg_decoder
+   * @param[in] config_string: json config
+   * @return 0 if success
+   */
+  int LoadConfig(const std::string &config_string);
+
+  /**
+   * Open image list & create tensor pool, prefetch starts with the first Next
+   * @param[in] color_modes: decoding of every modality, BGR if absent
+   * @return 0 if success
+   */
+  int Init(const std::vector<ColorMode> &color_modes);
+
+  /**
+   * Load images of the next line, one per image tensor. The images of a line
+   * are loaded concurrently. The first images of a line with more images are
+   * taken, a line with fewer images finishes the list.
+   * @param[out] image_tensors: image tensors, one per modality
+   * @param[out] is_finish: set if the list is finished
+   * @return false if no data
+   */
+  bool Next(const std::vector<ImageTensor *> &image_tensors, bool *is_finish);
+
+  /**
+   * Release image tensor
+   * @param[in] image_tensor: image tensor
+   */
+  void Release(ImageTensor *image_tensor);
+
+  ~ImageListLoader();
+
+ private:
+  /**
+   * Read next non-empty line of image list
+   * @param[in] image_num: images taken from the line
+   * @param[out] paths: first image_num paths of the line
+   * @return false if list is finished or the line has fewer images
+   */
+  bool ReadEntry(int image_num, std::vector<std::string> *paths);
+
+  /**
+   * Read & preprocess one image into a new image tensor
+   * @param[in] path: image path
+   * @param[in] modality: index of the image in its line
+   * @param[out] image_tensor: image tensor
+   * @return 0 if success
+   */
+  int LoadImage(const std::string &path,
+                int modality,
+                ImageTensor *image_tensor);
+
+  /**
+   * Start decoder threads reading image_num images of every line
+   * @param[in] image_num: images per line
+   * @return 0 if success
+   */
+  int StartPrefetch(int image_num);
+
+ private:
+  std::string image_list_file_;
+  std::ifstream ifs_;
+  int width_ = 0;
+  int height_ = 0;
+  hb_BPU_DATA_TYPE_E data_type_ = BPU_TYPE_IMG_YUV444;
+  bool enable_tensor_pool_ = false;
+  std::unique_ptr<TensorPool> tensor_pool_;
+  ResizeMode resize_mode_ = ResizeMode::STRETCH;
+  bool use_turbojpeg_ = false;
+  std::vector<ColorMode> color_modes_;
+  int prefetch_depth_ = 0;
+  int decode_threads_ = 2;
+  // Images per line of the prefetcher, fixed by the first Next
+  int prefetch_image_num_ = 0;
+  std::unique_ptr<ImagePrefetcher> prefetcher_;
+  bool extra_image_warned_ = false;
+};
+
+#endif  // _INPUT_IMAGE_PREFETCHER_H_
@@ -21,6 +21,9 @@ typedef struct ImageTensor {
   int32_t frame_id = 0;
   int32_t cam_id = 0;
   uint64_t timestamp = 0;
+  // Host time (Stopwatch::CurrentTs) the source received the frame,
+  // 0 if unknown, frame policies measure frame age from it
+  uint64_t receive_ts = 0;
   std::string image_name;
   int ori_image_width;
   int ori_image_height;
@@ -10,8 +10,10 @@
 #define _INPUT_MUTIL_MODAL_IMAGE_LIST_ITERATOR_H_
 
 #include <string>
+#include <vector>
 
 #include "data_iterator.h"
+#include "input/image_prefetcher.h"
 
 class MutilModalImageListDataIterator : public DataIterator {
  public:
@@ -26,7 +28,16 @@ class MutilModalImageListDataIterator : public DataIterator {
    *            "image_list_file" : "image_list.txt" #  one image file per line
    *            "width": 214,
    *            "height": 214,
-   *            "data_type": 2
+   *            "data_type": 2,
+   *            "tensor_pool": true, # recycle input tensors, optional
+   *            "resize_mode": "letterbox", # stretch (default) or letterbox
+   *            "prefetch_depth": 2, # pairs loaded ahead, 0 (default) to
+   *                                 # load in Next, the two images of a
+   *                                 # pair are loaded concurrently either way
+   *            "decode_threads": 2, # loader threads if prefetching
+   *            "jpeg_decoder": "turbojpeg", # opencv (default) or turbojpeg
+   *            "color_modes": ["bgr", "gray"] # decoding of visible & lwir,
+   *                                           # bgr (default), gray or raw16
    *        }
    * @param[in] config_string: config string
    *        same as config_file
@@ -63,11 +74,8 @@ class MutilModalImageListDataIterator : public DataIterator {
   int LoadConfig(std::string &config_string);
 
  private:
-  std::string image_list_file_;
-  std::ifstream ifs_;
-  int width_;
-  int height_;
-  hb_BPU_DATA_TYPE_E data_type_ = BPU_TYPE_IMG_YUV444;
+  ImageListLoader loader_;
+  std::vector<ColorMode> color_modes_;
 };
 
 #endif  // _INPUT_IMAGE_LIST_ITERATOR_H_
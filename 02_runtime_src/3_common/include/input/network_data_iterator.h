@@ -9,38 +9,157 @@
 #ifndef _INPUT_NETWORK_ITERATOR_H_
 #define _INPUT_NETWORK_ITERATOR_H_
 
-#include <deque>
+#include <atomic>
+#include <memory>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "input/data_iterator.h"
 #include "protocol/zmq_msg.pb.h"
+#include "utils/blocking_queue.h"
+#include "utils/tensor_utils.h"
 #include "zmq.h"
 
-enum ReceiverStatus { OK = 0, TIMEOUT = -1, FINISHED = -2 };
+enum ReceiverStatus { OK = 0, TIMEOUT = -1, FINISHED = -2, INVALID = -3 };
+
+// What the receiver thread does when the frame queue is full
+enum class OverflowPolicy {
+  // Wait for the consumer, senders block on zmq high water mark
+  BLOCK,
+  // Drop the oldest queued frame
+  DROP_OLDEST,
+  // Drop the frame just received
+  DROP_NEWEST
+};
+
+/**
+ * Parse overflow policy name
+ * @param[in] name: block, drop_oldest or drop_newest
+ * @param[out] policy: overflow policy
+ * @return 0 if success
+ */
+int parse_overflow_policy(const std::string &name, OverflowPolicy *policy);
+
+// Every zmq message part is a serialized ZMQMessage::ZMQMsg. A multi modal
+// frame is sent as one multipart message with an IMAGE_MSG part per modality,
+// visible first and lwir second, the parts get one frame id & timestamp.
+// A message may start with a 16 byte frame header part, "HBFH", int32 frame
+// id and uint64 capture timestamp in us, little endian; the images then get
+// the sender frame id & timestamp instead of a local id & the receive time.
 class NetworkReceiver {
  public:
   NetworkReceiver();
 
   ~NetworkReceiver();
 
+  /**
+   * Bind socket and start receiver thread
+   * @param[in] end_point: zmq endpoint
+   * @return true if success
+   */
   bool Init(const char *end_point);
 
-  void SetDataType(hb_BPU_DATA_TYPE_E data_type);
+  /**
+   * Set tensor data types
+   * @param[in] data_type: data type of single images & visible images
+   * @param[in] lwir_data_type: data type of lwir images of pairs
+   */
+  void SetDataType(hb_BPU_DATA_TYPE_E data_type,
+                   hb_BPU_DATA_TYPE_E lwir_data_type);
+
+  /**
+   * Set frame queue, should be called before Init
+   * @param[in] queue_depth: max frames received ahead of the consumer,
+   *            also the zmq receive high water mark
+   * @param[in] overflow_policy: policy when the queue is full
+   */
+  void SetQueue(int queue_depth, OverflowPolicy overflow_policy);
 
-  int RecvImage(ImageTensor &image_tensor);
+  /**
+   * Next received frame, block until one is available
+   * @param[out] image_tensors: one image tensor per message part
+   * @return OK, FINISHED, or INVALID if the part count does not match
+   */
+  int NextImages(std::vector<ImageTensor *> image_tensors);
+
+  /**
+   * Received frame if one is queued, never block
+   * @param[out] image_tensors: one image tensor per message part
+   * @return OK, FINISHED, INVALID, or TIMEOUT if no frame is queued
+   */
+  int TryNextImages(std::vector<ImageTensor *> image_tensors);
+
+  /**
+   * Release image tensor from NextImages
+   * @param[in] image_tensor: image tensor
+   */
+  void Release(ImageTensor *image_tensor);
+
+  /**
+   * Queued & dropped frame counters
+   * @return statistics string
+   */
+  std::string Statistics();
 
   void Fini();
 
  private:
-  int Recv();
+  // Images of one multipart message, one part per modality
+  typedef std::vector<ImageTensor> Frame;
+
+  void RecvLoop();
+
+  /**
+   * Receive all parts of one message
+   * @param[out] frame: one image per part, empty if failed
+   * @return ReceiverStatus
+   */
+  int RecvFrame(Frame *frame);
+
+  /**
+   * Parse one message part into image_tensor
+   * @param[in] msg: zmq message part
+   * @param[in] data_type: tensor data type
+   * @param[out] image_tensor: image tensor, nothing to release if failed
+   * @return ReceiverStatus
+   */
+  int ParseImage(zmq_msg_t *msg,
+                 hb_BPU_DATA_TYPE_E data_type,
+                 ImageTensor *image_tensor);
+
+  /**
+   * Queue frame following the overflow policy
+   * @param[in] frame: received frame
+   */
+  void Enqueue(Frame *frame);
+
+  /**
+   * Hand out a dequeued frame
+   * @param[in] frame: dequeued frame, released if the part count mismatches
+   * @param[out] image_tensors: image tensors
+   * @return OK or INVALID
+   */
+  int TakeFrame(Frame *frame, std::vector<ImageTensor *> image_tensors);
+
+  void ReleaseFrame(Frame *frame);
 
  private:
   void *socket_recv_;
   void *zmq_context_;
-  std::deque<zmq_msg_t *> buf_queue_;
-  zmq_msg_t *zmq_msg_;
   hb_BPU_DATA_TYPE_E data_type_ = BPU_TYPE_IMG_YUV444;
+  hb_BPU_DATA_TYPE_E lwir_data_type_ = BPU_TYPE_IMG_YUV444;
+  int queue_depth_ = 8;
+  OverflowPolicy overflow_policy_ = OverflowPolicy::BLOCK;
+  // Received frames, nullptr marks the finish message
+  BlockingQueue<Frame *> frame_queue_;
+  // Finish message has been dequeued
+  bool finished_ = false;
+  std::unique_ptr<TensorPool> tensor_pool_;
+  std::thread recv_thread_;
+  std::atomic<bool> stop_{false};
+  std::atomic<int64_t> queued_count_{0};
+  std::atomic<int64_t> dropped_count_{0};
 };
 
 class NetworkDataIterator : public DataIterator {
@@ -53,7 +172,16 @@ class NetworkDataIterator : public DataIterator {
    *        the config file should be in the json format
    *        for example:
    *        {
-   *            "endpoint":  "tcp://*:6680"
+   *            "endpoint":  "tcp://*:6680",
+   *            "data_type": 1,
+   *            "lwir_data_type": 0, # lwir images of pairs, optional,
+   *                                 # same as data_type by default
+   *            "queue_depth": 8, # frames received ahead of inference,
+   *                              # also the zmq receive high water mark
+   *            "overflow_policy": "block", # block (default), drop_oldest
+   *                                        # or drop_newest
+   *            "frame_policy": "latest", # see DataIterator::Init
+   *            "max_age_ms": 100
    *        }
    * @param[in] config_string: config string
    *        same as config_file
@@ -67,11 +195,13 @@ class NetworkDataIterator : public DataIterator {
    * @return 0 if success
    */
   bool Next(ImageTensor *image_tensor);
-   /**
-
-  support mutil modal get
-  */
-  bool Next(ImageTensor *visible_image_tensor,ImageTensor *lwir_image_tensor);
+  /**
+   * Next visible & lwir image pair, sent as a two part message
+   * @param[out] visible_image_tensor: visible image tensor
+   * @param[out] lwir_image_tensor: lwir image tensor
+   * @return 0 if success
+   */
+  bool Next(ImageTensor *visible_image_tensor, ImageTensor *lwir_image_tensor);
   /**
    * Release image_tensor
    * @param[in] image_tensor: image tensor to be released
@@ -89,10 +219,24 @@ class NetworkDataIterator : public DataIterator {
  private:
   int LoadConfig(std::string &config_string);
 
+  /**
+   * Next message with one part per image tensor, mismatched ones are dropped
+   * @param[out] image_tensors: image tensors
+   * @return false if finished
+   */
+  bool NextFrame(std::vector<ImageTensor *> image_tensors);
+
+  bool SupportFramePolicy() { return true; }
+
+  bool TryNextReady(std::vector<ImageTensor *> image_tensors);
+
  private:
   NetworkReceiver *network_receiver_;
   std::string endpoint = "tcp://*:6680";
   hb_BPU_DATA_TYPE_E data_type_ = BPU_TYPE_IMG_YUV444;
+  int lwir_data_type_ = -1;
+  int queue_depth_ = 8;
+  OverflowPolicy overflow_policy_ = OverflowPolicy::BLOCK;
 };
 
 #endif  // _INPUT_NETWORK_ITERATOR_H_
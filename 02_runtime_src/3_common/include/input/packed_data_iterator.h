@@ -0,0 +1,79 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#ifndef _INPUT_PACKED_DATA_ITERATOR_H_
+#define _INPUT_PACKED_DATA_ITERATOR_H_
+
+#include <memory>
+#include <string>
+
+#include "data_iterator.h"
+#include "input/packed_dataset.h"
+#include "utils/tensor_utils.h"
+
+class PackedDataIterator : public DataIterator {
+ public:
+  PackedDataIterator() : DataIterator("packed_data_iterator") {}
+
+  /**
+   * Init packed data iterator from file
+   * @param[in] config_file: config file
+   *        config file should be in the json format
+   *        for example:
+   *        {
+   *            "pack_file": "val.pack",
+   *            "data_type": 2,
+   *            "read_ahead": 8 # records hinted to kernel ahead, optional
+   *        }
+   *        the `pack_file` is written by tools/pack_tools/pack_dataset.py,
+   *        records are preprocessed images or features
+   * @param[in] config_string: config string
+   *        same as config file
+   * @return 0 if success
+   */
+  int Init(std::string config_file, std::string config_string);
+
+  /**
+   * Next record of pack
+   * @param[out] image_tensor: image tensor
+   * @return 0 if success
+   */
+  bool Next(ImageTensor *image_tensor);
+
+  /**
+   * Not supported, packs hold one modality
+   */
+  bool Next(ImageTensor *visible_image_tensor, ImageTensor *lwir_image_tensor);
+
+  /**
+   * Release image_tensor
+   * @param[in] image_tensor: image tensor to be released
+   */
+  void Release(ImageTensor *image_tensor);
+
+  /**
+   * Check if has next record
+   * @return 0 if finish
+   */
+  bool HasNext();
+
+  ~PackedDataIterator();
+
+ private:
+  int LoadConfig(std::string &config_string);
+
+ private:
+  std::string pack_file_;
+  hb_BPU_DATA_TYPE_E data_type_ = BPU_TYPE_IMG_YUV444;
+  int read_ahead_ = 8;
+  PackedDataset dataset_;
+  int cursor_ = 0;
+  std::unique_ptr<TensorPool> tensor_pool_;
+};
+
+#endif  // _INPUT_PACKED_DATA_ITERATOR_H_
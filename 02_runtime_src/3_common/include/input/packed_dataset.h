@@ -0,0 +1,115 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Packed dataset, all preprocessed images or features of an eval set in one
+// file, written by tools/pack_tools/pack_dataset.py. Little endian layout:
+//   PackedHeader
+//   record data, every record aligned to PACKED_RECORD_ALIGN
+//   PackedRecord x record_count, at header.index_offset
+
+#ifndef _INPUT_PACKED_DATASET_H_
+#define _INPUT_PACKED_DATASET_H_
+
+#include <cstdint>
+#include <string>
+
+// "X3PK"
+#define PACKED_DATASET_MAGIC (0x4b503358)
+#define PACKED_DATASET_VERSION (2)
+#define PACKED_RECORD_ALIGN (64)
+#define PACKED_MAX_DIMS (8)
+#define PACKED_NAME_SIZE (128)
+
+// PackedRecord flags
+// Image is resized keeping aspect ratio and padded, like PadResizeTransformer
+#define PACKED_FLAG_PAD_RESIZE (1 << 0)
+
+enum PackedKind {
+  // dims: [dst_h, dst_w], same as {name}_{org_h}_{org_w}_{dst_h}_{dst_w}.bin
+  PACKED_KIND_IMAGE = 0,
+  // dims: feature shape, same as {name}_{dim0}_{dim1}_{...}.bin
+  PACKED_KIND_FEATURE = 1,
+};
+
+struct PackedHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t kind;
+  uint32_t record_count;
+  uint64_t index_offset;
+  uint64_t reserved[5];
+};
+
+struct PackedRecord {
+  uint64_t offset;
+  uint64_t size;
+  int32_t ori_height;
+  int32_t ori_width;
+  int32_t ndim;
+  int32_t dims[PACKED_MAX_DIMS];
+  // Null terminated
+  char name[PACKED_NAME_SIZE];
+  // PACKED_FLAG_*
+  int32_t flags;
+};
+
+static_assert(sizeof(PackedHeader) == 64, "PackedHeader layout changed");
+static_assert(sizeof(PackedRecord) == 192, "PackedRecord layout changed");
+
+/**
+ * Read only mmap of a packed dataset
+ */
+class PackedDataset {
+ public:
+  PackedDataset() {}
+
+  /**
+   * Map pack file and check header & index
+   * @param[in] path: pack file
+   * @return 0 if success
+   */
+  int Open(const std::string &path);
+
+  int Kind() const { return header_->kind; }
+
+  int Count() const { return header_->record_count; }
+
+  const PackedRecord &Record(int index) const { return records_[index]; }
+
+  const uint8_t *Data(int index) const {
+    return base_ + records_[index].offset;
+  }
+
+  /**
+   * Ask kernel to read records ahead
+   * @param[in] index: first record
+   * @param[in] count: record count
+   */
+  void WillNeed(int index, int count);
+
+  /**
+   * Drop pages only used by records before index
+   * @param[in] index: first record still needed
+   */
+  void DontNeed(int index);
+
+  void Close();
+
+  ~PackedDataset();
+
+ private:
+  int fd_ = -1;
+  uint8_t *base_ = nullptr;
+  size_t size_ = 0;
+  const PackedHeader *header_ = nullptr;
+  const PackedRecord *records_ = nullptr;
+  // Pages before it have been dropped
+  size_t dropped_ = 0;
+};
+
+#endif  // _INPUT_PACKED_DATASET_H_
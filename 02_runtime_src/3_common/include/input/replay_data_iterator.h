@@ -0,0 +1,122 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Replay a recorded camera stream in real time. A replay thread emits frames
+// at their recorded cadence into a few buffers like a camera does, the oldest
+// buffer is overwritten when downstream does not keep up.
+
+#ifndef _INPUT_REPLAY_DATA_ITERATOR_H_
+#define _INPUT_REPLAY_DATA_ITERATOR_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "data_iterator.h"
+#include "input/frame_record.h"
+#include "utils/blocking_queue.h"
+#include "utils/tensor_utils.h"
+
+class ReplayDataIterator : public DataIterator {
+ public:
+  ReplayDataIterator() : DataIterator("replay_data_iterator") {}
+
+  /**
+   * Init replay data iterator
+   * @param[in] config_file: config file
+   *        the file content should be in the json format
+   *        for example:
+   *        {
+   *            "record_file": "camera.rec", # recorded by camera iterator
+   *            "data_type": 8, # NV12_SEPARATE (default) or NV12
+   *            "speed": 1.0, # cadence multiplier, 0 to replay as fast as
+   *                          # downstream consumes without dropping
+   *            "buffer_count": 3, # frames buffered before dropping
+   *            "late_ms": 0, # frames consumed later than this after
+   *                          # emission are late, 0 for one frame interval
+   *            "loop": false,
+   *            "frame_count": -1, # -1 represent infinite
+   *            "frame_policy": "latest", # see DataIterator::Init
+   *            "max_age_ms": 100
+   *        }
+   * @param[in] config_string: config string
+   *        same as config_file
+   * @return 0 if success
+   */
+  int Init(std::string config_file, std::string config_string);
+
+  /**
+   * Next emitted frame, block until one is available
+   * @param[out] image_tensor: image tensor
+   * @return 0 if success
+   */
+  bool Next(ImageTensor *image_tensor);
+
+  /**
+   * Not supported, records hold one camera
+   */
+  bool Next(ImageTensor *visible_image_tensor, ImageTensor *lwir_image_tensor);
+
+  /**
+   * Release image_tensor
+   * @param[in] image_tensor: image tensor to be released
+   */
+  void Release(ImageTensor *image_tensor);
+
+  /**
+   * Check if has next image
+   * @return false if finish
+   */
+  bool HasNext();
+
+  ~ReplayDataIterator();
+
+ private:
+  int LoadConfig(std::string &config_string);
+
+  void ReplayLoop();
+
+  bool SupportFramePolicy() { return true; }
+
+  bool TryNextReady(std::vector<ImageTensor *> image_tensors);
+
+  /**
+   * Emitted, consumed, late & dropped frame counters
+   * @return statistics string
+   */
+  std::string Statistics();
+
+ private:
+  std::string record_file_;
+  hb_BPU_DATA_TYPE_E data_type_ = BPU_TYPE_IMG_NV12_SEPARATE;
+  float speed_ = 1.0;
+  int buffer_count_ = 3;
+  int late_ms_ = 0;
+  bool loop_ = false;
+  int frame_count_ = -1;
+  int count_ = 0;
+
+  FrameRecordReader reader_;
+  // Lateness threshold in microseconds
+  uint64_t late_us_ = 0;
+  std::unique_ptr<TensorPool> tensor_pool_;
+  // Emitted frames, nullptr marks the end of record
+  BlockingQueue<ImageTensor *> frame_queue_;
+  // End of record has been dequeued
+  bool end_of_record_ = false;
+  std::thread replay_thread_;
+  std::atomic<bool> stop_{false};
+  std::atomic<int64_t> emitted_count_{0};
+  std::atomic<int64_t> dropped_count_{0};
+  int64_t late_count_ = 0;
+  uint64_t max_delay_us_ = 0;
+};
+
+#endif  // _INPUT_REPLAY_DATA_ITERATOR_H_
@@ -0,0 +1,143 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Video file input. A decoder thread reads every `frame_stride`-th frame of
+// the video(s), converts it into a pooled tensor and queues up to
+// `buffer_count` frames ahead of the consumer. The mutil modal variant reads
+// a visible and a lwir video in lockstep.
+
+#ifndef _INPUT_VIDEO_DATA_ITERATOR_H_
+#define _INPUT_VIDEO_DATA_ITERATOR_H_
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "data_iterator.h"
+#include "opencv2/opencv.hpp"
+#include "utils/blocking_queue.h"
+#include "utils/tensor_utils.h"
+
+class VideoDataIterator : public DataIterator {
+ public:
+  /**
+   * @param[in] mutil_modal: read visible & lwir video pairs
+   */
+  explicit VideoDataIterator(bool mutil_modal = false)
+      : DataIterator(mutil_modal ? "mutil_modal_video_data_iterator"
+                                 : "video_data_iterator"),
+        mutil_modal_(mutil_modal) {}
+
+  /**
+   * Init video data iterator
+   * @param[in] config_file: config file
+   *        the file content should be in the json format
+   *        for example:
+   *        {
+   *            "video_file": "visible.mp4",
+   *            "lwir_video_file": "lwir.mp4", # mutil modal only
+   *            "width": 640,
+   *            "height": 384,
+   *            "data_type": 1, # NV12 by default
+   *            "resize_mode": "letterbox", # stretch (default) or letterbox
+   *            "color_modes": ["bgr", "gray"], # decoding of visible & lwir,
+   *                                            # bgr (default), gray or raw16
+   *            "start_frame": 0, # first frame to read
+   *            "frame_stride": 1, # read one frame of every frame_stride
+   *            "buffer_count": 4, # frames decoded ahead of the consumer
+   *            "frame_count": -1 # -1 represent infinite
+   *        }
+   * @param[in] config_string: config string
+   *        same as config_file
+   * @return 0 if success
+   */
+  int Init(std::string config_file, std::string config_string);
+
+  /**
+   * Next decoded frame, block until it is converted
+   * @param[out] image_tensor: image tensor
+   * @return 0 if success
+   */
+  bool Next(ImageTensor *image_tensor);
+
+  /**
+   * Next visible & lwir frame pair of the mutil modal variant
+   * @param[out] visible_image_tensor: visible image tensor
+   * @param[out] lwir_image_tensor: lwir image tensor
+   * @return 0 if success
+   */
+  bool Next(ImageTensor *visible_image_tensor, ImageTensor *lwir_image_tensor);
+
+  /**
+   * Release image_tensor
+   * @param[in] image_tensor: image tensor to be released
+   */
+  void Release(ImageTensor *image_tensor);
+
+  /**
+   * Check if has next image
+   * @return false if finish
+   */
+  bool HasNext();
+
+  ~VideoDataIterator();
+
+ private:
+  // Images of one video position, one per video
+  typedef std::vector<ImageTensor> Frame;
+
+  int LoadConfig(std::string &config_string);
+
+  void DecodeLoop();
+
+  /**
+   * Decode the next sampled frame of every video
+   * @param[out] frame: one image per video
+   * @return false at the end of any video
+   */
+  bool DecodeFrame(Frame *frame);
+
+  /**
+   * Next frame from decoder thread
+   * @param[out] image_tensors: one image tensor per video
+   * @return false if no data
+   */
+  bool NextFrame(std::vector<ImageTensor *> image_tensors);
+
+  void ReleaseFrame(Frame *frame);
+
+ private:
+  bool mutil_modal_ = false;
+  std::string video_file_;
+  std::string lwir_video_file_;
+  int width_ = 0;
+  int height_ = 0;
+  hb_BPU_DATA_TYPE_E data_type_ = BPU_TYPE_IMG_YUV_NV12;
+  ResizeMode resize_mode_ = ResizeMode::STRETCH;
+  // Color mode of each video, BGR if not set
+  std::vector<ColorMode> color_modes_;
+  int start_frame_ = 0;
+  int frame_stride_ = 1;
+  int buffer_count_ = 4;
+  int frame_count_ = -1;
+  int count_ = 0;
+
+  std::vector<cv::VideoCapture> captures_;
+  std::vector<std::string> video_names_;
+  // Position of the last frame read in the videos, -1 before the first
+  int64_t position_ = -1;
+  std::unique_ptr<TensorPool> tensor_pool_;
+  // Decoded frames, nullptr marks the end of video
+  BlockingQueue<Frame *> frame_queue_;
+  std::thread decode_thread_;
+  std::atomic<bool> stop_{false};
+};
+
+#endif  // _INPUT_VIDEO_DATA_ITERATOR_H_
@@ -57,8 +57,19 @@ class ClientOutputModule : public OutputModule {
   ~ClientOutputModule();
 
  private:
+  // Times Serialize without a network sender, see bench_common.cc
+  friend class ClientOutputBenchmark;
+
   int LoadConfig(std::string &config_string);
 
+  /**
+   * Serialize image info & perception into meta protobuf
+   * @param[in] image_tensor: Image tensor
+   * @param[in] perception: perception data
+   * @param[out] pb: serialized meta, release by delete[]
+   * @param[out] pb_length: length of pb
+   * @return 0 if success
+   */
   int Serialize(ImageTensor *image_tensor,
                 Perception *perception,
                 char **pb,
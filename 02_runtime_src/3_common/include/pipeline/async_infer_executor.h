@@ -0,0 +1,93 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Non-blocking BPU submission. Up to `task_depth` tasks are kept in flight,
+// a completion thread waits them in submission order and hands the finished
+// frame to the callback.
+
+#ifndef _PIPELINE_ASYNC_INFER_EXECUTOR_H_
+#define _PIPELINE_ASYNC_INFER_EXECUTOR_H_
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "bpu_predict_extension.h"
+#include "utils/blocking_queue.h"
+#include "utils/tensor_utils.h"
+
+struct PipelineFrame;
+
+class AsyncInferExecutor {
+ public:
+  /**
+   * Called on the completion thread once a frame is done
+   * @param[in] frame: frame with output tensors filled
+   * @param[in] ret_code: 0 if success, else BPU error code
+   */
+  typedef std::function<void(PipelineFrame *frame, int ret_code)> Callback;
+
+  AsyncInferExecutor() {}
+
+  /**
+   * Init executor and start completion thread
+   * @param[in] bpu_model: loaded model
+   * @param[in] core_num: BPU core (1 for single core, 2 for dual core)
+   * @param[in] task_depth: max in-flight task count
+   * @param[in] callback: completion callback
+   * @param[in] output_pool: take output tensors from pool if not null
+   * @return 0 if success
+   */
+  int Init(BPU_MODEL_S *bpu_model,
+           int core_num,
+           int task_depth,
+           Callback callback,
+           TensorPool *output_pool = nullptr);
+
+  /**
+   * Submit one frame, block while `task_depth` tasks are in flight
+   * @param[in] frame: frame with inputs filled
+   * @return 0 if success, the callback is not called if submission failed
+   */
+  int Submit(PipelineFrame *frame);
+
+  /**
+   * Wait every in-flight task and stop completion thread
+   */
+  void Finish();
+
+  ~AsyncInferExecutor();
+
+ private:
+  struct Task {
+    PipelineFrame *frame = nullptr;
+    BPU_TASK_HANDLE task_handle{};
+    std::vector<BPU_TENSOR_S> input_tensors;
+  };
+
+  void CompletionLoop();
+
+ private:
+  BPU_MODEL_S *bpu_model_ = nullptr;
+  BPU_RUN_CTRL_S run_ctrl_s_{1};
+  int task_depth_ = 1;
+  Callback callback_;
+  TensorPool *output_pool_ = nullptr;
+
+  // Submitted tasks in submission order
+  BlockingQueue<Task *> task_queue_;
+  std::thread completion_thread_;
+
+  std::mutex mutex_;
+  std::condition_variable slot_cv_;
+  int in_flight_ = 0;
+};
+
+#endif  // _PIPELINE_ASYNC_INFER_EXECUTOR_H_
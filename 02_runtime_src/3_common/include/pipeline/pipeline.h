@@ -0,0 +1,166 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Multi-threaded runner: input -> inference -> post process -> output.
+// Every stage runs on its own thread(s) and talks to the next one through a
+// bounded queue, the output stage restores the input order before writing.
+
+#ifndef _PIPELINE_PIPELINE_H_
+#define _PIPELINE_PIPELINE_H_
+
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "base/perception_common.h"
+#include "bpu_predict_extension.h"
+#include "input/data_iterator.h"
+#include "input/input_data.h"
+#include "output/output.h"
+#include "pipeline/async_infer_executor.h"
+#include "pipeline/tensor_capture.h"
+#include "post_process/post_process.h"
+#include "utils/blocking_queue.h"
+#include "utils/stop_watch.h"
+#include "utils/tensor_utils.h"
+
+/**
+ * Pipeline settings
+ */
+struct PipelineConfig {
+  // Max frames buffered between two stages
+  int queue_size = 4;
+  // 1 for single input model, 2 for visible + lwir model
+  int modality_num = 1;
+  // Threads calling HB_BPU_runModel
+  int infer_thread_num = 1;
+  // Threads calling PostProcessModule::PostProcess, each thread owns one
+  // post process module since the modules are not reentrant
+  int post_process_thread_num = 1;
+  // BPU core (1 for single core, 2 for dual core)
+  int core_num = 1;
+  // Max in-flight BPU tasks, submit without blocking if more than 1
+  int task_depth = 1;
+  // Recycle output tensors instead of allocating for every frame
+  bool enable_tensor_pool = true;
+  bool enable_post_process = true;
+  // Write output tensors of every frame for replay_postprocess if not empty
+  std::string capture_file;
+};
+
+/**
+ * Everything belongs to one frame while it goes through the pipeline
+ */
+struct PipelineFrame {
+  // Sequence number assigned by the input stage
+  int64_t seq = 0;
+  std::vector<ImageTensor> inputs;
+  std::vector<BPU_TENSOR_S> output_tensors;
+  Perception perception;
+  // Stage timestamps (microseconds)
+  u_int64_t input_start_ts = 0;
+  u_int64_t input_end_ts = 0;
+  u_int64_t infer_start_ts = 0;
+  u_int64_t infer_end_ts = 0;
+  u_int64_t post_process_start_ts = 0;
+  u_int64_t post_process_end_ts = 0;
+};
+
+class Pipeline {
+ public:
+  Pipeline() {}
+
+  /**
+   * Init pipeline, the modules should have been initialized
+   * @param[in] bpu_model: loaded model
+   * @param[in] data_iterator: input module
+   * @param[in] post_process_modules: one post process module per post
+   *            process thread, may be empty if post process is disabled
+   * @param[in] output_module: output module
+   * @param[in] config: pipeline settings
+   * @return 0 if success
+   */
+  int Init(BPU_MODEL_S *bpu_model,
+           DataIterator *data_iterator,
+           const std::vector<PostProcessModule *> &post_process_modules,
+           OutputModule *output_module,
+           const PipelineConfig &config);
+
+  /**
+   * Run until the data iterator is finished and every frame is written
+   * @return 0 if success
+   */
+  int Run();
+
+  /**
+   * Stage statistics
+   * @return statistics string
+   */
+  std::string Statistics();
+
+  ~Pipeline() {}
+
+ private:
+  void InputLoop();
+
+  void InferLoop();
+
+  void PostProcessLoop(PostProcessModule *post_process_module);
+
+  void OutputLoop();
+
+  int Infer(PipelineFrame *frame);
+
+  void WriteFrame(PipelineFrame *frame);
+
+  TensorPool *OutputPool() {
+    return config_.enable_tensor_pool ? &output_pool_ : nullptr;
+  }
+
+ private:
+  BPU_MODEL_S *bpu_model_ = nullptr;
+  DataIterator *data_iterator_ = nullptr;
+  std::vector<PostProcessModule *> post_process_modules_;
+  OutputModule *output_module_ = nullptr;
+  PipelineConfig config_;
+
+  // Output tensor buffers, used if enable_tensor_pool
+  TensorPool output_pool_;
+
+  // Used if task_depth > 1
+  AsyncInferExecutor async_executor_;
+
+  // Used if capture_file is set, only touched by the output thread
+  TensorCaptureWriter capture_writer_;
+
+  BlockingQueue<PipelineFrame *> infer_queue_;
+  BlockingQueue<PipelineFrame *> post_process_queue_;
+  BlockingQueue<PipelineFrame *> output_queue_;
+
+  // Running thread count of the stage, the last one closes the next queue
+  std::atomic<int> infer_running_{0};
+  std::atomic<int> post_process_running_{0};
+
+  // Frames arrived at output stage out of order
+  std::map<int64_t, PipelineFrame *> reorder_buffer_;
+  int64_t next_output_seq_ = 0;
+  int64_t frame_count_ = 0;
+
+  // Only touched by the output thread
+  Stopwatch input_watch_;
+  Stopwatch infer_watch_;
+  Stopwatch post_process_watch_;
+  Stopwatch whole_watch_;
+  Stopwatch output_watch_;
+  // Wall time of Run()
+  Stopwatch run_watch_;
+};
+
+#endif  // _PIPELINE_PIPELINE_H_
@@ -0,0 +1,137 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Model outputs of a pipeline run, replayed through post process modules
+// offline. Little endian layout:
+//   CaptureHeader
+//   per frame:
+//     CaptureFrameHeader, image name
+//     CaptureTensorHeader of the input tensor (no data)
+//     (CaptureTensorHeader, aligned data) per output tensor
+
+#ifndef _PIPELINE_TENSOR_CAPTURE_H_
+#define _PIPELINE_TENSOR_CAPTURE_H_
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "bpu_predict_extension.h"
+#include "input/input_data.h"
+
+// "X3TC"
+#define TENSOR_CAPTURE_MAGIC (0x43543358)
+#define TENSOR_CAPTURE_VERSION (1)
+#define TENSOR_CAPTURE_MAX_DIM (8)
+
+struct CaptureHeader {
+  uint32_t magic;
+  uint32_t version;
+  int32_t output_num;
+  int32_t reserved;
+};
+
+struct CaptureFrameHeader {
+  int32_t frame_id;
+  int32_t cam_id;
+  uint64_t timestamp;
+  int32_t ori_image_width;
+  int32_t ori_image_height;
+  int32_t is_pad_resize;
+  uint32_t name_size;
+};
+
+struct CaptureShape {
+  int32_t layout;
+  int32_t ndim;
+  int32_t d[TENSOR_CAPTURE_MAX_DIM];
+};
+
+struct CaptureTensorHeader {
+  int32_t data_type;
+  uint32_t data_size;
+  CaptureShape data_shape;
+  CaptureShape aligned_shape;
+};
+
+static_assert(sizeof(CaptureHeader) == 16, "CaptureHeader changed");
+static_assert(sizeof(CaptureFrameHeader) == 32, "CaptureFrameHeader changed");
+static_assert(sizeof(CaptureTensorHeader) == 88, "CaptureTensorHeader changed");
+
+/**
+ * One captured frame, output tensor data lives in host memory
+ */
+struct CaptureFrame {
+  // Input tensor has shapes only, data is not captured
+  ImageTensor image_tensor;
+  std::vector<BPU_TENSOR_S> output_tensors;
+  std::vector<std::vector<char>> output_data;
+};
+
+class TensorCaptureWriter {
+ public:
+  /**
+   * Create capture file
+   * @param[in] path: capture file
+   * @param[in] output_num: model output count
+   * @return 0 if success
+   */
+  int Open(const std::string &path, int output_num);
+
+  bool IsOpen() { return ofs_.is_open(); }
+
+  /**
+   * Append one frame, output tensors are invalidated before reading
+   * @param[in] image_tensor: first input of the frame
+   * @param[in] output_tensors: model outputs
+   * @return 0 if success
+   */
+  int Write(ImageTensor &image_tensor,
+            std::vector<BPU_TENSOR_S> &output_tensors);
+
+  void Close();
+
+  ~TensorCaptureWriter() { Close(); }
+
+ private:
+  void WriteTensor(const BPU_TENSOR_S &tensor, uint32_t data_size);
+
+ private:
+  std::ofstream ofs_;
+  int output_num_ = 0;
+};
+
+class TensorCaptureReader {
+ public:
+  /**
+   * Open capture file and read its header
+   * @param[in] path: capture file
+   * @return 0 if success
+   */
+  int Open(const std::string &path);
+
+  int OutputNum() { return header_.output_num; }
+
+  /**
+   * Read next frame, tensor memory points into frame->output_data
+   * @param[out] frame: captured frame
+   * @return 0 if success, -1 at the end of capture or on error
+   */
+  int Read(CaptureFrame *frame);
+
+ private:
+  int ReadTensor(BPU_TENSOR_S *tensor, std::vector<char> *data);
+
+ private:
+  std::string path_;
+  std::ifstream ifs_;
+  CaptureHeader header_;
+};
+
+#endif  // _PIPELINE_TENSOR_CAPTURE_H_
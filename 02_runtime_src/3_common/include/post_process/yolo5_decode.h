@@ -0,0 +1,92 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Decode one YOLOv5 output head into detections.
+// `yolo5_decode` rejects anchors by objectness in logit space with SIMD
+// (NEON / AVX2 / SSE2, scalar fallback) before touching class scores,
+// `yolo5_decode_reference` is the original per-anchor implementation.
+
+#ifndef _POST_PROCESS_YOLO5_DECODE_H_
+#define _POST_PROCESS_YOLO5_DECODE_H_
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "base/perception_common.h"
+#include "bpu_predict_extension.h"
+#include "input/input_data.h"
+
+/**
+ * Decode parameters of one output head
+ */
+struct Yolo5DecodeParam {
+  // Feature map size
+  int height = 0;
+  int width = 0;
+  int stride = 8;
+  const std::vector<std::pair<double, double>> *anchors = nullptr;
+  int class_num = 0;
+  const std::vector<std::string> *class_names = nullptr;
+  float score_threshold = 0.001;
+  // Model input -> original image mapping
+  double w_ratio = 1.0;
+  double h_ratio = 1.0;
+  double w_padding = 0.0;
+  double h_padding = 0.0;
+  int ori_width = 0;
+  int ori_height = 0;
+};
+
+/**
+ * Fill feature map size & coordinate mapping of decode param
+ * @param[in] tensor: output tensor of the head
+ * @param[in] frame: input image tensor
+ * @param[out] param: decode param
+ * @return 0 if success
+ */
+int yolo5_decode_param(BPU_TENSOR_S *tensor,
+                       ImageTensor *frame,
+                       Yolo5DecodeParam *param);
+
+/**
+ * Reference decode, sigmoid & argmax for every anchor
+ * @param[in] data: head output, [h, w, anchor, 5 + class_num] float
+ * @param[in] param: decode param
+ * @param[out] dets: detections appended
+ */
+void yolo5_decode_reference(const float *data,
+                            const Yolo5DecodeParam &param,
+                            std::vector<Detection> &dets);
+
+/**
+ * Decode with objectness rejection in logit space,
+ * class argmax & box math are only done on survivors
+ * @param[in] data: head output, [h, w, anchor, 5 + class_num] float
+ * @param[in] param: decode param
+ * @param[out] dets: detections appended
+ */
+void yolo5_decode(const float *data,
+                  const Yolo5DecodeParam &param,
+                  std::vector<Detection> &dets);
+
+/**
+ * SIMD instruction set used by yolo5_decode
+ * @return one of neon, avx2, sse2, scalar
+ */
+const char *yolo5_decode_isa();
+
+/**
+ * Parse decode implementation name
+ * @param[in] name: one of simd, reference
+ * @param[out] reference: true if yolo5_decode_reference is selected
+ * @return 0 if success
+ */
+int parse_decode_impl(const std::string &name, bool *reference);
+
+#endif  // _POST_PROCESS_YOLO5_DECODE_H_
@@ -9,6 +9,7 @@
 #ifndef _POST_PROCESS_MUTIL_MODAL_YOLO5_POST_PROCESS_H_
 #define _POST_PROCESS_MUTIL_MODAL_YOLO5_POST_PROCESS_H_
 
+#include <memory>
 #include <string>
 #include <utility>
 #include <vector>
@@ -16,6 +17,8 @@
 #include "base/perception_common.h"
 #include "bpu_predict_extension.h"
 #include "post_process.h"
+#include "utils/nms.h"
+#include "utils/thread_pool.h"
 
 /**
  * Config definition for Yolo5
@@ -42,6 +45,10 @@ class Yolo5MutilModalPostProcessModule : public PostProcessModule {
    *        "score_threshold": 0.3,
    *        "nms_threshold": 0.45,
    *        "nms_top_k": 500,
+   *        "decode_impl": "simd", # or "reference", optional
+   *        "nms_impl": "default", # or "grid", "simd", optional
+   *        "parallel_decode": false, # decode heads on a thread pool, optional
+   *        "decode_threads": 3, # worker threads of parallel decode, optional
    *        "yolov5": {
    *            "strides": ...
    *            "anchors_table": ...
@@ -76,6 +83,13 @@ class Yolo5MutilModalPostProcessModule : public PostProcessModule {
   float score_threshold_ = 0.001;
   float nms_threshold_ = 0.65;
   int nms_top_k_ = 5000;
+  // Use yolo5_decode_reference instead of yolo5_decode
+  bool reference_decode_ = false;
+  NmsImpl nms_impl_ = NmsImpl::DEFAULT;
+  // Decode the visible & lwir heads in parallel
+  bool parallel_decode_ = false;
+  int decode_threads_ = 3;
+  std::unique_ptr<ThreadPool> decode_pool_;
 };
 
 #endif  // _POST_PROCESS_YOLO5_POST_PROCESS_H_
@@ -16,6 +16,7 @@
 #include "base/perception_common.h"
 #include "bpu_predict_extension.h"
 #include "post_process.h"
+#include "utils/nms.h"
 
 /**
  * Config definition for Yolo5
@@ -78,6 +79,8 @@ class Yolo5PostProcessModule : public PostProcessModule {
    *        "score_threshold": 0.3,
    *        "nms_threshold": 0.45,
    *        "nms_top_k": 500,
+   *        "decode_impl": "simd", # or "reference", optional
+   *        "nms_impl": "default", # or "grid", "simd", optional
    *        "yolov5": {
    *            "strides": ...
    *            "anchors_table": ...
@@ -113,6 +116,9 @@ class Yolo5PostProcessModule : public PostProcessModule {
   float score_threshold_ = 0.001;
   float nms_threshold_ = 0.65;
   int nms_top_k_ = 5000;
+  // Use yolo5_decode_reference instead of yolo5_decode
+  bool reference_decode_ = false;
+  NmsImpl nms_impl_ = NmsImpl::DEFAULT;
 };
 
 #endif  // _POST_PROCESS_YOLO5_POST_PROCESS_H_
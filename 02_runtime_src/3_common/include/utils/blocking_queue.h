@@ -0,0 +1,153 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Bounded blocking FIFO used to hand frames between threads. `Push` blocks
+// while the queue is full and `Pop` blocks while it is empty, `Close` wakes
+// up every waiter so that stages can shut down in order. Producers that must
+// not block use `TryPush` or `PushEvictOldest` instead.
+
+#ifndef _UTILS_BLOCKING_QUEUE_H_
+#define _UTILS_BLOCKING_QUEUE_H_
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+template <typename T>
+class BlockingQueue {
+ public:
+  explicit BlockingQueue(size_t capacity = 1)
+      : capacity_(capacity > 0 ? capacity : 1) {}
+
+  /**
+   * Set max queue size, should be called before any push
+   * @param[in] capacity: max element count
+   */
+  void SetCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity > 0 ? capacity : 1;
+  }
+
+  /**
+   * Push an element, block while the queue is full
+   * @param[in] value: element
+   * @return false if the queue has been closed
+   */
+  bool Push(const T &value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_full_.wait(lock, [this] { return closed_ || queue_.size() < capacity_; });
+    if (closed_) {
+      return false;
+    }
+    queue_.push_back(value);
+    not_empty_.notify_one();
+    return true;
+  }
+
+  /**
+   * Push an element without blocking
+   * @param[in] value: element
+   * @return false if the queue is full or has been closed
+   */
+  bool TryPush(const T &value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_ || queue_.size() >= capacity_) {
+      return false;
+    }
+    queue_.push_back(value);
+    not_empty_.notify_one();
+    return true;
+  }
+
+  /**
+   * Push an element, evict the oldest element if the queue is full
+   * @param[in] value: element
+   * @param[out] evicted: evicted element, or value itself if the queue
+   *             has been closed
+   * @return true if an element is evicted
+   */
+  bool PushEvictOldest(const T &value, T *evicted) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (closed_) {
+      *evicted = value;
+      return true;
+    }
+    bool is_evicted = false;
+    if (queue_.size() >= capacity_) {
+      *evicted = queue_.front();
+      queue_.pop_front();
+      is_evicted = true;
+    }
+    queue_.push_back(value);
+    not_empty_.notify_one();
+    return is_evicted;
+  }
+
+  /**
+   * Pop an element, block while the queue is empty
+   * @param[out] value: element
+   * @return false if the queue has been closed and drained
+   */
+  bool Pop(T *value) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    not_empty_.wait(lock, [this] { return closed_ || !queue_.empty(); });
+    if (queue_.empty()) {
+      return false;
+    }
+    *value = queue_.front();
+    queue_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  /**
+   * Pop an element without blocking
+   * @param[out] value: element
+   * @return false if the queue is empty
+   */
+  bool TryPop(T *value) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (queue_.empty()) {
+      return false;
+    }
+    *value = queue_.front();
+    queue_.pop_front();
+    not_full_.notify_one();
+    return true;
+  }
+
+  /**
+   * Close the queue, pending elements can still be popped
+   */
+  void Close() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    closed_ = true;
+    not_empty_.notify_all();
+    not_full_.notify_all();
+  }
+
+  bool IsClosed() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return closed_;
+  }
+
+  size_t Size() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size();
+  }
+
+ private:
+  std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::deque<T> queue_;
+  size_t capacity_;
+  bool closed_ = false;
+};
+
+#endif  // _UTILS_BLOCKING_QUEUE_H_
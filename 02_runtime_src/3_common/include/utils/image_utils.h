@@ -18,6 +18,118 @@
 #include "opencv2/imgproc.hpp"
 #include "utils.h"
 
+/**
+ * Luma of a BGR pixel, same as BGR2YUV_I420
+ * @param[in] b: blue
+ * @param[in] g: green
+ * @param[in] r: red
+ * @return Y
+ */
+uint8_t bgr_to_luma(uint8_t b, uint8_t g, uint8_t r);
+
+/**
+ * Resize BGR image and convert it to NV12 in one pass, written to the Y & UV
+ * planes directly with two resized rows as the only intermediate buffers.
+ * Uses the fixed-point bilinear coefficients of cv::resize (INTER_LINEAR)
+ * and the BT.601 coefficients of cv::cvtColor (BGR2YUV_I420), but it is not
+ * bit-exact with them: cv::resize switches to INTER_AREA for exact 2x
+ * downscales, and its SIMD paths may round differently
+ * @param[in] bgr: BGR data
+ * @param[in] src_width: source width
+ * @param[in] src_height: source height
+ * @param[in] src_step: source bytes per row
+ * @param[in] dst_width: destination width
+ * @param[in] dst_height: destination height
+ * @param[out] y: Y plane
+ * @param[in] y_stride: Y plane bytes per row
+ * @param[out] uv: interleaved UV plane
+ * @param[in] uv_stride: UV plane bytes per row
+ */
+void resize_bgr_to_nv12(const uint8_t *bgr,
+                        int src_width,
+                        int src_height,
+                        int src_step,
+                        int dst_width,
+                        int dst_height,
+                        uint8_t *y,
+                        int y_stride,
+                        uint8_t *uv,
+                        int uv_stride);
+
+/**
+ * Region of the resized image in a letterbox (pad resize) output,
+ * same as PadResizeTransformer of the mapper: scaled by the smaller ratio,
+ * truncated and centered
+ * @param[in] src_width: source width
+ * @param[in] src_height: source height
+ * @param[in] dst_width: output width
+ * @param[in] dst_height: output height
+ * @return resized image region in output
+ */
+cv::Rect letterbox_rect(int src_width,
+                        int src_height,
+                        int dst_width,
+                        int dst_height);
+
+/**
+ * Letterbox BGR image and convert it to NV12 in one pass, the border is
+ * filled with BGR pad_value
+ * @param[in] bgr: BGR data
+ * @param[in] src_width: source width
+ * @param[in] src_height: source height
+ * @param[in] src_step: source bytes per row
+ * @param[in] dst_width: destination width
+ * @param[in] dst_height: destination height
+ * @param[in] pad_value: BGR value of border
+ * @param[out] y: Y plane
+ * @param[in] y_stride: Y plane bytes per row
+ * @param[out] uv: interleaved UV plane
+ * @param[in] uv_stride: UV plane bytes per row
+ */
+void letterbox_bgr_to_nv12(const uint8_t *bgr,
+                           int src_width,
+                           int src_height,
+                           int src_step,
+                           int dst_width,
+                           int dst_height,
+                           uint8_t pad_value,
+                           uint8_t *y,
+                           int y_stride,
+                           uint8_t *uv,
+                           int uv_stride);
+
+/**
+ * Resize planar YUV420 (e.g. decoded JPEG) into region roi of an NV12 image,
+ * the rest is filled with BGR pad_value converted to YUV
+ * @param[in] planes: Y, U & V planes
+ * @param[in] strides: bytes per row of every plane
+ * @param[in] src_width: source width
+ * @param[in] src_height: source height
+ * @param[in] full_range: source is full range (JPEG), converted to
+ *            studio range
+ * @param[in] roi: region of the image in output
+ * @param[in] pad_value: BGR value of border
+ * @param[in] dst_width: destination width
+ * @param[in] dst_height: destination height
+ * @param[out] y: Y plane
+ * @param[in] y_stride: Y plane bytes per row
+ * @param[out] uv: interleaved UV plane
+ * @param[in] uv_stride: UV plane bytes per row
+ */
+void yuv420p_to_nv12(const uint8_t *const planes[3],
+                     const int strides[3],
+                     int src_width,
+                     int src_height,
+                     bool full_range,
+                     const cv::Rect &roi,
+                     uint8_t pad_value,
+                     int dst_width,
+                     int dst_height,
+                     uint8_t *y,
+                     int y_stride,
+                     uint8_t *uv,
+                     int uv_stride);
+
 /**
  * Convert BGR to NV12
  * @param[in] bgr
@@ -0,0 +1,55 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// JPEG decoding with TurboJPEG. The image is downscaled in the DCT domain
+// (1/2, 1/4 or 1/8) when it is much larger than the model input, and
+// 4:2:0 JPEGs are decoded to YUV planes and written to NV12 tensors
+// without a BGR round-trip.
+
+#ifndef _UTILS_JPEG_UTILS_H_
+#define _UTILS_JPEG_UTILS_H_
+
+#include <string>
+
+#include "bpu_predict_extension.h"
+#include "utils/tensor_utils.h"
+
+/**
+ * Largest DCT scaling denominator keeping the decoded image at least
+ * as large as required
+ * @param[in] src_width: JPEG width
+ * @param[in] src_height: JPEG height
+ * @param[in] min_width: min decoded width
+ * @param[in] min_height: min decoded height
+ * @return 1, 2, 4 or 8
+ */
+int jpeg_scale_denom(int src_width,
+                     int src_height,
+                     int min_width,
+                     int min_height);
+
+/**
+ * Same as read_image_tensor but decode with TurboJPEG,
+ * files which are not JPEG, JPEGs with an EXIF orientation other than 1
+ * and RAW16 images are decoded by OpenCV
+ * @param[in] path: image path
+ * @param[out] ori_width: original image width
+ * @param[out] ori_height: original image height
+ * @param[out] tensor: allocated image tensor
+ * @param[in] resize_mode: how the image is resized to tensor size
+ * @param[in] color_mode: how the image is decoded
+ * @return 0 if success
+ */
+int read_jpeg_tensor(const std::string &path,
+                     int &ori_width,
+                     int &ori_height,
+                     BPU_TENSOR_S *tensor,
+                     ResizeMode resize_mode = ResizeMode::STRETCH,
+                     ColorMode color_mode = ColorMode::BGR);
+
+#endif  // _UTILS_JPEG_UTILS_H_
@@ -9,10 +9,23 @@
 #ifndef _UTILS_NMS_H_
 #define _UTILS_NMS_H_
 
+#include <string>
 #include <vector>
 
 #include "base/perception_common.h"
 
+/**
+ * NMS implementation used by post process modules
+ */
+enum class NmsImpl {
+  // yolo5_nms
+  DEFAULT,
+  // grid_nms
+  GRID,
+  // simd_nms
+  SIMD
+};
+
 /**
  * Non-maximum suppression
  * @param[in] input
@@ -40,4 +53,29 @@ void yolo5_nms(std::vector<Detection> &input,
                int top_k,
                std::vector<Detection> &result,
                bool suppress);
+
+/**
+ * Parse NMS implementation name
+ * @param[in] name: one of default, grid, simd
+ * @param[out] impl: NMS implementation
+ * @return 0 if success
+ */
+int parse_nms_impl(const std::string &name, NmsImpl *impl);
+
+/**
+ * Non-maximum suppression by the given implementation,
+ * the threshold is honored by every implementation
+ * @param[in] impl: NMS implementation
+ * @param[in] input
+ * @param[in] iou_threshold
+ * @param[in] top_k
+ * @param[out] result
+ * @param[in] suppress
+ */
+void run_nms(NmsImpl impl,
+             std::vector<Detection> &input,
+             float iou_threshold,
+             int top_k,
+             std::vector<Detection> &result,
+             bool suppress);
 #endif  // _UTILS_NMS_H_
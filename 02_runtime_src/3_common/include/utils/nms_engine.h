@@ -0,0 +1,58 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// NMS for large candidate sets. Boxes are kept in structure-of-arrays
+// layout and partitioned by class, candidates are taken from a heap only as
+// long as the class still needs boxes, and every candidate is compared only
+// with kept boxes sharing a cell of a spatial grid.
+// Same result as yolo5_nms, without input size limit.
+
+#ifndef _UTILS_NMS_ENGINE_H_
+#define _UTILS_NMS_ENGINE_H_
+
+#include <vector>
+
+#include "base/perception_common.h"
+
+/**
+ * Boxes in structure-of-arrays layout
+ */
+struct BoxArray {
+  std::vector<float> xmin;
+  std::vector<float> ymin;
+  std::vector<float> xmax;
+  std::vector<float> ymax;
+  std::vector<float> area;
+  std::vector<float> score;
+  // Index in the input detections
+  std::vector<int> index;
+
+  void Clear();
+
+  void Reserve(size_t n);
+
+  void Add(const Detection &det, int det_index);
+
+  size_t Size() const { return index.size(); }
+};
+
+/**
+ * Grid bucketed non-maximum suppression
+ * @param[in] input: detections, not modified
+ * @param[in] iou_threshold: suppress if IoU is larger than threshold
+ * @param[in] top_k: max output count
+ * @param[out] result: kept detections order by score desc
+ * @param[in] suppress: suppress across classes if true
+ */
+void grid_nms(const std::vector<Detection> &input,
+              float iou_threshold,
+              int top_k,
+              std::vector<Detection> &result,
+              bool suppress);
+
+#endif  // _UTILS_NMS_ENGINE_H_
@@ -0,0 +1,63 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// IoU of one box against many, computed 4 (SSE2 / NEON), 8 (AVX) or
+// 16 (AVX-512) candidates at a time on packed coordinate arrays,
+// and class-aware NMS built on it.
+
+#ifndef _UTILS_SIMD_IOU_H_
+#define _UTILS_SIMD_IOU_H_
+
+#include <vector>
+
+#include "base/perception_common.h"
+
+/**
+ * IoU of one box against a batch of boxes,
+ * 0 if the boxes do not overlap
+ * @param[in] box: the box
+ * @param[in] box_area: area of the box
+ * @param[in] xmin: xmin of batch boxes
+ * @param[in] ymin: ymin of batch boxes
+ * @param[in] xmax: xmax of batch boxes
+ * @param[in] ymax: ymax of batch boxes
+ * @param[in] area: area of batch boxes
+ * @param[in] count: batch size
+ * @param[out] iou: IoU of every batch box
+ */
+void batch_iou(const Bbox &box,
+               float box_area,
+               const float *xmin,
+               const float *ymin,
+               const float *xmax,
+               const float *ymax,
+               const float *area,
+               int count,
+               float *iou);
+
+/**
+ * Lanes used by batch_iou
+ * @return 16, 8, 4 or 1 for scalar
+ */
+int batch_iou_lanes();
+
+/**
+ * Non-maximum suppression on batch_iou, same result as yolo5_nms
+ * @param[in] input: detections, not modified
+ * @param[in] iou_threshold: suppress if IoU is larger than threshold
+ * @param[in] top_k: max output count
+ * @param[out] result: kept detections order by score desc
+ * @param[in] suppress: suppress across classes if true
+ */
+void simd_nms(const std::vector<Detection> &input,
+              float iou_threshold,
+              int top_k,
+              std::vector<Detection> &result,
+              bool suppress);
+
+#endif  // _UTILS_SIMD_IOU_H_
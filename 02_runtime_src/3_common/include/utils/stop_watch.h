@@ -7,7 +7,7 @@
 // without the express written permission of Horizon Robotics Inc.
 
 // Timing utils, record intervals between `Start` and `Stop`, and
-// calculate min, max, average interval and fps and so on.
+// calculate min, max, average interval, percentiles and fps and so on.
 
 #ifndef _UTILS_STOP_WATCH_H_
 #define _UTILS_STOP_WATCH_H_
@@ -16,10 +16,57 @@
 #include <fstream>
 #include <ostream>
 #include <string>
+#include <vector>
 
 typedef std::chrono::steady_clock::time_point Time;
 typedef std::chrono::duration<u_int64_t, std::micro> Micro;
 
+/**
+ * Log-linear (HDR style) histogram of microsecond values. Values below
+ * 2^SUB_BUCKET_BITS are counted exactly, larger ones fall into
+ * 2^(SUB_BUCKET_BITS-1) buckets per power of two, so a reported percentile is
+ * within 1/2^(SUB_BUCKET_BITS-1) (~3%) of the recorded value. Memory is fixed
+ * (BUCKET_COUNT counters) and only allocated on the first record.
+ */
+class LatencyHistogram {
+ public:
+  static const int SUB_BUCKET_BITS = 6;
+  // Values above ~12 days are clamped into the last bucket
+  static const int MAX_VALUE_BITS = 40;
+  static const int BUCKET_COUNT =
+      (MAX_VALUE_BITS - SUB_BUCKET_BITS + 2) << (SUB_BUCKET_BITS - 1);
+
+  void Record(u_int64_t value);
+
+  /**
+   * Add all records of other, e.g. the histogram of another thread
+   * @param[in] other: histogram to be merged
+   */
+  void Merge(const LatencyHistogram &other);
+
+  void Reset();
+
+  /**
+   * Value at percentile, the highest value of its bucket clamped to max
+   * @param[in] percentile: percentile in [0, 100]
+   * @return value, 0 if empty
+   */
+  u_int64_t Percentile(double percentile) const;
+
+  u_int64_t Count() const { return count_; }
+
+  u_int64_t Max() const { return max_; }
+
+ private:
+  static int BucketIndex(u_int64_t value);
+  static u_int64_t BucketUpper(int index);
+
+ private:
+  std::vector<u_int64_t> counts_;
+  u_int64_t count_ = 0;
+  u_int64_t max_ = 0;
+};
+
 class Stopwatch {
  public:
   Stopwatch();
@@ -36,15 +83,53 @@ class Stopwatch {
   void Start();
 
   /**
-   * Stop current timing
+   * Stop current timing, the interval goes into the histogram as well
    */
   void Stop();
 
+  /**
+   * Record an interval measured outside of this stopwatch
+   * @param[in] duration: interval in microseconds
+   */
+  void Record(u_int64_t duration);
+
   /**
    * Reset timing,  clear all records (min, max, last_duration, total_duration)
+   * and the histogram
    */
   void Reset();
 
+  /**
+   * Add records of other stopwatch, e.g. one used by another thread. Other
+   * must not be recording meanwhile.
+   * @param[in] other: stopwatch to be merged
+   */
+  void Merge(const Stopwatch &other);
+
+  /**
+   * Percentiles printed by operator<<, {50, 95, 99} by default
+   * @param[in] percentiles: percentiles in [0, 100]
+   */
+  void SetPercentiles(const std::vector<double> &percentiles);
+
+  const std::vector<double> &Percentiles() { return percentiles_; }
+
+  /**
+   * Limit percentiles to recent intervals for long running services. The
+   * histogram is rolled every window, percentiles cover the current and the
+   * previous window (between one and two windows of records). Totals, min
+   * and max are not affected.
+   * @param[in] window_us: window in microseconds, 0 (default) never rolls
+   */
+  void SetWindow(u_int64_t window_us);
+
+  /**
+   * Duration at percentile, within ~3% of the recorded interval
+   * @param[in] percentile: percentile in [0, 100]
+   * @return duration in milliseconds
+   */
+  float Percentile(double percentile);
+
   /**
    * Calculate fps as count/total_duration
    * @return fps
@@ -87,6 +172,9 @@ class Stopwatch {
    */
   int TimingCount();
 
+ private:
+  void RollWindow(u_int64_t now);
+
  private:
   Time start_;
   Time stop_;
@@ -95,6 +183,13 @@ class Stopwatch {
   Micro min_duration_;
   Micro max_duration_;
   int timing_count_;
+
+  std::vector<double> percentiles_;
+  LatencyHistogram histogram_;
+  // Histogram of the previous window, used if window_us_ > 0
+  LatencyHistogram previous_histogram_;
+  u_int64_t window_us_ = 0;
+  u_int64_t window_start_ = 0;
 };
 
 std::ostream& operator<<(std::ostream&, Stopwatch&);
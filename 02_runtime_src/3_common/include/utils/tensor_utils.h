@@ -9,6 +9,9 @@
 #ifndef _UTILS_TENSOR_UTILS_H_
 #define _UTILS_TENSOR_UTILS_H_
 
+#include <functional>
+#include <map>
+#include <mutex>
 #include <string>
 
 #include "input/input_data.h"
@@ -19,29 +22,161 @@
 #include <vector>
 
 #include "bpu_predict_extension.h"
+#include "opencv2/core/core.hpp"
 #define ALIGN_16(v) ((v + (16 - 1)) / 16 * 16)
 
+/**
+ * BPU memory allocator, HB_SYS_bpuMemAlloc & HB_SYS_bpuMemFree by default,
+ * can be replaced by a stub allocator
+ */
+struct BpuMemAllocator {
+  std::function<int(const char *name, int size, bool cachable, BPU_MEMORY_S *mem)>
+      alloc;
+  std::function<int(BPU_MEMORY_S *mem)> free;
+};
+
+/**
+ * Default allocator
+ * @return allocator calling HB_SYS_bpuMemAlloc & HB_SYS_bpuMemFree
+ */
+BpuMemAllocator default_bpu_mem_allocator();
+
+/**
+ * Tensor buffer pool keyed by (data type, aligned shape, buffer size),
+ * recycled buffers are handed out again instead of being freed
+ */
+class TensorPool {
+ public:
+  /**
+   * @param[in] allocator: allocator used on pool miss
+   * @param[in] max_cached: max free buffers kept for one key
+   */
+  explicit TensorPool(BpuMemAllocator allocator = default_bpu_mem_allocator(),
+                      int max_cached = 16);
+
+  /**
+   * Fill tensor memory, data_type & aligned_shape should have been set
+   * @param[in|out] tensor: tensor
+   * @param[in] data_size: size of tensor data
+   * @param[in] data_ext_size: size of tensor data_ext, 0 if no data_ext
+   * @return 0 if success
+   */
+  int Acquire(BPU_TENSOR_S *tensor, int data_size, int data_ext_size = 0);
+
+  /**
+   * Give tensor memory back to pool, memory not from the pool is freed
+   * @param[in] tensor: tensor
+   */
+  void Recycle(BPU_TENSOR_S *tensor);
+
+  /**
+   * Free all cached buffers, buffers in use are not touched
+   */
+  void Clear();
+
+  int64_t HitCount();
+
+  int64_t MissCount();
+
+  /**
+   * Hit & miss statistics
+   * @return statistics string
+   */
+  std::string Statistics();
+
+  ~TensorPool();
+
+ private:
+  struct Buffer {
+    BPU_MEMORY_S data;
+    BPU_MEMORY_S data_ext;
+  };
+
+  typedef std::vector<int> Key;
+
+  void FreeBuffer(Buffer &buffer, const Key &key);
+
+ private:
+  BpuMemAllocator allocator_;
+  int max_cached_;
+  std::mutex mutex_;
+  // Free buffers
+  std::map<Key, std::vector<Buffer>> cached_;
+  // Key of buffers handed out, by data virtual address
+  std::map<void *, Key> in_use_;
+  int64_t hit_count_ = 0;
+  int64_t miss_count_ = 0;
+};
+
 /**
  * Prepare image tensor
  * @param[in] height
  * @param[in] width
  * @param[in] data_type: tensor data type
  * @param[out] tensor
+ * @param[in] pool: take memory from pool if not null
  */
 void prepare_image_tensor(int height,
                           int width,
                           hb_BPU_DATA_TYPE_E data_type,
-                          BPU_TENSOR_S *tensor);
+                          BPU_TENSOR_S *tensor,
+                          TensorPool *pool = nullptr);
 
 /**
  * Prepare feature tensor
  * @param[in] dims
  * @param[in] data_type
  * @param[out] tensor
+ * @param[in] pool: allocate from pool if not null
  */
 void prepare_feature_tensor(std::vector<int> &dims,
                             hb_BPU_DATA_TYPE_E data_type,
-                            BPU_TENSOR_S *tensor);
+                            BPU_TENSOR_S *tensor,
+                            TensorPool *pool = nullptr);
+
+// BGR value of letterbox border, same as the mapper
+#define LETTERBOX_PAD_VALUE (127)
+
+enum class ResizeMode {
+  // Resize to input size, aspect ratio is not kept
+  STRETCH,
+  // Keep aspect ratio, center the image and pad the border
+  LETTERBOX
+};
+
+enum class ColorMode {
+  // 3-channel color image
+  BGR,
+  // 8-bit single channel, e.g. LWIR
+  GRAY,
+  // 16-bit single channel, normalized to 8-bit by min & max of the frame
+  RAW16
+};
+
+/**
+ * Parse color mode name
+ * @param[in] name: bgr, gray or raw16
+ * @param[out] mode: color mode
+ * @return 0 if success
+ */
+int parse_color_mode(const std::string &name, ColorMode *mode);
+
+/**
+ * Parse the optional "color_modes" array of a json config
+ * @param[in] config_string: json config
+ * @param[out] modes: color mode of every modality, untouched if absent
+ * @return 0 if success
+ */
+int parse_color_modes(const std::string &config_string,
+                      std::vector<ColorMode> *modes);
+
+/**
+ * Parse resize mode name
+ * @param[in] name: stretch or letterbox
+ * @param[out] mode: resize mode
+ * @return 0 if success
+ */
+int parse_resize_mode(const std::string &name, ResizeMode *mode);
 
 /**
  *
@@ -49,12 +184,65 @@ void prepare_feature_tensor(std::vector<int> &dims,
  * @param[out] ori_width:
  * @param[out] ori_height:
  * @param[out] tensor:
+ * @param[in] resize_mode: how the image is resized to tensor size
+ * @param[in] color_mode: how the image is decoded
  * @return 0 if success
  */
-int read_image_tensor(std::string &path,
+int read_image_tensor(const std::string &path,
                       int &ori_width,
                       int &ori_height,
-                      BPU_TENSOR_S *tensor);
+                      BPU_TENSOR_S *tensor,
+                      ResizeMode resize_mode = ResizeMode::STRETCH,
+                      ColorMode color_mode = ColorMode::BGR);
+
+/**
+ * Resize BGR image to tensor size and convert to tensor data type,
+ * NV12 is written to tensor memory directly
+ * @param[in] bgr_mat: BGR image
+ * @param[out] tensor: allocated image tensor
+ * @param[in] resize_mode: how the image is resized to tensor size
+ * @return 0 if success
+ */
+int bgr_mat_to_tensor(cv::Mat &bgr_mat,
+                      BPU_TENSOR_S *tensor,
+                      ResizeMode resize_mode = ResizeMode::STRETCH);
+
+/**
+ * Same as bgr_mat_to_tensor for a gray image, same result as converting
+ * the gray image to BGR first. Y & NV12 tensors are filled without color
+ * conversion, NV12 chroma is constant
+ * @param[in] gray_mat: 8-bit gray image
+ * @param[out] tensor: allocated image tensor
+ * @param[in] resize_mode: how the image is resized to tensor size
+ * @return 0 if success
+ */
+int gray_mat_to_tensor(cv::Mat &gray_mat,
+                       BPU_TENSOR_S *tensor,
+                       ResizeMode resize_mode = ResizeMode::STRETCH);
+
+/**
+ * Convert a decoded image to tensor by color mode, gray & raw16 images
+ * are converted to 8-bit gray first, same as read_image_tensor
+ * @param[in] mat: decoded image, BGR or single channel
+ * @param[out] tensor: allocated image tensor
+ * @param[in] resize_mode: how the image is resized to tensor size
+ * @param[in] color_mode: color mode of the image
+ * @return 0 if success
+ */
+int mat_to_tensor(cv::Mat &mat,
+                  BPU_TENSOR_S *tensor,
+                  ResizeMode resize_mode,
+                  ColorMode color_mode);
+
+/**
+ * Copy raw tensor data into prepared tensor memory, for NV12 separate
+ * tensors the bytes beyond data go to data_ext
+ * @param[in] data: raw data
+ * @param[in] size: size of raw data
+ * @param[out] tensor: tensor with memory prepared
+ * @return 0 if success, -1 if data is larger than tensor memory
+ */
+int copy_to_tensor(const void *data, uint64_t size, BPU_TENSOR_S *tensor);
 
 /**
  * Flush tensor
@@ -65,20 +253,25 @@ void flush_tensor(BPU_TENSOR_S *tensor);
 /**
  * Free tensor
  * @param tensor: Tensor to be released
+ * @param pool: give memory back to pool if not null
  */
-void release_tensor(BPU_TENSOR_S *tensor);
+void release_tensor(BPU_TENSOR_S *tensor, TensorPool *pool = nullptr);
 
 /**
  * Prepare output tensor
  * @param output
  * @param model
+ * @param pool: take memory from pool if not null
  */
 void prepare_output_tensor(std::vector<BPU_TENSOR_S> &output,
-                           BPU_MODEL_S *model);
+                           BPU_MODEL_S *model,
+                           TensorPool *pool = nullptr);
 
 /**
  * Release output tensor
  * @param output
+ * @param pool: give memory back to pool if not null
  */
-void release_output_tensor(std::vector<BPU_TENSOR_S> &output);
+void release_output_tensor(std::vector<BPU_TENSOR_S> &output,
+                           TensorPool *pool = nullptr);
 #endif  // _UTILS_TENSOR_UTILS_H_
@@ -0,0 +1,58 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Small persistent thread pool, threads are created once and wait for tasks.
+
+#ifndef _UTILS_THREAD_POOL_H_
+#define _UTILS_THREAD_POOL_H_
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+ public:
+  /**
+   * Start worker threads
+   * @param[in] thread_num: worker thread count
+   */
+  explicit ThreadPool(int thread_num);
+
+  /**
+   * Run task on a worker thread
+   * @param[in] task: task
+   */
+  void Submit(std::function<void()> task);
+
+  /**
+   * Run func(0) ... func(count - 1) on the workers and the calling thread,
+   * return after all of them are done. Can be called from several threads.
+   * @param[in] count: index count
+   * @param[in] func: function called with every index once
+   */
+  void ParallelFor(int count, const std::function<void(int)> &func);
+
+  int ThreadNum() { return static_cast<int>(threads_.size()); }
+
+  ~ThreadPool();
+
+ private:
+  void WorkLoop();
+
+ private:
+  std::vector<std::thread> threads_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_ = false;
+};
+
+#endif  // _UTILS_THREAD_POOL_H_
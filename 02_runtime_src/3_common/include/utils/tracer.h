@@ -0,0 +1,207 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Per-frame stage tracing. Every thread records timestamped spans into its
+// own ring buffer (single writer, no lock, oldest spans are overwritten), and
+// the tracer dumps them on demand as Chrome trace-event JSON which can be
+// opened in chrome://tracing or https://ui.perfetto.dev.
+//
+// Usage:
+//   Tracer::Instance()->Enable();
+//   {
+//     TraceSpan span("bpu_run", frame_id);
+//     ...
+//   }
+//   Tracer::Instance()->Dump("trace.json");
+
+#ifndef _UTILS_TRACER_H_
+#define _UTILS_TRACER_H_
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "utils/stop_watch.h"
+
+/**
+ * One span, name must be a string literal (only the pointer is stored)
+ */
+struct TraceEvent {
+  const char *name;
+  int64_t frame_id;
+  u_int64_t start_ts;
+  u_int64_t end_ts;
+};
+
+/**
+ * Span ring buffer of one thread
+ */
+class TraceRing {
+ public:
+  TraceRing(int tid, int capacity)
+      : tid_(tid), slots_(std::max(capacity, 1)) {}
+
+  /**
+   * Append span, only called by the owner thread
+   * @param[in] event: span
+   */
+  void Push(const TraceEvent &event) {
+    u_int64_t head = head_.load(std::memory_order_relaxed);
+    // Readers seeing any store below also see head, see Snapshot
+    std::atomic_thread_fence(std::memory_order_release);
+    Slot &slot = slots_[head % slots_.size()];
+    slot.name.store(event.name, std::memory_order_relaxed);
+    slot.frame_id.store(event.frame_id, std::memory_order_relaxed);
+    slot.start_ts.store(event.start_ts, std::memory_order_relaxed);
+    slot.end_ts.store(event.end_ts, std::memory_order_relaxed);
+    head_.store(head + 1, std::memory_order_release);
+  }
+
+  /**
+   * Copy recorded spans, may be called by any thread. Spans overwritten by
+   * the owner thread during the copy are dropped.
+   * @param[out] events: spans from oldest to newest
+   */
+  void Snapshot(std::vector<TraceEvent> *events);
+
+  int Tid() { return tid_; }
+
+  // Guarded by the tracer mutex
+  void SetThreadName(const std::string &name) { thread_name_ = name; }
+
+  const std::string &ThreadName() { return thread_name_; }
+
+ private:
+  // TraceEvent of relaxed atomics, so a slot can be read while overwritten
+  struct Slot {
+    std::atomic<const char *> name;
+    std::atomic<int64_t> frame_id;
+    std::atomic<u_int64_t> start_ts;
+    std::atomic<u_int64_t> end_ts;
+  };
+
+  int tid_;
+  std::string thread_name_;
+  std::vector<Slot> slots_;
+  // Spans ever pushed
+  std::atomic<u_int64_t> head_{0};
+};
+
+class Tracer {
+ public:
+  static Tracer *Instance();
+
+  /**
+   * Start recording
+   * @param[in] capacity: spans kept per thread, for threads which record
+   *        their first span after this call
+   */
+  void Enable(int capacity = 64 * 1024);
+
+  void Disable() { enabled_.store(false, std::memory_order_relaxed); }
+
+  bool IsEnabled() { return enabled_.load(std::memory_order_relaxed); }
+
+  /**
+   * Name the calling thread in the trace, no memory is allocated until the
+   * thread records a span
+   * @param[in] name: thread name, e.g. the pipeline stage
+   */
+  void SetThreadName(const std::string &name);
+
+  /**
+   * Frame id of spans recorded by the calling thread without one, so spans
+   * deep in post process or output modules can be attributed to the frame
+   * @param[in] frame_id: frame id, -1 if unknown
+   */
+  static void SetCurrentFrame(int64_t frame_id);
+
+  static int64_t CurrentFrame();
+
+  /**
+   * Record span of the calling thread if enabled
+   * @param[in] name: string literal
+   * @param[in] frame_id: frame id, -1 if unknown
+   * @param[in] start_ts: start timestamp of Stopwatch::CurrentTs
+   * @param[in] end_ts: end timestamp of Stopwatch::CurrentTs
+   */
+  void Record(const char *name,
+              int64_t frame_id,
+              u_int64_t start_ts,
+              u_int64_t end_ts);
+
+  /**
+   * Write spans of every thread as Chrome trace-event JSON, can be called
+   * while other threads are recording
+   * @param[in] path: json file
+   * @return 0 if success
+   */
+  int Dump(const std::string &path);
+
+  /**
+   * Spans of every thread as Chrome trace-event JSON
+   * @return json string
+   */
+  std::string ToJson();
+
+ private:
+  Tracer() {}
+
+  TraceRing *ThreadRing();
+
+ private:
+  std::atomic<bool> enabled_{false};
+  int capacity_ = 64 * 1024;
+  std::mutex mutex_;
+  // Rings outlive their threads so spans can be dumped after join
+  std::vector<std::unique_ptr<TraceRing>> rings_;
+};
+
+/**
+ * Record a span from construction to destruction, nothing if the tracer is
+ * disabled at construction
+ */
+class TraceSpan {
+ public:
+  /**
+   * Span of the current frame of the thread
+   * @param[in] name: string literal
+   */
+  explicit TraceSpan(const char *name)
+      : TraceSpan(name, Tracer::CurrentFrame()) {}
+
+  /**
+   * @param[in] name: string literal
+   * @param[in] frame_id: frame id
+   */
+  TraceSpan(const char *name, int64_t frame_id)
+      : name_(name),
+        frame_id_(frame_id),
+        start_ts_(Tracer::Instance()->IsEnabled() ? Stopwatch::CurrentTs()
+                                                  : 0) {}
+
+  ~TraceSpan() {
+    if (start_ts_ != 0) {
+      Tracer::Instance()->Record(
+          name_, frame_id_, start_ts_, Stopwatch::CurrentTs());
+    }
+  }
+
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+ private:
+  const char *name_;
+  int64_t frame_id_;
+  u_int64_t start_ts_;
+};
+
+#endif  // _UTILS_TRACER_H_
@@ -68,7 +68,7 @@ std::string layout_type_enum_to_string(BPU_LAYOUT_E layout);
  * @param path: file path
  * @return filename
  */
-std::string get_file_name(std::string &path);
+std::string get_file_name(const std::string &path);
 
 /**
  * Split str by sep
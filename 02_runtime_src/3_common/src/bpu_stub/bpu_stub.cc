@@ -0,0 +1,452 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Hardware free implementation of the bpu_predict subset used by this
+// project, for profiling the CPU side of the pipeline on x86. BPU memory is
+// plain host memory and a "model file" is a json description of the model:
+// {
+//     "bpu_cores": 2, # simulated cores, tasks queue on the first free one
+//     "latency_us": 8000, # time one task occupies a core
+//     "seed": 0, # seed of synthetic outputs
+//     "value_range": [-8.0, 2.0], # range of synthetic outputs
+//     "inputs": [
+//         {"name": "images", "data_type": 1, "shape": [1, 384, 640, 3],
+//          "layout": "NHWC"}
+//     ],
+//     "outputs": [
+//         {"name": "output0", "data_type": 10, "shape": [1, 48, 80, 255],
+//          "layout": "NHWC",
+//          "aligned_shape": [1, 48, 80, 256], # same as shape by default
+//          "file": "output0.bin"} # recorded outputs, frames of aligned
+//                                 # size back to back replayed in turn,
+//                                 # synthetic if absent
+//     ]
+// }
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "bpu_predict_extension.h"
+#include "glog/logging.h"
+#include "rapidjson/document.h"
+
+#define BPU_STUB_MEM_ALIGN (64)
+
+enum BpuStubError {
+  BPU_STUB_OK = 0,
+  BPU_STUB_ERR_INVALID_MODEL = -1,
+  BPU_STUB_ERR_INVALID_ARGUMENT = -2,
+  BPU_STUB_ERR_OUT_OF_MEMORY = -3,
+  BPU_STUB_ERR_UNSUPPORTED = -4
+};
+
+typedef std::chrono::steady_clock::time_point TimePoint;
+
+struct StubOutput {
+  int frame_size = 0;
+  // Recorded or synthetic frames, replayed in turn
+  std::vector<char> frames;
+};
+
+struct StubModel {
+  std::chrono::microseconds latency{0};
+  std::vector<StubOutput> outputs;
+  std::atomic<uint64_t> run_count{0};
+};
+
+struct StubTask {
+  TimePoint done;
+};
+
+// Simulated BPU cores shared by all models
+static std::mutex core_mutex;
+static std::vector<TimePoint> core_free_ts(1);
+
+static int element_size(BPU_DATA_TYPE_E data_type) {
+  switch (data_type) {
+    case BPU_TYPE_TENSOR_F32:
+    case BPU_TYPE_TENSOR_S32:
+    case BPU_TYPE_TENSOR_U32:
+      return 4;
+    default:
+      return 1;
+  }
+}
+
+static int parse_shape(const rapidjson::Value &value,
+                       BPU_LAYOUT_E layout,
+                       BPU_DATA_SHAPE_S *shape) {
+  if (!value.IsArray() || value.Size() > BPU_MODEL_MAX_SHAPE_DIM) {
+    LOG(ERROR) << "Shape should be an array of at most "
+               << BPU_MODEL_MAX_SHAPE_DIM << " dims";
+    return -1;
+  }
+  memset(shape, 0, sizeof(*shape));
+  shape->layout = layout;
+  shape->ndim = value.Size();
+  for (rapidjson::SizeType i = 0; i < value.Size(); i++) {
+    shape->d[i] = value[i].GetInt();
+  }
+  return 0;
+}
+
+static int parse_node(const rapidjson::Value &value, BPU_MODEL_NODE_S *node) {
+  memset(node, 0, sizeof(*node));
+  std::string name = value.HasMember("name") ? value["name"].GetString() : "";
+  node->name = strdup(name.c_str());
+
+  if (!value.HasMember("data_type") || !value.HasMember("shape")) {
+    LOG(ERROR) << "data_type and shape are required by node " << name;
+    return -1;
+  }
+  node->data_type =
+      static_cast<BPU_DATA_TYPE_E>(value["data_type"].GetInt());
+
+  BPU_LAYOUT_E layout = BPU_LAYOUT_NONE;
+  if (value.HasMember("layout")) {
+    std::string layout_name = value["layout"].GetString();
+    if (layout_name == "NHWC") {
+      layout = BPU_LAYOUT_NHWC;
+    } else if (layout_name == "NCHW") {
+      layout = BPU_LAYOUT_NCHW;
+    } else {
+      LOG(ERROR) << "Unknown layout:" << layout_name;
+      return -1;
+    }
+  }
+
+  if (parse_shape(value["shape"], layout, &node->shape) != 0) {
+    return -1;
+  }
+  node->aligned_shape = node->shape;
+  if (value.HasMember("aligned_shape") &&
+      parse_shape(value["aligned_shape"], layout, &node->aligned_shape) !=
+          0) {
+    return -1;
+  }
+  return 0;
+}
+
+static int aligned_size(const BPU_MODEL_NODE_S &node) {
+  int size = element_size(node.data_type);
+  for (int i = 0; i < node.aligned_shape.ndim; i++) {
+    size *= node.aligned_shape.d[i];
+  }
+  return size;
+}
+
+static int load_output(const rapidjson::Value &value,
+                       const BPU_MODEL_NODE_S &node,
+                       std::mt19937 &engine,
+                       float min_value,
+                       float max_value,
+                       StubOutput *output) {
+  output->frame_size = aligned_size(node);
+  if (value.HasMember("file")) {
+    std::string file = value["file"].GetString();
+    std::ifstream ifs(file, std::ios::in | std::ios::binary);
+    if (!ifs) {
+      LOG(ERROR) << "Open " << file << " failed";
+      return -1;
+    }
+    output->frames.assign(std::istreambuf_iterator<char>(ifs),
+                          std::istreambuf_iterator<char>());
+    if (output->frames.empty() ||
+        output->frames.size() % output->frame_size != 0) {
+      LOG(ERROR) << file << " is not made of " << output->frame_size
+                 << " byte frames of " << node.name;
+      return -1;
+    }
+    return 0;
+  }
+
+  output->frames.resize(output->frame_size);
+  std::uniform_real_distribution<float> distribution(min_value, max_value);
+  int count = output->frame_size / element_size(node.data_type);
+  for (int i = 0; i < count; i++) {
+    float v = distribution(engine);
+    switch (node.data_type) {
+      case BPU_TYPE_TENSOR_F32:
+        reinterpret_cast<float *>(output->frames.data())[i] = v;
+        break;
+      case BPU_TYPE_TENSOR_S32:
+      case BPU_TYPE_TENSOR_U32:
+        reinterpret_cast<int32_t *>(output->frames.data())[i] =
+            static_cast<int32_t>(v);
+        break;
+      default:
+        output->frames[i] = static_cast<char>(static_cast<int>(v));
+        break;
+    }
+  }
+  return 0;
+}
+
+static void free_nodes(BPU_MODEL_NODE_S *nodes, int num) {
+  if (nodes == nullptr) {
+    return;
+  }
+  for (int i = 0; i < num; i++) {
+    free(const_cast<char *>(nodes[i].name));
+  }
+  delete[] nodes;
+}
+
+int HB_BPU_loadModel(const void *model_data,
+                     int model_size,
+                     BPU_MODEL_S *model) {
+  memset(model, 0, sizeof(*model));
+  std::string json(static_cast<const char *>(model_data), model_size);
+  rapidjson::Document document;
+  document.Parse(json.data());
+  if (document.HasParseError() || !document.IsObject() ||
+      !document.HasMember("inputs") || !document.HasMember("outputs")) {
+    LOG(ERROR) << "bpu_stub only loads json model descriptions";
+    return BPU_STUB_ERR_INVALID_MODEL;
+  }
+
+  auto *stub_model = new StubModel();
+  model->handle = stub_model;
+  if (document.HasMember("latency_us")) {
+    stub_model->latency =
+        std::chrono::microseconds(document["latency_us"].GetInt());
+  }
+  if (document.HasMember("bpu_cores")) {
+    std::lock_guard<std::mutex> lock(core_mutex);
+    core_free_ts.resize(std::max(document["bpu_cores"].GetInt(), 1));
+  }
+  std::mt19937 engine(
+      document.HasMember("seed") ? document["seed"].GetInt() : 0);
+  float min_value = -1.0, max_value = 1.0;
+  if (document.HasMember("value_range")) {
+    min_value = document["value_range"][0u].GetFloat();
+    max_value = document["value_range"][1u].GetFloat();
+  }
+
+  auto &inputs = document["inputs"];
+  model->input_num = inputs.Size();
+  model->inputs = new BPU_MODEL_NODE_S[model->input_num]();
+  for (int i = 0; i < model->input_num; i++) {
+    if (parse_node(inputs[i], &model->inputs[i]) != 0) {
+      HB_BPU_releaseModel(model);
+      return BPU_STUB_ERR_INVALID_MODEL;
+    }
+  }
+
+  auto &outputs = document["outputs"];
+  model->output_num = outputs.Size();
+  model->outputs = new BPU_MODEL_NODE_S[model->output_num]();
+  stub_model->outputs.resize(model->output_num);
+  for (int i = 0; i < model->output_num; i++) {
+    if (parse_node(outputs[i], &model->outputs[i]) != 0 ||
+        load_output(outputs[i],
+                    model->outputs[i],
+                    engine,
+                    min_value,
+                    max_value,
+                    &stub_model->outputs[i]) != 0) {
+      HB_BPU_releaseModel(model);
+      return BPU_STUB_ERR_INVALID_MODEL;
+    }
+  }
+  return BPU_STUB_OK;
+}
+
+int HB_BPU_releaseModel(BPU_MODEL_S *model) {
+  free_nodes(model->inputs, model->input_num);
+  free_nodes(model->outputs, model->output_num);
+  delete static_cast<StubModel *>(model->handle);
+  memset(model, 0, sizeof(*model));
+  return BPU_STUB_OK;
+}
+
+/**
+ * Queue a task on the requested core, or the first free one
+ * @param[in] core_id: 0 for any core, otherwise core index + 1
+ * @param[in] latency: time the task occupies the core
+ * @return time the task is done
+ */
+static TimePoint schedule_task(int core_id, std::chrono::microseconds latency) {
+  std::lock_guard<std::mutex> lock(core_mutex);
+  int core = core_id - 1;
+  if (core < 0 || core >= static_cast<int>(core_free_ts.size())) {
+    core = std::min_element(core_free_ts.begin(), core_free_ts.end()) -
+           core_free_ts.begin();
+  }
+  auto start = std::max(std::chrono::steady_clock::now(), core_free_ts[core]);
+  core_free_ts[core] = start + latency;
+  return core_free_ts[core];
+}
+
+int HB_BPU_runModel(const BPU_MODEL_S *model,
+                    BPU_TENSOR_S input_data[],
+                    int input_num,
+                    BPU_TENSOR_S output_data[],
+                    int output_num,
+                    BPU_RUN_CTRL_S *run_ctrl,
+                    bool is_sync,
+                    BPU_TASK_HANDLE *task_handle) {
+  auto *stub_model = static_cast<StubModel *>(model->handle);
+  if (stub_model == nullptr || input_num != model->input_num ||
+      output_num != model->output_num) {
+    LOG(ERROR) << "Expect " << model->input_num << " inputs and "
+               << model->output_num << " outputs";
+    return BPU_STUB_ERR_INVALID_ARGUMENT;
+  }
+
+  // Every output of one run comes from the same recorded frame
+  uint64_t run_index = stub_model->run_count++;
+  for (int i = 0; i < output_num; i++) {
+    auto &output = stub_model->outputs[i];
+    if (output_data[i].data.virAddr == nullptr ||
+        output_data[i].data.memSize < output.frame_size) {
+      LOG(ERROR) << "Output " << i << " needs " << output.frame_size
+                 << " bytes, got " << output_data[i].data.memSize;
+      return BPU_STUB_ERR_INVALID_ARGUMENT;
+    }
+    uint64_t frame_num = output.frames.size() / output.frame_size;
+    memcpy(output_data[i].data.virAddr,
+           output.frames.data() + run_index % frame_num * output.frame_size,
+           output.frame_size);
+  }
+
+  auto done = schedule_task(run_ctrl ? run_ctrl->core_id : 0,
+                            stub_model->latency);
+  if (is_sync) {
+    std::this_thread::sleep_until(done);
+    return BPU_STUB_OK;
+  }
+  auto *task = new StubTask();
+  task->done = done;
+  *task_handle = task;
+  return BPU_STUB_OK;
+}
+
+int HB_BPU_waitModelDone(BPU_TASK_HANDLE *task_handle) {
+  auto *task = static_cast<StubTask *>(*task_handle);
+  if (task == nullptr) {
+    return BPU_STUB_ERR_INVALID_ARGUMENT;
+  }
+  std::this_thread::sleep_until(task->done);
+  return BPU_STUB_OK;
+}
+
+int HB_BPU_releaseTask(BPU_TASK_HANDLE *task_handle) {
+  delete static_cast<StubTask *>(*task_handle);
+  *task_handle = nullptr;
+  return BPU_STUB_OK;
+}
+
+int HB_BPU_setModelPrior(BPU_MODEL_S *model) { return BPU_STUB_OK; }
+
+int HB_BPU_setGlobalConfig(BPU_GLOBAL_CONFIG_E config_key,
+                           const char *config_value) {
+  return BPU_STUB_OK;
+}
+
+int HB_BPU_getHWCIndex(BPU_DATA_TYPE_E data_type,
+                       const BPU_LAYOUT_E *layout,
+                       int *h_idx,
+                       int *w_idx,
+                       int *c_idx) {
+  bool is_nchw = layout != nullptr && *layout != BPU_LAYOUT_NONE
+                     ? *layout == BPU_LAYOUT_NCHW
+                     : data_type == BPU_TYPE_IMG_BGRP ||
+                           data_type == BPU_TYPE_IMG_RGBP;
+  *h_idx = is_nchw ? 2 : 1;
+  *w_idx = is_nchw ? 3 : 2;
+  *c_idx = is_nchw ? 1 : 3;
+  return BPU_STUB_OK;
+}
+
+int HB_BPU_getHW(BPU_DATA_TYPE_E data_type,
+                 const BPU_DATA_SHAPE_S *shape,
+                 int *height,
+                 int *width) {
+  int h_idx, w_idx, c_idx;
+  HB_BPU_getHWCIndex(data_type, &shape->layout, &h_idx, &w_idx, &c_idx);
+  *height = shape->d[h_idx];
+  *width = shape->d[w_idx];
+  return BPU_STUB_OK;
+}
+
+int HB_SYS_bpuMemAlloc(const char *name,
+                       int size,
+                       bool cachable,
+                       BPU_MEMORY_S *mem) {
+  void *data = nullptr;
+  if (size <= 0 ||
+      posix_memalign(&data, BPU_STUB_MEM_ALIGN, size) != 0) {
+    LOG(ERROR) << "Alloc " << size << " bytes for " << name << " failed";
+    return BPU_STUB_ERR_OUT_OF_MEMORY;
+  }
+  mem->virAddr = data;
+  mem->phyAddr = reinterpret_cast<uint64_t>(data);
+  mem->memSize = size;
+  return BPU_STUB_OK;
+}
+
+int HB_SYS_bpuMemFree(BPU_MEMORY_S *mem) {
+  free(mem->virAddr);
+  mem->virAddr = nullptr;
+  mem->phyAddr = 0;
+  return BPU_STUB_OK;
+}
+
+int HB_SYS_flushMemCache(const BPU_MEMORY_S *mem, int flag) {
+  return BPU_STUB_OK;
+}
+
+const char *HB_BPU_getErrorName(int err_code) {
+  switch (err_code) {
+    case BPU_STUB_OK:
+      return "BPU_STUB_OK";
+    case BPU_STUB_ERR_INVALID_MODEL:
+      return "BPU_STUB_ERR_INVALID_MODEL";
+    case BPU_STUB_ERR_INVALID_ARGUMENT:
+      return "BPU_STUB_ERR_INVALID_ARGUMENT";
+    case BPU_STUB_ERR_OUT_OF_MEMORY:
+      return "BPU_STUB_ERR_OUT_OF_MEMORY";
+    case BPU_STUB_ERR_UNSUPPORTED:
+      return "BPU_STUB_ERR_UNSUPPORTED";
+    default:
+      return "BPU_STUB_ERR_UNKNOWN";
+  }
+}
+
+// No camera on x86, camera data iterator fails at Init
+int BPU_createCameraHandle(const char *vio_cfg,
+                           const char *cam_cfg,
+                           int cam_index,
+                           int cam_port,
+                           BPUCameraHandle *handle) {
+  LOG(ERROR) << "bpu_stub has no camera";
+  return BPU_STUB_ERR_UNSUPPORTED;
+}
+
+int BPU_getCameraImageData(BPUCameraHandle handle, BPUCameraBuffer *buffer) {
+  return BPU_STUB_ERR_UNSUPPORTED;
+}
+
+int BPU_convertCameraInfo(BPU_CAMERA_IMAGE_INFO_S *info,
+                          BPUCameraBuffer buffer) {
+  return BPU_STUB_ERR_UNSUPPORTED;
+}
+
+int BPU_releaseCameraBuffer(BPUCameraHandle handle, BPUCameraBuffer buffer) {
+  return BPU_STUB_ERR_UNSUPPORTED;
+}
@@ -10,6 +10,7 @@
 
 #include "glog/logging.h"
 #include "rapidjson/document.h"
+#include "utils/stop_watch.h"
 
 int CameraDataIterator::Init(std::string config_file,
                              std::string config_string) {
@@ -18,8 +19,19 @@ int CameraDataIterator::Init(std::string config_file,
   if (ret_code != 0) {
     return -1;
   }
-  return BPU_createCameraHandle(
+  ret_code = BPU_createCameraHandle(
       vio_cfg_.c_str(), cam_cfg_.c_str(), cam_index_, cam_port_, &cam_handle_);
+  if (ret_code != 0) {
+    return ret_code;
+  }
+
+  // The camera SDK has no non-blocking get, a grab thread keeps the newest
+  // frames ready so superseded buffers go back to the driver at once
+  if (frame_policy_ != FramePolicy::EVERY) {
+    grab_queue_.SetCapacity(frame_policy_ == FramePolicy::LATEST ? 1 : 2);
+    grab_thread_ = std::thread(&CameraDataIterator::GrabLoop, this);
+  }
+  return 0;
 }
 
 bool CameraDataIterator::Next(ImageTensor *visible_image_tensor,ImageTensor *lwir_image_tensor){
@@ -28,6 +40,64 @@ bool CameraDataIterator::Next(ImageTensor *visible_image_tensor,ImageTensor *lwi
 }
 
 bool CameraDataIterator::Next(ImageTensor *image_tensor) {
+  if (frame_policy_ == FramePolicy::EVERY) {
+    if (!Grab(image_tensor)) {
+      return false;
+    }
+  } else {
+    do {
+      ImageTensor *frame = nullptr;
+      if (!grab_queue_.Pop(&frame) || frame == nullptr) {
+        // Grab thread has stopped
+        is_finish_ = true;
+        return false;
+      }
+      *image_tensor = *frame;
+      delete frame;
+    } while (!ApplyFramePolicy({image_tensor}));
+  }
+
+  image_tensor->frame_id = NextFrameId();
+  count_++;
+  return true;
+}
+
+bool CameraDataIterator::TryNextReady(
+    std::vector<ImageTensor *> image_tensors) {
+  ImageTensor *frame = nullptr;
+  if (!grab_queue_.TryPop(&frame)) {
+    return false;
+  }
+  if (frame == nullptr) {
+    is_finish_ = true;
+    return false;
+  }
+  *image_tensors[0] = *frame;
+  delete frame;
+  return true;
+}
+
+void CameraDataIterator::GrabLoop() {
+  while (!stop_) {
+    auto *frame = new ImageTensor();
+    if (!Grab(frame)) {
+      delete frame;
+      break;
+    }
+
+    ImageTensor *evicted = nullptr;
+    if (grab_queue_.PushEvictOldest(frame, &evicted)) {
+      if (evicted != frame) {
+        CountEvicted(*evicted);
+      }
+      Release(evicted);
+      delete evicted;
+    }
+  }
+  grab_queue_.Push(nullptr);
+}
+
+bool CameraDataIterator::Grab(ImageTensor *image_tensor) {
   BPUCameraBuffer camera_buffer = nullptr;
   int ret_code = BPU_getCameraImageData(cam_handle_, &camera_buffer);
   if (ret_code != 0) {
@@ -64,14 +134,25 @@ bool CameraDataIterator::Next(ImageTensor *image_tensor) {
   tensor.data_ext.memSize = uv_len;
 
   image_tensor->cam_id = camera_image_info.cam_id;
-  image_tensor->frame_id = NextFrameId();
   image_tensor->timestamp = camera_image_info.timestamp;
+  image_tensor->receive_ts = Stopwatch::CurrentTs();
   image_tensor->ori_image_height = image_info.height;
   image_tensor->ori_image_width = image_info.width;
   image_tensor->addition_info = camera_buffer;
 
-  count_++;
-
+  if (!record_file_.empty()) {
+    if (!recorder_.IsOpen() &&
+        recorder_.Open(record_file_, image_info.width, image_info.height) !=
+            0) {
+      record_file_.clear();
+    } else {
+      recorder_.Write(image_tensor->receive_ts,
+                      reinterpret_cast<uint8_t *>(image_info.y_vaddr),
+                      image_info.step,
+                      reinterpret_cast<uint8_t *>(image_info.c_vaddr),
+                      image_info.step);
+    }
+  }
   return true;
 }
 
@@ -82,7 +163,7 @@ void CameraDataIterator::Release(ImageTensor *image_tensor) {
 }
 
 bool CameraDataIterator::HasNext() {
-  return (frame_count_ == -1 || count_ < frame_count_);
+  return !is_finish_ && (frame_count_ == -1 || count_ < frame_count_);
 }
 
 int CameraDataIterator::LoadConfig(std::string &config_string) {
@@ -114,5 +195,25 @@ int CameraDataIterator::LoadConfig(std::string &config_string) {
     frame_count_ = document["frame_count"].GetInt();
   }
 
+  if (document.HasMember("record_file")) {
+    record_file_ = document["record_file"].GetString();
+  }
+
   return 0;
 }
+
+CameraDataIterator::~CameraDataIterator() {
+  stop_ = true;
+  grab_queue_.Close();
+  if (grab_thread_.joinable()) {
+    grab_thread_.join();
+  }
+  ImageTensor *frame;
+  while (grab_queue_.TryPop(&frame)) {
+    if (frame != nullptr) {
+      Release(frame);
+      delete frame;
+    }
+  }
+  recorder_.Close();
+}
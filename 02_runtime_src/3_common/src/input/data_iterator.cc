@@ -8,13 +8,34 @@
 
 #include "input/data_iterator.h"
 
+#include <sstream>
+
 #include "glog/logging.h"
 #include "input/camera_data_iterator.h"
 #include "input/feature_iterator.h"
 #include "input/image_list_data_iterator.h"
 #include "input/network_data_iterator.h"
+#include "input/packed_data_iterator.h"
 #include "input/preprocessed_image_iterator.h"
+#include "input/replay_data_iterator.h"
+#include "input/video_data_iterator.h"
 #include "input/mutil_modal_image_list_data_iterator.h"
+#include "rapidjson/document.h"
+#include "utils/stop_watch.h"
+
+int parse_frame_policy(const std::string &name, FramePolicy *policy) {
+  if (name == "every") {
+    *policy = FramePolicy::EVERY;
+  } else if (name == "latest") {
+    *policy = FramePolicy::LATEST;
+  } else if (name == "max_age") {
+    *policy = FramePolicy::MAX_AGE;
+  } else {
+    LOG(ERROR) << "Unknown frame policy:" << name;
+    return -1;
+  }
+  return 0;
+}
 
 int DataIterator::Init(std::string config_file, std::string config_string) {
   if (!config_file.empty()) {
@@ -25,15 +46,121 @@ int DataIterator::Init(std::string config_file, std::string config_string) {
   }
 
   if (!config_string.empty()) {
-    int ret_code = this->LoadConfig(config_string);
+    int ret_code = this->LoadFramePolicy(config_string);
     if (ret_code != 0) {
       return ret_code;
     }
+    ret_code = this->LoadConfig(config_string);
+    if (ret_code != 0) {
+      return ret_code;
+    }
+  }
+
+  if (frame_policy_ != FramePolicy::EVERY && !SupportFramePolicy()) {
+    LOG(WARNING) << module_name_ << " is not a live source, "
+                 << "frame_policy is ignored";
+    frame_policy_ = FramePolicy::EVERY;
+  }
+  return 0;
+}
+
+int DataIterator::LoadFramePolicy(std::string &config_string) {
+  rapidjson::Document document;
+  document.Parse(config_string.data());
+
+  if (document.HasParseError()) {
+    LOG(ERROR) << "Parsing config file failed";
+    return -1;
+  }
+
+  if (document.HasMember("frame_policy")) {
+    if (parse_frame_policy(document["frame_policy"].GetString(),
+                           &frame_policy_) != 0) {
+      return -1;
+    }
+  }
+
+  if (document.HasMember("max_age_ms")) {
+    max_age_us_ = document["max_age_ms"].GetInt() * 1000ULL;
   }
 
+  if (frame_policy_ == FramePolicy::MAX_AGE && max_age_us_ == 0) {
+    LOG(ERROR) << "max_age_ms is required by max_age frame policy";
+    return -1;
+  }
   return 0;
 }
 
+bool DataIterator::ApplyFramePolicy(std::vector<ImageTensor *> image_tensors) {
+  if (frame_policy_ == FramePolicy::EVERY) {
+    return true;
+  }
+
+  std::vector<ImageTensor> newer(image_tensors.size());
+  std::vector<ImageTensor *> newer_ptrs;
+  for (auto &image_tensor : newer) {
+    newer_ptrs.push_back(&image_tensor);
+  }
+  while (true) {
+    bool is_stale = false;
+    if (frame_policy_ == FramePolicy::MAX_AGE) {
+      is_stale = IsStale(*image_tensors[0]);
+      if (!is_stale) {
+        return true;
+      }
+    }
+
+    bool has_newer = TryNextReady(newer_ptrs);
+    if (!has_newer && !is_stale) {
+      return true;
+    }
+
+    for (auto image_tensor : image_tensors) {
+      Release(image_tensor);
+    }
+    if (is_stale) {
+      stale_dropped_count_++;
+    } else {
+      latest_dropped_count_++;
+    }
+    if (!has_newer) {
+      return false;
+    }
+    for (size_t i = 0; i < image_tensors.size(); i++) {
+      *image_tensors[i] = newer[i];
+    }
+  }
+}
+
+bool DataIterator::IsStale(const ImageTensor &image_tensor) {
+  return frame_policy_ == FramePolicy::MAX_AGE && image_tensor.receive_ts > 0 &&
+         Stopwatch::CurrentTs() - image_tensor.receive_ts > max_age_us_;
+}
+
+void DataIterator::CountEvicted(const ImageTensor &image_tensor) {
+  if (frame_policy_ == FramePolicy::LATEST) {
+    latest_dropped_count_++;
+  } else if (IsStale(image_tensor)) {
+    stale_dropped_count_++;
+  } else {
+    overflow_dropped_count_++;
+  }
+}
+
+std::string DataIterator::FramePolicyStatistics() {
+  std::stringstream ss;
+  ss << "dropped to latest:" << latest_dropped_count_
+     << ", dropped as stale:" << stale_dropped_count_
+     << ", dropped on overflow:" << overflow_dropped_count_;
+  return ss.str();
+}
+
+DataIterator::~DataIterator() {
+  if (frame_policy_ != FramePolicy::EVERY) {
+    LOG(INFO) << module_name_ << " frame policy " << FramePolicyStatistics();
+  }
+}
+
 int DataIterator::LoadConfigFile(std::string& config_file) {
   std::ifstream ifs(config_file.c_str());
   if (!ifs) {
@@ -44,6 +171,10 @@ int DataIterator::LoadConfigFile(std::string& config_file) {
   std::stringstream buffer;
   buffer << ifs.rdbuf();
   std::string contents(buffer.str());
+  int ret_code = this->LoadFramePolicy(contents);
+  if (ret_code != 0) {
+    return ret_code;
+  }
   return this->LoadConfig(contents);
 }
 
@@ -60,6 +191,14 @@ DataIterator* DataIterator::GetImpl(const std::string& module_name) {
     return new CameraDataIterator();
   } else if (module_name == "feature") {
     return new FeatureIterator;
+  } else if (module_name == "packed") {
+    return new PackedDataIterator();
+  } else if (module_name == "replay") {
+    return new ReplayDataIterator();
+  } else if (module_name == "video") {
+    return new VideoDataIterator();
+  } else if (module_name == "mutil_modal_video") {
+    return new VideoDataIterator(true);
   } else {
     LOG(FATAL) << "Unsupported module:" << module_name;
   }
@@ -0,0 +1,130 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "input/frame_record.h"
+
+#include "glog/logging.h"
+#include "utils/tensor_utils.h"
+
+int FrameRecordWriter::Open(const std::string &path, int width, int height) {
+  Close();
+  ofs_.open(path, std::ios::out | std::ios::binary);
+  if (!ofs_.is_open()) {
+    LOG(ERROR) << "Open " << path << " failed";
+    return -1;
+  }
+
+  header_ = FrameRecordHeader();
+  header_.magic = FRAME_RECORD_MAGIC;
+  header_.version = FRAME_RECORD_VERSION;
+  header_.width = width;
+  header_.height = height;
+  header_.stride = ALIGN_16(width);
+  padding_.assign(header_.stride - width, 0);
+  ofs_.write(reinterpret_cast<const char *>(&header_), sizeof(header_));
+  return ofs_.good() ? 0 : -1;
+}
+
+int FrameRecordWriter::Write(uint64_t timestamp,
+                             const uint8_t *y,
+                             int y_step,
+                             const uint8_t *uv,
+                             int uv_step) {
+  int width = header_.width, height = header_.height;
+  FrameHeader frame_header = FrameHeader();
+  frame_header.timestamp = timestamp;
+  frame_header.size = header_.stride * (height + height / 2);
+  ofs_.write(reinterpret_cast<const char *>(&frame_header),
+             sizeof(frame_header));
+
+  auto write_rows = [&](const uint8_t *plane, int step, int rows) {
+    for (int i = 0; i < rows; i++) {
+      ofs_.write(reinterpret_cast<const char *>(plane + i * step), width);
+      ofs_.write(padding_.data(), padding_.size());
+    }
+  };
+  write_rows(y, y_step, height);
+  write_rows(uv, uv_step, height / 2);
+
+  if (!ofs_.good()) {
+    LOG(ERROR) << "Write frame record failed";
+    return -1;
+  }
+  return 0;
+}
+
+void FrameRecordWriter::Close() {
+  if (ofs_.is_open()) {
+    ofs_.close();
+  }
+}
+
+int FrameRecordReader::Open(const std::string &path) {
+  path_ = path;
+  ifs_.open(path, std::ios::in | std::ios::binary);
+  if (!ifs_.is_open()) {
+    LOG(ERROR) << "Open " << path << " failed";
+    return -1;
+  }
+
+  ifs_.read(reinterpret_cast<char *>(&header_), sizeof(header_));
+  if (!ifs_ || header_.magic != FRAME_RECORD_MAGIC ||
+      header_.version != FRAME_RECORD_VERSION) {
+    LOG(ERROR) << path << " is not a frame record of version "
+               << FRAME_RECORD_VERSION;
+    return -1;
+  }
+  return 0;
+}
+
+int FrameRecordReader::ReadTimestamps(std::vector<uint64_t> *timestamps) {
+  timestamps->clear();
+  FrameHeader frame_header;
+  while (ifs_.read(reinterpret_cast<char *>(&frame_header),
+                   sizeof(frame_header))) {
+    timestamps->push_back(frame_header.timestamp);
+    ifs_.seekg(frame_header.size, std::ios::cur);
+  }
+  Rewind();
+  return 0;
+}
+
+int FrameRecordReader::Read(uint64_t *timestamp, BPU_TENSOR_S *tensor) {
+  FrameHeader frame_header;
+  if (!ifs_.read(reinterpret_cast<char *>(&frame_header),
+                 sizeof(frame_header))) {
+    return -1;
+  }
+
+  uint64_t data_size = tensor->data.memSize;
+  uint64_t data_ext_size = tensor->data_type == BPU_TYPE_IMG_NV12_SEPARATE
+                               ? tensor->data_ext.memSize
+                               : 0;
+  if (frame_header.size != data_size + data_ext_size) {
+    LOG(ERROR) << "Frame size " << frame_header.size
+               << " does not match tensor size " << data_size + data_ext_size;
+    return -1;
+  }
+
+  ifs_.read(reinterpret_cast<char *>(tensor->data.virAddr), data_size);
+  if (data_ext_size > 0) {
+    ifs_.read(reinterpret_cast<char *>(tensor->data_ext.virAddr),
+              data_ext_size);
+  }
+  if (!ifs_) {
+    LOG(ERROR) << path_ << " is truncated";
+    return -1;
+  }
+  *timestamp = frame_header.timestamp;
+  return 0;
+}
+
+void FrameRecordReader::Rewind() {
+  ifs_.clear();
+  ifs_.seekg(sizeof(FrameRecordHeader), std::ios::beg);
+}
@@ -8,14 +8,8 @@
 
 #include "input/image_list_data_iterator.h"
 
-#include <iostream>
-
 #include "glog/logging.h"
-#include "rapidjson/document.h"
-#include "rapidjson/istreamwrapper.h"
 #include "utils/stop_watch.h"
-#include "utils/tensor_utils.h"
-#include "utils/utils.h"
 
 int ImageListDataIterator::Init(std::string config_file,
                                 std::string config_string) {
@@ -24,121 +18,37 @@ int ImageListDataIterator::Init(std::string config_file,
   if (ret_code != 0) {
     return -1;
   }
-
-  ifs_.open(image_list_file_, std::ios::in);
-  if (!ifs_.is_open()) {
-    LOG(ERROR) << "Open " << image_list_file_ << " failed";
-    return -1;
-  }
-
-  return 0;
+  return loader_.Init({ColorMode::BGR});
 }
 
 bool ImageListDataIterator::Next(ImageTensor *image_tensor) {
-  if (ifs_.eof()) {
-    is_finish_ = true;
-    return false;
-  }
-
-  std::string image_file;
-  ifs_ >> image_file;
-
-  if (image_file.empty()) {
+  if (!loader_.Next({image_tensor}, &is_finish_)) {
     return false;
   }
-
-  auto &tensor = image_tensor->tensor;
-  prepare_image_tensor(height_, width_, data_type_, &tensor);
-  read_image_tensor(image_file,
-                    image_tensor->ori_image_width,
-                    image_tensor->ori_image_height,
-                    &tensor);
-  image_tensor->image_name = get_file_name(image_file);
   image_tensor->timestamp = Stopwatch::CurrentTs();
   image_tensor->frame_id = NextFrameId();
-  flush_tensor(&tensor);
   return true;
 }
-bool ImageListDataIterator::Next(ImageTensor *visible_image_tensor,ImageTensor *lwir_image_tensor){
-if (ifs_.eof()) {
-    is_finish_ = true;
-    return false;
-  }
 
-  std::string image_file;
-  ifs_ >> image_file;
-
-  std::vector<std::string> pairs = s_split(image_file,";");
-  std::string visible_image_file = pairs[0];
-  std::string lwir_image_file = pairs[1];
-
-  std::cout<<visible_image_file<<std::endl;
-  std::cout<<lwir_image_file<<std::endl;
-  if (visible_image_file.empty() || lwir_image_file.empty()) {
+bool ImageListDataIterator::Next(ImageTensor *visible_image_tensor,ImageTensor *lwir_image_tensor){
+  if (!loader_.Next({visible_image_tensor, lwir_image_tensor}, &is_finish_)) {
     return false;
   }
-
-  auto &visible_tensor = visible_image_tensor->tensor;
-  auto &lwir_tensor = lwir_image_tensor->tensor;
-  prepare_image_tensor(height_, width_, data_type_, &visible_tensor);
-  prepare_image_tensor(height_, width_, data_type_, &lwir_tensor);
-
-  read_image_tensor(visible_image_file,
-                    visible_image_tensor->ori_image_width,
-                    visible_image_tensor->ori_image_height,
-                    &visible_tensor);
-  read_image_tensor(lwir_image_file,
-                    lwir_image_tensor->ori_image_width,
-                    lwir_image_tensor->ori_image_height,
-                    &lwir_tensor);
-
-  visible_image_tensor->image_name = get_file_name(visible_image_file);
-  lwir_image_tensor->image_name = get_file_name(lwir_image_file);
   visible_image_tensor->timestamp = Stopwatch::CurrentTs();
   lwir_image_tensor->timestamp = visible_image_tensor->timestamp;
   visible_image_tensor->frame_id = NextFrameId();
   lwir_image_tensor->frame_id = visible_image_tensor->frame_id;
-  flush_tensor(&visible_tensor);
-  flush_tensor(&lwir_tensor);
   return true;
 }
+
 void ImageListDataIterator::Release(ImageTensor *image_tensor) {
-  release_tensor(&image_tensor->tensor);
+  loader_.Release(image_tensor);
 }
 
 int ImageListDataIterator::LoadConfig(std::string &config_string) {
-  rapidjson::Document document;
-  document.Parse(config_string.data());
-
-  if (document.HasParseError()) {
-    LOG(ERROR) << "Parsing config file failed";
-    return -1;
-  }
-
-  if (document.HasMember("image_list_file")) {
-    image_list_file_ = document["image_list_file"].GetString();
-  }
-
-  if (document.HasMember("width")) {
-    width_ = document["width"].GetInt();
-  }
-
-  if (document.HasMember("height")) {
-    height_ = document["height"].GetInt();
-  }
-
-  if (document.HasMember("data_type")) {
-    data_type_ =
-        static_cast<hb_BPU_DATA_TYPE_E>(document["data_type"].GetInt());
-  }
-
-  return 0;
+  return loader_.LoadConfig(config_string);
 }
 
-ImageListDataIterator::~ImageListDataIterator() {
-  if (ifs_.is_open()) {
-    ifs_.close();
-  }
-}
+ImageListDataIterator::~ImageListDataIterator() {}
 
 bool ImageListDataIterator::HasNext() { return !is_finish_; }
@@ -0,0 +1,378 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "input/image_prefetcher.h"
+
+#include <algorithm>
+#include <future>
+
+#include "glog/logging.h"
+#include "rapidjson/document.h"
+#include "utils/jpeg_utils.h"
+#include "utils/utils.h"
+
+int ImagePrefetcher::Init(int prefetch_depth,
+                          int decode_threads,
+                          Reader reader,
+                          Loader loader,
+                          Releaser releaser) {
+  if (prefetch_depth < 1 || decode_threads < 1) {
+    LOG(ERROR) << "Invalid prefetch_depth:" << prefetch_depth
+               << " or decode_threads:" << decode_threads;
+    return -1;
+  }
+  prefetch_depth_ = prefetch_depth;
+  reader_ = reader;
+  loader_ = loader;
+  releaser_ = releaser;
+  for (int i = 0; i < decode_threads; i++) {
+    threads_.emplace_back(&ImagePrefetcher::DecodeLoop, this);
+  }
+  return 0;
+}
+
+void ImagePrefetcher::ReadAhead() {
+  if (list_end_ || read_seq_ - next_seq_ >= prefetch_depth_) {
+    return;
+  }
+
+  auto entry = std::make_shared<Entry>();
+  if (!reader_(&entry->paths)) {
+    list_end_ = true;
+    // Consumer may be waiting for an entry that will never come
+    cv_.notify_all();
+    return;
+  }
+
+  int count = entry->paths.size();
+  entry->frames.resize(count);
+  entry->loaded.resize(count, false);
+  entry->pending = count;
+  for (int i = 0; i < count; i++) {
+    Task task;
+    task.entry = entry;
+    task.index = i;
+    tasks_.push_back(task);
+  }
+  entries_[read_seq_++] = entry;
+  cv_.notify_all();
+}
+
+void ImagePrefetcher::DecodeLoop() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] {
+      return stop_ || !tasks_.empty() ||
+             (!list_end_ && read_seq_ - next_seq_ < prefetch_depth_);
+    });
+    if (stop_) {
+      return;
+    }
+    if (tasks_.empty()) {
+      ReadAhead();
+      continue;
+    }
+
+    Task task = tasks_.front();
+    tasks_.pop_front();
+    auto &entry = task.entry;
+    lock.unlock();
+    int ret = loader_(
+        entry->paths[task.index], task.index, &entry->frames[task.index]);
+    lock.lock();
+    if (ret != 0) {
+      LOG(ERROR) << "Load image failed, path:" << entry->paths[task.index];
+    }
+    entry->loaded[task.index] = ret == 0;
+    if (--entry->pending == 0) {
+      cv_.notify_all();
+    }
+  }
+}
+
+bool ImagePrefetcher::Next(std::vector<ImageTensor> *frames) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    cv_.wait(lock, [this] {
+      auto it = entries_.find(next_seq_);
+      return stop_ || (it != entries_.end() && it->second->pending == 0) ||
+             (list_end_ && next_seq_ == read_seq_);
+    });
+    auto it = entries_.find(next_seq_);
+    if (it == entries_.end() || it->second->pending != 0) {
+      return false;
+    }
+
+    auto entry = it->second;
+    entries_.erase(it);
+    next_seq_++;
+    // A slot is free for read ahead
+    cv_.notify_all();
+
+    bool failed = false;
+    for (bool loaded : entry->loaded) {
+      failed = failed || !loaded;
+    }
+    if (!failed) {
+      frames->swap(entry->frames);
+      return true;
+    }
+    for (size_t i = 0; i < entry->frames.size(); i++) {
+      if (entry->loaded[i]) {
+        releaser_(&entry->frames[i]);
+      }
+    }
+  }
+}
+
+void ImagePrefetcher::Stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    cv_.notify_all();
+  }
+  for (auto &thread : threads_) {
+    thread.join();
+  }
+  threads_.clear();
+
+  for (auto &it : entries_) {
+    auto &entry = it.second;
+    for (size_t i = 0; i < entry->frames.size(); i++) {
+      if (entry->loaded[i]) {
+        releaser_(&entry->frames[i]);
+      }
+    }
+  }
+  entries_.clear();
+  tasks_.clear();
+}
+
+ImagePrefetcher::~ImagePrefetcher() { Stop(); }
+
+int ImageListLoader::LoadConfig(const std::string &config_string) {
+  rapidjson::Document document;
+  document.Parse(config_string.data());
+
+  if (document.HasParseError()) {
+    LOG(ERROR) << "Parsing config file failed";
+    return -1;
+  }
+
+  if (document.HasMember("image_list_file")) {
+    image_list_file_ = document["image_list_file"].GetString();
+  }
+
+  if (document.HasMember("width")) {
+    width_ = document["width"].GetInt();
+  }
+
+  if (document.HasMember("height")) {
+    height_ = document["height"].GetInt();
+  }
+
+  if (document.HasMember("data_type")) {
+    data_type_ =
+        static_cast<hb_BPU_DATA_TYPE_E>(document["data_type"].GetInt());
+  }
+
+  if (document.HasMember("tensor_pool")) {
+    enable_tensor_pool_ = document["tensor_pool"].GetBool();
+  }
+
+  if (document.HasMember("prefetch_depth")) {
+    prefetch_depth_ = document["prefetch_depth"].GetInt();
+  }
+
+  if (document.HasMember("decode_threads")) {
+    decode_threads_ = document["decode_threads"].GetInt();
+  }
+
+  if (document.HasMember("jpeg_decoder")) {
+    std::string jpeg_decoder = document["jpeg_decoder"].GetString();
+    if (jpeg_decoder != "opencv" && jpeg_decoder != "turbojpeg") {
+      LOG(ERROR) << "Unknown jpeg decoder:" << jpeg_decoder;
+      return -1;
+    }
+    use_turbojpeg_ = jpeg_decoder == "turbojpeg";
+  }
+
+  if (document.HasMember("resize_mode")) {
+    if (parse_resize_mode(document["resize_mode"].GetString(),
+                          &resize_mode_) != 0) {
+      return -1;
+    }
+  }
+
+  return 0;
+}
+
+int ImageListLoader::Init(const std::vector<ColorMode> &color_modes) {
+  color_modes_ = color_modes;
+  if (prefetch_depth_ < 0 || (prefetch_depth_ > 0 && decode_threads_ < 1)) {
+    LOG(ERROR) << "Invalid prefetch_depth:" << prefetch_depth_
+               << " or decode_threads:" << decode_threads_;
+    return -1;
+  }
+
+  ifs_.open(image_list_file_, std::ios::in);
+  if (!ifs_.is_open()) {
+    LOG(ERROR) << "Open " << image_list_file_ << " failed";
+    return -1;
+  }
+
+  // Prefetched frames always come from the pool, at most
+  // prefetch_depth entries are in flight besides the ones being inferred
+  if (enable_tensor_pool_ || prefetch_depth_ > 0) {
+    tensor_pool_.reset(new TensorPool(default_bpu_mem_allocator(),
+                                      std::max(16, prefetch_depth_ * 2)));
+  }
+  return 0;
+}
+
+int ImageListLoader::StartPrefetch(int image_num) {
+  prefetch_image_num_ = image_num;
+  prefetcher_.reset(new ImagePrefetcher());
+  return prefetcher_->Init(
+      prefetch_depth_,
+      decode_threads_,
+      [this, image_num](std::vector<std::string> *paths) {
+        return ReadEntry(image_num, paths);
+      },
+      [this](const std::string &path, int index, ImageTensor *frame) {
+        return LoadImage(path, index, frame);
+      },
+      [this](ImageTensor *frame) { Release(frame); });
+}
+
+bool ImageListLoader::ReadEntry(int image_num,
+                                std::vector<std::string> *paths) {
+  std::string image_file;
+  while (image_file.empty()) {
+    if (!(ifs_ >> image_file)) {
+      return false;
+    }
+  }
+  *paths = s_split(image_file, ";");
+  if (static_cast<int>(paths->size()) < image_num) {
+    LOG(ERROR) << "Expect " << image_num << " image(s) per line, got "
+               << image_file << ", stop reading " << image_list_file_;
+    return false;
+  }
+  if (static_cast<int>(paths->size()) > image_num) {
+    LOG_IF(WARNING, !extra_image_warned_)
+        << "Only the first " << image_num << " image(s) of every line are "
+        << "used, got " << image_file;
+    extra_image_warned_ = true;
+    paths->resize(image_num);
+  }
+  return true;
+}
+
+int ImageListLoader::LoadImage(const std::string &path,
+                               int modality,
+                               ImageTensor *image_tensor) {
+  auto &tensor = image_tensor->tensor;
+  prepare_image_tensor(
+      height_, width_, data_type_, &tensor, tensor_pool_.get());
+  ColorMode color_mode = modality < static_cast<int>(color_modes_.size())
+                             ? color_modes_[modality]
+                             : ColorMode::BGR;
+  auto read_tensor = use_turbojpeg_ ? read_jpeg_tensor : read_image_tensor;
+  if (read_tensor(path,
+                  image_tensor->ori_image_width,
+                  image_tensor->ori_image_height,
+                  &tensor,
+                  resize_mode_,
+                  color_mode) != 0) {
+    release_tensor(&tensor, tensor_pool_.get());
+    return -1;
+  }
+  image_tensor->is_pad_resize = resize_mode_ == ResizeMode::LETTERBOX;
+  image_tensor->image_name = get_file_name(path);
+  flush_tensor(&tensor);
+  return 0;
+}
+
+bool ImageListLoader::Next(const std::vector<ImageTensor *> &image_tensors,
+                           bool *is_finish) {
+  int image_num = image_tensors.size();
+  if (prefetch_depth_ > 0) {
+    if (!prefetcher_ && StartPrefetch(image_num) != 0) {
+      *is_finish = true;
+      return false;
+    }
+    if (image_num != prefetch_image_num_) {
+      LOG(ERROR) << "Prefetching " << prefetch_image_num_
+                 << " image(s) per line, can not take " << image_num;
+      *is_finish = true;
+      return false;
+    }
+
+    std::vector<ImageTensor> frames;
+    if (!prefetcher_->Next(&frames)) {
+      *is_finish = true;
+      return false;
+    }
+    for (int i = 0; i < image_num; i++) {
+      *image_tensors[i] = frames[i];
+    }
+    return true;
+  }
+
+  std::vector<std::string> paths;
+  if (!ReadEntry(image_num, &paths)) {
+    *is_finish = true;
+    return false;
+  }
+  // Every other modality is loaded on a worker thread while the first one
+  // is loaded here, the entry is ready once all of them are
+  std::vector<std::future<int>> loads;
+  for (int i = 1; i < image_num; i++) {
+    loads.push_back(
+        std::async(std::launch::async, [this, &paths, &image_tensors, i] {
+          return LoadImage(paths[i], i, image_tensors[i]);
+        }));
+  }
+  std::vector<int> ret_codes(image_num);
+  ret_codes[0] = LoadImage(paths[0], 0, image_tensors[0]);
+  for (int i = 1; i < image_num; i++) {
+    ret_codes[i] = loads[i - 1].get();
+  }
+
+  bool success = true;
+  for (int i = 0; i < image_num; i++) {
+    if (ret_codes[i] != 0) {
+      LOG(ERROR) << "Load image failed, path:" << paths[i];
+      success = false;
+    }
+  }
+  if (!success) {
+    for (int i = 0; i < image_num; i++) {
+      if (ret_codes[i] == 0) {
+        Release(image_tensors[i]);
+      }
+    }
+  }
+  return success;
+}
+
+void ImageListLoader::Release(ImageTensor *image_tensor) {
+  release_tensor(&image_tensor->tensor, tensor_pool_.get());
+}
+
+ImageListLoader::~ImageListLoader() {
+  // Give prefetched frames back before the pool goes away
+  prefetcher_.reset();
+  if (tensor_pool_) {
+    LOG(INFO) << "Input tensor pool " << tensor_pool_->Statistics();
+  }
+  if (ifs_.is_open()) {
+    ifs_.close();
+  }
+}
@@ -8,20 +8,189 @@
 
 #include "input/network_data_iterator.h"
 
+#include <algorithm>
+#include <cstring>
 #include <iostream>
+#include <sstream>
 #include <string>
 #include <utility>
 
 #include "glog/logging.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/wire_format_lite.h"
 #include "rapidjson/document.h"
 #include "rapidjson/istreamwrapper.h"
+#include "utils/stop_watch.h"
 #include "utils/tensor_utils.h"
 
-#define RECV_QUEUE_SIZE 2
 #define RECV_BUF_SIZE (1 * 1024 * 1024)
+// Receiver thread checks for stop at this interval
+#define RECV_POLL_MS 100
+#define RECV_WARN_MS 10000
+// Optional first part of a message: magic, int32 frame id & uint64 capture
+// timestamp in us, little endian. A serialized ZMQMsg never starts with
+// the magic, as it would be the tag of an unknown field 9.
+#define FRAME_HEADER_MAGIC "HBFH"
+#define FRAME_HEADER_SIZE 16
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::internal::WireFormatLite;
+
+/**
+ * ZMQMessage::ZMQMsg parsed in place, image_data points into the buffer
+ */
+struct ZMQMsgView {
+  int msg_type = ZMQMessage::ZMQMsg_MsgType_IMAGE_MSG;
+  int image_width = 0;
+  int image_height = 0;
+  int image_dst_width = 0;
+  int image_dst_height = 0;
+  std::string image_name;
+  const uint8_t *image_data = nullptr;
+  uint32_t image_data_size = 0;
+};
+
+static bool is_length_delimited(uint32_t tag) {
+  return WireFormatLite::GetTagWireType(tag) ==
+         WireFormatLite::WIRETYPE_LENGTH_DELIMITED;
+}
+
+static bool is_varint(uint32_t tag) {
+  return WireFormatLite::GetTagWireType(tag) ==
+         WireFormatLite::WIRETYPE_VARINT;
+}
+
+/**
+ * Parse ZMQMessage::ImageMsg fields until the current limit
+ * @param[in] input: stream over buffer
+ * @param[in] buffer: start of the stream buffer
+ * @param[out] view: message view
+ * @return true if success
+ */
+static bool parse_image_msg(CodedInputStream *input,
+                            const uint8_t *buffer,
+                            ZMQMsgView *view) {
+  uint32_t tag;
+  while ((tag = input->ReadTag()) != 0) {
+    int field = WireFormatLite::GetTagFieldNumber(tag);
+    if (field == ZMQMessage::ImageMsg::kImageDataFieldNumber &&
+        is_length_delimited(tag)) {
+      uint32_t length;
+      if (!input->ReadVarint32(&length)) {
+        return false;
+      }
+      view->image_data = buffer + input->CurrentPosition();
+      view->image_data_size = length;
+      if (!input->Skip(length)) {
+        return false;
+      }
+    } else if (field == ZMQMessage::ImageMsg::kImageNameFieldNumber &&
+               is_length_delimited(tag)) {
+      uint32_t length;
+      if (!input->ReadVarint32(&length) ||
+          !input->ReadString(&view->image_name, length)) {
+        return false;
+      }
+    } else if (is_varint(tag) &&
+               (field == ZMQMessage::ImageMsg::kImageWidthFieldNumber ||
+                field == ZMQMessage::ImageMsg::kImageHeightFieldNumber ||
+                field == ZMQMessage::ImageMsg::kImageDstWidthFieldNumber ||
+                field == ZMQMessage::ImageMsg::kImageDstHeightFieldNumber)) {
+      uint32_t value;
+      if (!input->ReadVarint32(&value)) {
+        return false;
+      }
+      if (field == ZMQMessage::ImageMsg::kImageWidthFieldNumber) {
+        view->image_width = static_cast<int32_t>(value);
+      } else if (field == ZMQMessage::ImageMsg::kImageHeightFieldNumber) {
+        view->image_height = static_cast<int32_t>(value);
+      } else if (field == ZMQMessage::ImageMsg::kImageDstWidthFieldNumber) {
+        view->image_dst_width = static_cast<int32_t>(value);
+      } else {
+        view->image_dst_height = static_cast<int32_t>(value);
+      }
+    } else if (!WireFormatLite::SkipField(input, tag)) {
+      return false;
+    }
+  }
+  return input->ConsumedEntireMessage();
+}
+
+/**
+ * Parse ZMQMessage::ZMQMsg without copying image data,
+ * same result as ParseFromArray for the fields used by receiver
+ * @param[in] data: serialized message
+ * @param[in] size: message size
+ * @param[out] view: message view, valid while data is alive
+ * @return true if success
+ */
+static bool parse_zmq_msg(const uint8_t *data, int size, ZMQMsgView *view) {
+  CodedInputStream input(data, size);
+  uint32_t tag;
+  while ((tag = input.ReadTag()) != 0) {
+    int field = WireFormatLite::GetTagFieldNumber(tag);
+    if (field == ZMQMessage::ZMQMsg::kMsgTypeFieldNumber && is_varint(tag)) {
+      uint32_t value;
+      if (!input.ReadVarint32(&value)) {
+        return false;
+      }
+      view->msg_type = static_cast<int32_t>(value);
+    } else if (field == ZMQMessage::ZMQMsg::kImgMsgFieldNumber &&
+               is_length_delimited(tag)) {
+      uint32_t length;
+      if (!input.ReadVarint32(&length)) {
+        return false;
+      }
+      auto limit = input.PushLimit(length);
+      if (!parse_image_msg(&input, data, view)) {
+        return false;
+      }
+      input.PopLimit(limit);
+    } else if (!WireFormatLite::SkipField(&input, tag)) {
+      return false;
+    }
+  }
+  return input.ConsumedEntireMessage();
+}
+
+/**
+ * Parse frame header part
+ * @param[in] msg: zmq message part
+ * @param[out] frame_id: sender frame id
+ * @param[out] timestamp: sender capture timestamp
+ * @return false if the part is not a frame header
+ */
+static bool parse_frame_header(zmq_msg_t *msg,
+                               int32_t *frame_id,
+                               uint64_t *timestamp) {
+  if (zmq_msg_size(msg) != FRAME_HEADER_SIZE) {
+    return false;
+  }
+  auto data = reinterpret_cast<const char *>(zmq_msg_data(msg));
+  if (memcmp(data, FRAME_HEADER_MAGIC, 4) != 0) {
+    return false;
+  }
+  memcpy(frame_id, data + 4, sizeof(int32_t));
+  memcpy(timestamp, data + 8, sizeof(uint64_t));
+  return true;
+}
+
+int parse_overflow_policy(const std::string &name, OverflowPolicy *policy) {
+  if (name == "block") {
+    *policy = OverflowPolicy::BLOCK;
+  } else if (name == "drop_oldest") {
+    *policy = OverflowPolicy::DROP_OLDEST;
+  } else if (name == "drop_newest") {
+    *policy = OverflowPolicy::DROP_NEWEST;
+  } else {
+    LOG(ERROR) << "Unknown overflow policy:" << name;
+    return -1;
+  }
+  return 0;
+}
 
 NetworkReceiver::NetworkReceiver()
-    : socket_recv_(nullptr), zmq_context_(nullptr), zmq_msg_(0) {}
+    : socket_recv_(nullptr), zmq_context_(nullptr) {}
 
 NetworkReceiver::~NetworkReceiver() { Fini(); }
 
@@ -29,7 +198,9 @@ bool NetworkReceiver::Init(const char *end_point) {
   zmq_context_ = zmq_ctx_new();
   socket_recv_ = zmq_socket(zmq_context_, ZMQ_PULL);
 
-  int hwm = RECV_QUEUE_SIZE;
+  // Frames buffered by zmq come on top of the frame queue, keep the same
+  // depth so a blocked consumer pushes back on senders without a backlog
+  int hwm = queue_depth_;
   int rc = zmq_setsockopt(socket_recv_, ZMQ_RCVHWM, &hwm, sizeof(int));
   if (rc != 0) {
     LOG(WARNING) << strerror(errno);
@@ -43,100 +214,282 @@ bool NetworkReceiver::Init(const char *end_point) {
     return false;
   }
 
+  int timeout = RECV_POLL_MS;
+  rc = zmq_setsockopt(socket_recv_, ZMQ_RCVTIMEO, &timeout, sizeof(int));
+  if (rc != 0) {
+    LOG(WARNING) << strerror(errno);
+    return false;
+  }
+
   rc = zmq_bind(socket_recv_, end_point);
   if (rc != 0) {
     LOG(WARNING) << strerror(errno);
     return false;
   }
 
+  frame_queue_.SetCapacity(queue_depth_);
+  tensor_pool_.reset(new TensorPool(default_bpu_mem_allocator(),
+                                    std::max(16, queue_depth_ * 2)));
+  recv_thread_ = std::thread(&NetworkReceiver::RecvLoop, this);
   LOG(INFO) << "Start to receive data from addr: " << end_point;
   return true;
 }
 
-void NetworkReceiver::SetDataType(hb_BPU_DATA_TYPE_E data_type) {
+void NetworkReceiver::SetDataType(hb_BPU_DATA_TYPE_E data_type,
+                                  hb_BPU_DATA_TYPE_E lwir_data_type) {
   data_type_ = data_type;
+  lwir_data_type_ = lwir_data_type;
+}
+
+void NetworkReceiver::SetQueue(int queue_depth,
+                               OverflowPolicy overflow_policy) {
+  queue_depth_ = std::max(queue_depth, 1);
+  overflow_policy_ = overflow_policy;
 }
 
 void NetworkReceiver::Fini() {
-  zmq_close(socket_recv_);
-  zmq_ctx_destroy(zmq_context_);
+  stop_ = true;
+  frame_queue_.Close();
+  if (recv_thread_.joinable()) {
+    recv_thread_.join();
+  }
+  Frame *frame;
+  while (frame_queue_.TryPop(&frame)) {
+    if (frame != nullptr) {
+      ReleaseFrame(frame);
+    }
+  }
+  if (tensor_pool_ && socket_recv_ != nullptr) {
+    LOG(INFO) << "Network receiver " << Statistics() << ", input tensor pool "
+              << tensor_pool_->Statistics();
+  }
+
+  if (socket_recv_ != nullptr) {
+    zmq_close(socket_recv_);
+    socket_recv_ = nullptr;
+  }
+  if (zmq_context_ != nullptr) {
+    zmq_ctx_destroy(zmq_context_);
+    zmq_context_ = nullptr;
+  }
 }
 
-int NetworkReceiver::RecvImage(ImageTensor &image_tensor) {
-  while (buf_queue_.empty()) {
-    if (this->Recv() != OK) break;
+int NetworkReceiver::ParseImage(zmq_msg_t *msg,
+                                hb_BPU_DATA_TYPE_E data_type,
+                                ImageTensor *image_tensor) {
+  int msg_size = zmq_msg_size(msg);
+  auto msg_data = reinterpret_cast<const uint8_t *>(zmq_msg_data(msg));
+
+  // Image data is copied once, from zmq buffer to tensor
+  ZMQMsgView zmq_msg;
+  if (!parse_zmq_msg(msg_data, msg_size, &zmq_msg)) {
+    LOG(ERROR) << "Parse zmq message failed, size:" << msg_size;
+    return INVALID;
+  }
+  if (zmq_msg.msg_type == ZMQMessage::ZMQMsg_MsgType_FINISH_MSG) {
+    return FINISHED;
+  }
+  if (zmq_msg.msg_type != ZMQMessage::ZMQMsg_MsgType_IMAGE_MSG) {
+    LOG(ERROR) << "Unknown zmq message type:" << zmq_msg.msg_type;
+    return INVALID;
   }
 
-  while (buf_queue_.size() < 1) {
-    if (this->Recv() != OK) break;
+  image_tensor->ori_image_width = zmq_msg.image_width;
+  image_tensor->ori_image_height = zmq_msg.image_height;
+  image_tensor->image_name = zmq_msg.image_name;
+  // TODO(yingxiang.hong): remove is_pad_resize
+  image_tensor->is_pad_resize = true;
+  auto &tensor = image_tensor->tensor;
+  prepare_image_tensor(zmq_msg.image_dst_height,
+                       zmq_msg.image_dst_width,
+                       data_type,
+                       &tensor,
+                       tensor_pool_.get());
+  if (copy_to_tensor(zmq_msg.image_data, zmq_msg.image_data_size, &tensor) !=
+      0) {
+    LOG(ERROR) << "Image " << zmq_msg.image_name << " does not fit "
+               << zmq_msg.image_dst_width << "x" << zmq_msg.image_dst_height
+               << " tensor";
+    release_tensor(&tensor, tensor_pool_.get());
+    return INVALID;
   }
+  flush_tensor(&tensor);
+  return OK;
+}
 
-  if (buf_queue_.size() < 1) {
-    return TIMEOUT;
+int NetworkReceiver::RecvFrame(Frame *frame) {
+  int ret_code = OK;
+  bool more = true;
+  bool has_header = false;
+  int32_t frame_id = -1;
+  uint64_t timestamp = 0;
+  for (int part = 0; more; part++) {
+    zmq_msg_t msg;
+    zmq_msg_init(&msg);
+    if (zmq_msg_recv(&msg, socket_recv_, 0) == -1) {
+      zmq_msg_close(&msg);
+      // Parts of one message arrive together, so only the first part
+      // could time out
+      // TODO(yingxiang.hong): should handle other errors
+      if (part == 0) {
+        return TIMEOUT;
+      }
+      ret_code = INVALID;
+      break;
+    }
+    more = zmq_msg_more(&msg);
+    // Keep draining parts of a broken message
+    if (ret_code == OK) {
+      if (part == 0 && parse_frame_header(&msg, &frame_id, &timestamp)) {
+        has_header = true;
+      } else {
+        ImageTensor image_tensor;
+        ret_code = ParseImage(&msg,
+                              frame->size() == 1 ? lwir_data_type_ : data_type_,
+                              &image_tensor);
+        if (ret_code == OK) {
+          frame->push_back(image_tensor);
+        }
+      }
+    }
+    zmq_msg_close(&msg);
   }
 
-  zmq_msg_t *msg = buf_queue_.front();
-  buf_queue_.pop_front();
-  int msg_size = zmq_msg_size(msg);
-  char *msg_data = reinterpret_cast<char *>(zmq_msg_data(msg));
+  if (ret_code == OK && frame->empty()) {
+    LOG(ERROR) << "Frame header without images";
+    ret_code = INVALID;
+  }
+  if (ret_code != OK) {
+    for (auto &image_tensor : *frame) {
+      Release(&image_tensor);
+    }
+    frame->clear();
+    return ret_code;
+  }
 
-  ZMQMessage::ZMQMsg zmq_msg;
-  zmq_msg.ParseFromString(std::string(msg_data, msg_size));
+  auto receive_ts = Stopwatch::CurrentTs();
+  for (auto &image_tensor : *frame) {
+    image_tensor.frame_id = frame_id;
+    image_tensor.timestamp = has_header ? timestamp : receive_ts;
+    image_tensor.receive_ts = receive_ts;
+  }
+  return OK;
+}
 
-  if (zmq_msg.msg_type() == ZMQMessage::ZMQMsg_MsgType_IMAGE_MSG) {
-    const ZMQMessage::ImageMsg &image_msg = zmq_msg.img_msg();
+void NetworkReceiver::RecvLoop() {
+  int idle_ms = 0;
+  while (!stop_) {
+    auto *frame = new Frame();
+    int ret_code = RecvFrame(frame);
+    if (ret_code != OK) {
+      delete frame;
+    }
 
-    image_tensor.ori_image_width = image_msg.image_width();
-    image_tensor.ori_image_height = image_msg.image_height();
-    image_tensor.image_name = image_msg.image_name();
-    // TODO(yingxiang.hong): remove is_pad_resize
-    image_tensor.is_pad_resize = true;
-    auto &tensor = image_tensor.tensor;
-    prepare_image_tensor(image_msg.image_dst_height(),
-                         image_msg.image_dst_width(),
-                         data_type_,
-                         &tensor);
-    const std::string &data = image_msg.image_data();
-    memcpy(tensor.data.virAddr, data.data(), data.length());
-    flush_tensor(&tensor);
+    if (ret_code == TIMEOUT) {
+      idle_ms += RECV_POLL_MS;
+      if (idle_ms >= RECV_WARN_MS) {
+        LOG(WARNING) << "Receive image timeout";
+        idle_ms = 0;
+      }
+      continue;
+    }
+    idle_ms = 0;
+
+    if (ret_code == FINISHED) {
+      // Never dropped, consumer stops after the queued frames
+      frame_queue_.Push(nullptr);
+      break;
+    }
+    if (ret_code == OK) {
+      Enqueue(frame);
+    }
   }
+}
 
-  zmq_msg_close(msg);
-  delete msg;
+void NetworkReceiver::Enqueue(Frame *frame) {
+  Frame *dropped = nullptr;
+  switch (overflow_policy_) {
+    case OverflowPolicy::BLOCK:
+      if (!frame_queue_.Push(frame)) {
+        dropped = frame;
+      }
+      break;
+    case OverflowPolicy::DROP_OLDEST:
+      frame_queue_.PushEvictOldest(frame, &dropped);
+      break;
+    case OverflowPolicy::DROP_NEWEST:
+      if (!frame_queue_.TryPush(frame)) {
+        dropped = frame;
+      }
+      break;
+  }
 
-  if (zmq_msg.msg_type() == ZMQMessage::ZMQMsg_MsgType_FINISH_MSG) {
-    return FINISHED;
-  } else {
-    return OK;
+  if (dropped != frame) {
+    queued_count_++;
+  }
+  if (dropped != nullptr) {
+    dropped_count_++;
+    DLOG(INFO) << "Drop frame " << dropped->front().image_name;
+    ReleaseFrame(dropped);
   }
 }
 
-int NetworkReceiver::Recv() {
-  int timeout = 10000;
-  zmq_setsockopt(socket_recv_, ZMQ_RCVTIMEO, &timeout, sizeof(int));
+int NetworkReceiver::NextImages(std::vector<ImageTensor *> image_tensors) {
+  Frame *frame = nullptr;
+  if (finished_ || !frame_queue_.Pop(&frame) || frame == nullptr) {
+    finished_ = true;
+    return FINISHED;
+  }
+  return TakeFrame(frame, image_tensors);
+}
 
-  if (!zmq_msg_) {
-    zmq_msg_ = new zmq_msg_t;
-    zmq_msg_init(zmq_msg_);
+int NetworkReceiver::TryNextImages(std::vector<ImageTensor *> image_tensors) {
+  Frame *frame = nullptr;
+  if (finished_) {
+    return FINISHED;
+  }
+  if (!frame_queue_.TryPop(&frame)) {
+    return TIMEOUT;
   }
+  if (frame == nullptr) {
+    finished_ = true;
+    return FINISHED;
+  }
+  return TakeFrame(frame, image_tensors);
+}
 
-  while (true) {
-    int rc = zmq_msg_recv(zmq_msg_, socket_recv_, 0);
-    if (rc == -1) {
-      // Assumed that only timeout happens here
-      // TODO(yingxiang.hong): should handle other errors
-      return TIMEOUT;
-    }
-    //    if (!zmq_msg_more(zmq_msg_)) {
-    //      break;
-    //    }
-    break;
+int NetworkReceiver::TakeFrame(Frame *frame,
+                               std::vector<ImageTensor *> image_tensors) {
+  if (frame->size() != image_tensors.size()) {
+    LOG(ERROR) << "Expect " << image_tensors.size()
+               << " image(s) per message, got " << frame->size();
+    ReleaseFrame(frame);
+    return INVALID;
+  }
+  for (size_t i = 0; i < frame->size(); i++) {
+    *image_tensors[i] = (*frame)[i];
   }
-  buf_queue_.push_back(zmq_msg_);
-  zmq_msg_ = NULL;
+  delete frame;
   return OK;
 }
 
+void NetworkReceiver::Release(ImageTensor *image_tensor) {
+  release_tensor(&image_tensor->tensor, tensor_pool_.get());
+}
+
+void NetworkReceiver::ReleaseFrame(Frame *frame) {
+  for (auto &image_tensor : *frame) {
+    Release(&image_tensor);
+  }
+  delete frame;
+}
+
+std::string NetworkReceiver::Statistics() {
+  std::stringstream ss;
+  ss << "queued:" << queued_count_ << ", dropped:" << dropped_count_;
+  return ss.str();
+}
+
 int NetworkDataIterator::Init(std::string config_file,
                               std::string config_string) {
   network_receiver_ = new NetworkReceiver();
@@ -149,26 +502,54 @@ int NetworkDataIterator::Init(std::string config_file,
 }
 
 bool NetworkDataIterator::Next(ImageTensor *image_tensor) {
+  return NextFrame({image_tensor});
+}
+
+bool NetworkDataIterator::Next(ImageTensor *visible_image_tensor,
+                               ImageTensor *lwir_image_tensor) {
+  return NextFrame({visible_image_tensor, lwir_image_tensor});
+}
+
+bool NetworkDataIterator::NextFrame(std::vector<ImageTensor *> image_tensors) {
   while (true) {
-    int ret_code = network_receiver_->RecvImage(*image_tensor);
-    if (ret_code == TIMEOUT) {
-      LOG(WARNING) << "Receive image timeout";
-      continue;
-    }
+    int ret_code = network_receiver_->NextImages(image_tensors);
     if (ret_code == FINISHED) {
       is_finish_ = true;
-    } else {
-      image_tensor->frame_id = NextFrameId();
+      return false;
+    }
+    if (ret_code != OK) {
+      LOG(WARNING) << "Drop invalid message";
+    } else if (ApplyFramePolicy(image_tensors)) {
+      break;
+    }
+  }
+
+  // Frames without a frame header get a local frame id
+  if (image_tensors[0]->frame_id < 0) {
+    auto frame_id = NextFrameId();
+    for (auto image_tensor : image_tensors) {
+      image_tensor->frame_id = frame_id;
     }
-    return !(ret_code == FINISHED);
   }
+  return true;
 }
-bool NetworkDataIterator::Next(ImageTensor *visible_image_tensor,ImageTensor *lwir_image_tensor){
 
-     return true;
+bool NetworkDataIterator::TryNextReady(
+    std::vector<ImageTensor *> image_tensors) {
+  while (true) {
+    int ret_code = network_receiver_->TryNextImages(image_tensors);
+    if (ret_code == OK) {
+      return true;
+    }
+    if (ret_code != INVALID) {
+      return false;
+    }
+    LOG(WARNING) << "Drop invalid message";
+  }
 }
+
 void NetworkDataIterator::Release(ImageTensor *image_tensor) {
-  release_tensor(&image_tensor->tensor);
+  network_receiver_->Release(image_tensor);
 }
 
 int NetworkDataIterator::LoadConfig(std::string &config_string) {
@@ -189,7 +570,26 @@ int NetworkDataIterator::LoadConfig(std::string &config_string) {
         static_cast<hb_BPU_DATA_TYPE_E>(document["data_type"].GetInt());
   }
 
-  network_receiver_->SetDataType(data_type_);
+  if (document.HasMember("queue_depth")) {
+    queue_depth_ = document["queue_depth"].GetInt();
+  }
+
+  if (document.HasMember("overflow_policy")) {
+    if (parse_overflow_policy(document["overflow_policy"].GetString(),
+                              &overflow_policy_) != 0) {
+      return -1;
+    }
+  }
+
+  if (document.HasMember("lwir_data_type")) {
+    lwir_data_type_ = document["lwir_data_type"].GetInt();
+  }
+
+  network_receiver_->SetDataType(
+      data_type_,
+      lwir_data_type_ < 0 ? data_type_
+                          : static_cast<hb_BPU_DATA_TYPE_E>(lwir_data_type_));
+  network_receiver_->SetQueue(queue_depth_, overflow_policy_);
 
   if (network_receiver_->Init(endpoint.c_str())) {
     return 0;
@@ -0,0 +1,130 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "input/packed_data_iterator.h"
+
+#include <vector>
+
+#include "glog/logging.h"
+#include "rapidjson/document.h"
+#include "rapidjson/istreamwrapper.h"
+#include "utils/stop_watch.h"
+
+int PackedDataIterator::Init(std::string config_file,
+                             std::string config_string) {
+  int ret_code = DataIterator::Init(config_file, config_string);
+  if (ret_code != 0) {
+    return -1;
+  }
+
+  if (dataset_.Open(pack_file_) != 0) {
+    return -1;
+  }
+  if (dataset_.Kind() != PACKED_KIND_IMAGE &&
+      dataset_.Kind() != PACKED_KIND_FEATURE) {
+    LOG(ERROR) << "Unknown pack kind:" << dataset_.Kind();
+    return -1;
+  }
+  LOG(INFO) << "Pack " << pack_file_ << " has " << dataset_.Count()
+            << " records";
+
+  // Records of an eval set mostly share one shape
+  tensor_pool_.reset(new TensorPool());
+  dataset_.WillNeed(0, read_ahead_);
+  return 0;
+}
+
+bool PackedDataIterator::Next(ImageTensor *image_tensor) {
+  if (cursor_ >= dataset_.Count()) {
+    is_finish_ = true;
+    return false;
+  }
+
+  int index = cursor_++;
+  auto &record = dataset_.Record(index);
+  auto &tensor = image_tensor->tensor;
+  if (dataset_.Kind() == PACKED_KIND_IMAGE) {
+    if (record.ndim != 2) {
+      LOG(ERROR) << "Image record " << record.name << " has " << record.ndim
+                 << " dims, expect 2";
+      return false;
+    }
+    prepare_image_tensor(record.dims[0],
+                         record.dims[1],
+                         data_type_,
+                         &tensor,
+                         tensor_pool_.get());
+    image_tensor->is_pad_resize = (record.flags & PACKED_FLAG_PAD_RESIZE) != 0;
+  } else {
+    std::vector<int> dims(record.dims, record.dims + record.ndim);
+    prepare_feature_tensor(dims, data_type_, &tensor, tensor_pool_.get());
+  }
+
+  if (copy_to_tensor(dataset_.Data(index), record.size, &tensor) != 0) {
+    LOG(ERROR) << "Record " << record.name << " does not fit the tensor";
+    release_tensor(&tensor, tensor_pool_.get());
+    return false;
+  }
+  flush_tensor(&tensor);
+
+  dataset_.WillNeed(index + read_ahead_, 1);
+  dataset_.DontNeed(index + 1);
+
+  image_tensor->image_name = record.name;
+  image_tensor->ori_image_height = record.ori_height;
+  image_tensor->ori_image_width = record.ori_width;
+  image_tensor->timestamp = Stopwatch::CurrentTs();
+  image_tensor->frame_id = NextFrameId();
+  return true;
+}
+
+bool PackedDataIterator::Next(ImageTensor *visible_image_tensor,
+                              ImageTensor *lwir_image_tensor) {
+  // Nothing can be read as pairs, finish instead of failing every frame
+  LOG(ERROR) << "Packed data iterator does not support mutil modal";
+  is_finish_ = true;
+  return false;
+}
+
+void PackedDataIterator::Release(ImageTensor *image_tensor) {
+  release_tensor(&image_tensor->tensor, tensor_pool_.get());
+}
+
+int PackedDataIterator::LoadConfig(std::string &config_string) {
+  rapidjson::Document document;
+  document.Parse(config_string.data());
+
+  if (document.HasParseError()) {
+    LOG(ERROR) << "Parsing config file failed";
+    return -1;
+  }
+
+  if (document.HasMember("pack_file")) {
+    pack_file_ = document["pack_file"].GetString();
+  }
+
+  if (document.HasMember("data_type")) {
+    data_type_ =
+        static_cast<hb_BPU_DATA_TYPE_E>(document["data_type"].GetInt());
+  }
+
+  if (document.HasMember("read_ahead")) {
+    read_ahead_ = document["read_ahead"].GetInt();
+  }
+
+  return 0;
+}
+
+PackedDataIterator::~PackedDataIterator() {
+  if (tensor_pool_) {
+    LOG(INFO) << "Input tensor pool " << tensor_pool_->Statistics();
+  }
+  dataset_.Close();
+}
+
+bool PackedDataIterator::HasNext() { return !is_finish_; }
@@ -0,0 +1,122 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "input/packed_dataset.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+#include "glog/logging.h"
+
+int PackedDataset::Open(const std::string &path) {
+  Close();
+  fd_ = open(path.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    LOG(ERROR) << "Open " << path << " failed";
+    return -1;
+  }
+
+  struct stat st;
+  if (fstat(fd_, &st) != 0 ||
+      st.st_size < static_cast<off_t>(sizeof(PackedHeader))) {
+    LOG(ERROR) << path << " is not a packed dataset";
+    Close();
+    return -1;
+  }
+  size_ = st.st_size;
+
+  void *addr = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd_, 0);
+  if (addr == MAP_FAILED) {
+    LOG(ERROR) << "Mmap " << path << " failed";
+    size_ = 0;
+    Close();
+    return -1;
+  }
+  base_ = static_cast<uint8_t *>(addr);
+  madvise(base_, size_, MADV_SEQUENTIAL);
+
+  header_ = reinterpret_cast<const PackedHeader *>(base_);
+  if (header_->magic != PACKED_DATASET_MAGIC ||
+      header_->version != PACKED_DATASET_VERSION) {
+    LOG(ERROR) << path << " is not a packed dataset of version "
+               << PACKED_DATASET_VERSION;
+    Close();
+    return -1;
+  }
+
+  uint64_t index_size =
+      static_cast<uint64_t>(header_->record_count) * sizeof(PackedRecord);
+  if (header_->index_offset % PACKED_RECORD_ALIGN != 0 ||
+      header_->index_offset > size_ ||
+      index_size > size_ - header_->index_offset) {
+    LOG(ERROR) << path << " is truncated";
+    Close();
+    return -1;
+  }
+  records_ =
+      reinterpret_cast<const PackedRecord *>(base_ + header_->index_offset);
+
+  for (uint32_t i = 0; i < header_->record_count; i++) {
+    auto &record = records_[i];
+    if (record.offset > header_->index_offset ||
+        record.size > header_->index_offset - record.offset ||
+        record.ndim < 0 || record.ndim > PACKED_MAX_DIMS ||
+        record.name[PACKED_NAME_SIZE - 1] != '\0') {
+      LOG(ERROR) << path << " has invalid record " << i;
+      Close();
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void PackedDataset::WillNeed(int index, int count) {
+  if (index >= Count() || count <= 0) {
+    return;
+  }
+  int last = std::min(index + count, Count()) - 1;
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t begin = records_[index].offset / page_size * page_size;
+  size_t end = records_[last].offset + records_[last].size;
+  madvise(base_ + begin, end - begin, MADV_WILLNEED);
+}
+
+void PackedDataset::DontNeed(int index) {
+  if (index <= 0) {
+    return;
+  }
+  // Pages shared with record `index` are kept
+  size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t end = index < Count() ? records_[index].offset : header_->index_offset;
+  end = end / page_size * page_size;
+  if (end > dropped_) {
+    madvise(base_ + dropped_, end - dropped_, MADV_DONTNEED);
+    dropped_ = end;
+  }
+}
+
+void PackedDataset::Close() {
+  if (base_ != nullptr) {
+    munmap(base_, size_);
+    base_ = nullptr;
+  }
+  if (fd_ >= 0) {
+    close(fd_);
+    fd_ = -1;
+  }
+  size_ = 0;
+  header_ = nullptr;
+  records_ = nullptr;
+  dropped_ = 0;
+}
+
+PackedDataset::~PackedDataset() { Close(); }
@@ -0,0 +1,257 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "input/replay_data_iterator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <sstream>
+#include <vector>
+
+#include "glog/logging.h"
+#include "rapidjson/document.h"
+#include "utils/stop_watch.h"
+
+// Replay thread checks for stop at this interval while waiting
+#define REPLAY_POLL_MS 50
+
+int ReplayDataIterator::Init(std::string config_file,
+                             std::string config_string) {
+  DLOG(INFO) << "Init replay data iterator";
+  int ret_code = DataIterator::Init(config_file, config_string);
+  if (ret_code != 0) {
+    return -1;
+  }
+
+  if (data_type_ != BPU_TYPE_IMG_NV12_SEPARATE &&
+      data_type_ != BPU_TYPE_IMG_YUV_NV12) {
+    LOG(ERROR) << "Replay only supports NV12 and NV12_SEPARATE, got "
+               << data_type_;
+    return -1;
+  }
+
+  if (reader_.Open(record_file_) != 0) {
+    return -1;
+  }
+
+  std::vector<uint64_t> timestamps;
+  reader_.ReadTimestamps(&timestamps);
+  if (timestamps.empty()) {
+    LOG(ERROR) << record_file_ << " has no frame";
+    return -1;
+  }
+  uint64_t interval = 0;
+  if (timestamps.size() > 1) {
+    interval = (timestamps.back() - timestamps.front()) /
+               (timestamps.size() - 1);
+  }
+  if (late_ms_ > 0) {
+    late_us_ = late_ms_ * 1000;
+  } else if (speed_ > 0) {
+    late_us_ = interval / speed_;
+  }
+
+  auto &header = reader_.Header();
+  LOG(INFO) << "Replay " << record_file_ << ", " << timestamps.size()
+            << " frames of " << header.width << "x" << header.height
+            << ", interval " << interval << "us, speed " << speed_;
+
+  tensor_pool_.reset(new TensorPool(default_bpu_mem_allocator(),
+                                    std::max(16, buffer_count_ * 2)));
+  frame_queue_.SetCapacity(buffer_count_);
+  replay_thread_ = std::thread(&ReplayDataIterator::ReplayLoop, this);
+  return 0;
+}
+
+void ReplayDataIterator::ReplayLoop() {
+  auto &header = reader_.Header();
+  auto start = std::chrono::steady_clock::now();
+  bool is_first = true;
+  uint64_t first_ts = 0;
+  int index = 0;
+  while (!stop_) {
+    auto *frame = new ImageTensor();
+    auto &tensor = frame->tensor;
+    prepare_image_tensor(
+        header.height, header.width, data_type_, &tensor, tensor_pool_.get());
+    uint64_t ts;
+    if (reader_.Read(&ts, &tensor) != 0) {
+      release_tensor(&tensor, tensor_pool_.get());
+      delete frame;
+      if (!loop_ || index == 0) {
+        break;
+      }
+      reader_.Rewind();
+      is_first = true;
+      continue;
+    }
+    flush_tensor(&tensor);
+
+    if (is_first) {
+      start = std::chrono::steady_clock::now();
+      first_ts = ts;
+      is_first = false;
+    }
+    if (speed_ > 0) {
+      auto offset = static_cast<int64_t>((ts - first_ts) / speed_);
+      auto due = start + std::chrono::microseconds(offset);
+      // Wake up regularly to notice stop on long gaps
+      while (!stop_ && std::chrono::steady_clock::now() < due) {
+        std::this_thread::sleep_for(
+            std::min<std::chrono::steady_clock::duration>(
+                due - std::chrono::steady_clock::now(),
+                std::chrono::milliseconds(REPLAY_POLL_MS)));
+      }
+    }
+
+    frame->image_name = "frame_" + std::to_string(index++);
+    frame->ori_image_width = header.width;
+    frame->ori_image_height = header.height;
+    // Keep the recorded timestamp, lateness and frame age are measured
+    // from the emission
+    frame->timestamp = ts;
+    frame->receive_ts = Stopwatch::CurrentTs();
+    emitted_count_++;
+
+    // Like camera buffers, the oldest frame is overwritten in real time
+    ImageTensor *dropped = nullptr;
+    if (speed_ > 0) {
+      if (frame_queue_.PushEvictOldest(frame, &dropped) && dropped != frame) {
+        dropped_count_++;
+        DLOG(INFO) << "Drop " << dropped->image_name;
+      }
+    } else if (!frame_queue_.Push(frame)) {
+      dropped = frame;
+    }
+    if (dropped != nullptr) {
+      release_tensor(&dropped->tensor, tensor_pool_.get());
+      delete dropped;
+    }
+  }
+  frame_queue_.Push(nullptr);
+}
+
+bool ReplayDataIterator::Next(ImageTensor *image_tensor) {
+  do {
+    ImageTensor *frame = nullptr;
+    if (end_of_record_ || !frame_queue_.Pop(&frame) || frame == nullptr) {
+      end_of_record_ = true;
+      is_finish_ = true;
+      return false;
+    }
+    *image_tensor = *frame;
+    delete frame;
+  } while (!ApplyFramePolicy({image_tensor}));
+
+  auto delay = Stopwatch::CurrentTs() - image_tensor->receive_ts;
+  max_delay_us_ = std::max(max_delay_us_, delay);
+  if (late_us_ > 0 && delay > late_us_) {
+    late_count_++;
+  }
+  image_tensor->frame_id = NextFrameId();
+  count_++;
+  return true;
+}
+
+bool ReplayDataIterator::Next(ImageTensor *visible_image_tensor,
+                              ImageTensor *lwir_image_tensor) {
+  // Records hold one camera, finish instead of failing every frame
+  LOG(ERROR) << "Replay data iterator does not support mutil modal";
+  is_finish_ = true;
+  return false;
+}
+
+bool ReplayDataIterator::TryNextReady(
+    std::vector<ImageTensor *> image_tensors) {
+  ImageTensor *frame = nullptr;
+  if (end_of_record_ || !frame_queue_.TryPop(&frame)) {
+    return false;
+  }
+  if (frame == nullptr) {
+    end_of_record_ = true;
+    return false;
+  }
+  *image_tensors[0] = *frame;
+  delete frame;
+  return true;
+}
+
+void ReplayDataIterator::Release(ImageTensor *image_tensor) {
+  release_tensor(&image_tensor->tensor, tensor_pool_.get());
+}
+
+bool ReplayDataIterator::HasNext() {
+  return !is_finish_ && (frame_count_ == -1 || count_ < frame_count_);
+}
+
+std::string ReplayDataIterator::Statistics() {
+  std::stringstream ss;
+  ss << "emitted:" << emitted_count_ << ", consumed:" << count_
+     << ", late:" << late_count_ << ", dropped:" << dropped_count_
+     << ", max delay:" << max_delay_us_ / 1000.0 << "ms";
+  return ss.str();
+}
+
+int ReplayDataIterator::LoadConfig(std::string &config_string) {
+  rapidjson::Document document;
+  document.Parse(config_string.data());
+
+  if (document.HasParseError()) {
+    LOG(ERROR) << "Parsing config file failed";
+    return -1;
+  }
+
+  if (document.HasMember("record_file")) {
+    record_file_ = document["record_file"].GetString();
+  }
+
+  if (document.HasMember("data_type")) {
+    data_type_ =
+        static_cast<hb_BPU_DATA_TYPE_E>(document["data_type"].GetInt());
+  }
+
+  if (document.HasMember("speed")) {
+    speed_ = document["speed"].GetFloat();
+  }
+
+  if (document.HasMember("buffer_count")) {
+    buffer_count_ = std::max(document["buffer_count"].GetInt(), 1);
+  }
+
+  if (document.HasMember("late_ms")) {
+    late_ms_ = document["late_ms"].GetInt();
+  }
+
+  if (document.HasMember("loop")) {
+    loop_ = document["loop"].GetBool();
+  }
+
+  if (document.HasMember("frame_count")) {
+    frame_count_ = document["frame_count"].GetInt();
+  }
+
+  return 0;
+}
+
+ReplayDataIterator::~ReplayDataIterator() {
+  stop_ = true;
+  frame_queue_.Close();
+  if (replay_thread_.joinable()) {
+    replay_thread_.join();
+  }
+  ImageTensor *frame;
+  while (frame_queue_.TryPop(&frame)) {
+    if (frame != nullptr) {
+      Release(frame);
+      delete frame;
+    }
+  }
+  if (tensor_pool_) {
+    LOG(INFO) << "Replay " << Statistics();
+  }
+}
@@ -0,0 +1,255 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "input/video_data_iterator.h"
+
+#include <algorithm>
+
+#include "glog/logging.h"
+#include "rapidjson/document.h"
+#include "utils/stop_watch.h"
+#include "utils/utils.h"
+
+int VideoDataIterator::Init(std::string config_file,
+                            std::string config_string) {
+  DLOG(INFO) << "Init video data iterator";
+  int ret_code = DataIterator::Init(config_file, config_string);
+  if (ret_code != 0) {
+    return -1;
+  }
+
+  std::vector<std::string> video_files{video_file_};
+  if (mutil_modal_) {
+    video_files.push_back(lwir_video_file_);
+  }
+  // Captures release the video when destroyed, never reallocate them
+  captures_.reserve(video_files.size());
+  color_modes_.resize(video_files.size(), ColorMode::BGR);
+  for (int i = 0; i < static_cast<int>(video_files.size()); i++) {
+    auto &video_file = video_files[i];
+    captures_.emplace_back();
+    auto &capture = captures_.back();
+    if (!capture.open(video_file)) {
+      LOG(ERROR) << "Open video " << video_file << " failed";
+      return -1;
+    }
+    // Keep 16-bit frames as decoded, they are normalized per frame
+    if (color_modes_[i] == ColorMode::RAW16) {
+      capture.set(cv::CAP_PROP_CONVERT_RGB, 0);
+    }
+    // Fall back to decoding up to start frame if seeking is not supported
+    if (start_frame_ > 0 &&
+        !capture.set(cv::CAP_PROP_POS_FRAMES, start_frame_)) {
+      for (int skip = 0; skip < start_frame_ && capture.grab(); skip++) {
+      }
+    }
+    LOG(INFO) << "Video " << video_file << ", "
+              << capture.get(cv::CAP_PROP_FRAME_WIDTH) << "x"
+              << capture.get(cv::CAP_PROP_FRAME_HEIGHT) << ", "
+              << capture.get(cv::CAP_PROP_FRAME_COUNT) << " frames at "
+              << capture.get(cv::CAP_PROP_FPS) << "fps";
+    video_names_.push_back(get_file_name(video_file));
+  }
+
+  tensor_pool_.reset(new TensorPool(default_bpu_mem_allocator(),
+                                    std::max(16, buffer_count_ * 2)));
+  frame_queue_.SetCapacity(buffer_count_);
+  decode_thread_ = std::thread(&VideoDataIterator::DecodeLoop, this);
+  return 0;
+}
+
+void VideoDataIterator::DecodeLoop() {
+  while (!stop_) {
+    auto *frame = new Frame();
+    if (!DecodeFrame(frame)) {
+      delete frame;
+      break;
+    }
+    if (!frame_queue_.Push(frame)) {
+      ReleaseFrame(frame);
+      delete frame;
+      break;
+    }
+  }
+  frame_queue_.Push(nullptr);
+}
+
+bool VideoDataIterator::DecodeFrame(Frame *frame) {
+  bool is_first = position_ < 0;
+  int64_t position = is_first ? start_frame_ : position_ + frame_stride_;
+  cv::Mat mat;
+  for (int i = 0; i < static_cast<int>(captures_.size()); i++) {
+    auto &capture = captures_[i];
+    // Skipped frames are decoded but never converted
+    for (int skip = 1; !is_first && skip < frame_stride_; skip++) {
+      capture.grab();
+    }
+    if (!capture.read(mat) || mat.empty()) {
+      ReleaseFrame(frame);
+      return false;
+    }
+
+    ImageTensor image_tensor;
+    auto &tensor = image_tensor.tensor;
+    prepare_image_tensor(
+        height_, width_, data_type_, &tensor, tensor_pool_.get());
+    if (mat_to_tensor(mat, &tensor, resize_mode_, color_modes_[i]) != 0) {
+      release_tensor(&tensor, tensor_pool_.get());
+      ReleaseFrame(frame);
+      return false;
+    }
+    flush_tensor(&tensor);
+    image_tensor.ori_image_width = mat.cols;
+    image_tensor.ori_image_height = mat.rows;
+    image_tensor.is_pad_resize = resize_mode_ == ResizeMode::LETTERBOX;
+    image_tensor.image_name =
+        video_names_[i] + "_" + std::to_string(position);
+    frame->push_back(image_tensor);
+  }
+  position_ = position;
+  return true;
+}
+
+bool VideoDataIterator::NextFrame(std::vector<ImageTensor *> image_tensors) {
+  // Every frame would mismatch, finish instead of failing each of them
+  if (image_tensors.size() != captures_.size()) {
+    LOG(ERROR) << "Expect " << captures_.size() << " image(s) per frame, got "
+               << image_tensors.size();
+    is_finish_ = true;
+    return false;
+  }
+
+  Frame *frame = nullptr;
+  if (!frame_queue_.Pop(&frame) || frame == nullptr) {
+    is_finish_ = true;
+    return false;
+  }
+
+  auto timestamp = Stopwatch::CurrentTs();
+  auto frame_id = NextFrameId();
+  for (size_t i = 0; i < frame->size(); i++) {
+    *image_tensors[i] = (*frame)[i];
+    image_tensors[i]->timestamp = timestamp;
+    image_tensors[i]->frame_id = frame_id;
+  }
+  delete frame;
+  count_++;
+  return true;
+}
+
+bool VideoDataIterator::Next(ImageTensor *image_tensor) {
+  return NextFrame({image_tensor});
+}
+
+bool VideoDataIterator::Next(ImageTensor *visible_image_tensor,
+                             ImageTensor *lwir_image_tensor) {
+  return NextFrame({visible_image_tensor, lwir_image_tensor});
+}
+
+void VideoDataIterator::Release(ImageTensor *image_tensor) {
+  release_tensor(&image_tensor->tensor, tensor_pool_.get());
+}
+
+void VideoDataIterator::ReleaseFrame(Frame *frame) {
+  for (auto &image_tensor : *frame) {
+    Release(&image_tensor);
+  }
+  frame->clear();
+}
+
+bool VideoDataIterator::HasNext() {
+  return !is_finish_ && (frame_count_ == -1 || count_ < frame_count_);
+}
+
+int VideoDataIterator::LoadConfig(std::string &config_string) {
+  rapidjson::Document document;
+  document.Parse(config_string.data());
+
+  if (document.HasParseError()) {
+    LOG(ERROR) << "Parsing config file failed";
+    return -1;
+  }
+
+  if (document.HasMember("video_file")) {
+    video_file_ = document["video_file"].GetString();
+  }
+
+  if (document.HasMember("lwir_video_file")) {
+    lwir_video_file_ = document["lwir_video_file"].GetString();
+  }
+
+  if (document.HasMember("width")) {
+    width_ = document["width"].GetInt();
+  }
+
+  if (document.HasMember("height")) {
+    height_ = document["height"].GetInt();
+  }
+
+  if (document.HasMember("data_type")) {
+    data_type_ =
+        static_cast<hb_BPU_DATA_TYPE_E>(document["data_type"].GetInt());
+  }
+
+  if (document.HasMember("resize_mode")) {
+    if (parse_resize_mode(document["resize_mode"].GetString(),
+                          &resize_mode_) != 0) {
+      return -1;
+    }
+  }
+
+  if (parse_color_modes(config_string, &color_modes_) != 0) {
+    return -1;
+  }
+
+  if (document.HasMember("start_frame")) {
+    start_frame_ = std::max(document["start_frame"].GetInt(), 0);
+  }
+
+  if (document.HasMember("frame_stride")) {
+    frame_stride_ = std::max(document["frame_stride"].GetInt(), 1);
+  }
+
+  if (document.HasMember("buffer_count")) {
+    buffer_count_ = std::max(document["buffer_count"].GetInt(), 1);
+  }
+
+  if (document.HasMember("frame_count")) {
+    frame_count_ = document["frame_count"].GetInt();
+  }
+
+  if (width_ <= 0 || height_ <= 0) {
+    LOG(ERROR) << "width and height are required by video data iterator";
+    return -1;
+  }
+
+  if (mutil_modal_ && lwir_video_file_.empty()) {
+    LOG(ERROR) << "lwir_video_file is required by mutil modal video";
+    return -1;
+  }
+
+  return 0;
+}
+
+VideoDataIterator::~VideoDataIterator() {
+  stop_ = true;
+  frame_queue_.Close();
+  if (decode_thread_.joinable()) {
+    decode_thread_.join();
+  }
+  Frame *frame;
+  while (frame_queue_.TryPop(&frame)) {
+    if (frame != nullptr) {
+      ReleaseFrame(frame);
+      delete frame;
+    }
+  }
+  if (tensor_pool_) {
+    LOG(INFO) << "Video tensor pool " << tensor_pool_->Statistics();
+  }
+}
@@ -21,6 +21,7 @@
 #include "rapidjson/document.h"
 #include "rapidjson/istreamwrapper.h"
 #include "utils/image_utils.h"
+#include "utils/tracer.h"
 
 #define VERSION ((1 << 31) | (1 << 24))
 #define MAX_DATA_SEND_CNT (5)
@@ -294,6 +295,7 @@ int ClientOutputModule::Serialize(ImageTensor *image_tensor,
                                   Perception *perception,
                                   char **pb,
                                   int *pb_length) {
+  TraceSpan span("serialize");
   int base = std::pow(2, send_level_ / 4);
   Meta::Meta serial_meta;
   serial_meta.set_proto_version(1);
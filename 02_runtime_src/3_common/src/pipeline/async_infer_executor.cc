@@ -0,0 +1,97 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "pipeline/async_infer_executor.h"
+
+#include "glog/logging.h"
+#include "pipeline/pipeline.h"
+#include "utils/tensor_utils.h"
+#include "utils/tracer.h"
+
+int AsyncInferExecutor::Init(BPU_MODEL_S *bpu_model,
+                             int core_num,
+                             int task_depth,
+                             Callback callback,
+                             TensorPool *output_pool) {
+  bpu_model_ = bpu_model;
+  run_ctrl_s_ = BPU_RUN_CTRL_S{core_num};
+  task_depth_ = task_depth > 0 ? task_depth : 1;
+  callback_ = callback;
+  output_pool_ = output_pool;
+  // Completion thread never waits on a full queue, slots are bounded in Submit
+  task_queue_.SetCapacity(task_depth_);
+  completion_thread_ = std::thread(&AsyncInferExecutor::CompletionLoop, this);
+  LOG(INFO) << "Async infer executor task depth:" << task_depth_;
+  return 0;
+}
+
+int AsyncInferExecutor::Submit(PipelineFrame *frame) {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    slot_cv_.wait(lock, [this] { return in_flight_ < task_depth_; });
+    in_flight_++;
+  }
+
+  Task *task = new Task;
+  task->frame = frame;
+  task->input_tensors.resize(bpu_model_->input_num);
+  for (size_t i = 0; i < frame->inputs.size(); i++) {
+    task->input_tensors[i] = frame->inputs[i].tensor;
+  }
+  prepare_output_tensor(frame->output_tensors, bpu_model_, output_pool_);
+
+  int ret_code = HB_BPU_runModel(bpu_model_,
+                                 task->input_tensors.data(),
+                                 bpu_model_->input_num,
+                                 frame->output_tensors.data(),
+                                 bpu_model_->output_num,
+                                 &run_ctrl_s_,
+                                 false,
+                                 &task->task_handle);
+  if (ret_code != 0 || !task_queue_.Push(task)) {
+    LOG(ERROR) << "Submit model task failed:" << HB_BPU_getErrorName(ret_code);
+    if (ret_code == 0) {
+      HB_BPU_waitModelDone(&task->task_handle);
+      HB_BPU_releaseTask(&task->task_handle);
+      ret_code = -1;
+    }
+    delete task;
+    std::lock_guard<std::mutex> lock(mutex_);
+    in_flight_--;
+    slot_cv_.notify_one();
+    return ret_code;
+  }
+  return 0;
+}
+
+void AsyncInferExecutor::CompletionLoop() {
+  Tracer::Instance()->SetThreadName("infer_completion");
+  Task *task = nullptr;
+  while (task_queue_.Pop(&task)) {
+    int ret_code = HB_BPU_waitModelDone(&task->task_handle);
+    HB_BPU_releaseTask(&task->task_handle);
+    PipelineFrame *frame = task->frame;
+    delete task;
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      in_flight_--;
+      slot_cv_.notify_one();
+    }
+    callback_(frame, ret_code);
+  }
+}
+
+void AsyncInferExecutor::Finish() {
+  task_queue_.Close();
+  if (completion_thread_.joinable()) {
+    completion_thread_.join();
+  }
+}
+
+AsyncInferExecutor::~AsyncInferExecutor() { Finish(); }
@@ -0,0 +1,315 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "pipeline/pipeline.h"
+
+#include <sstream>
+
+#include "glog/logging.h"
+#include "utils/tensor_utils.h"
+#include "utils/tracer.h"
+
+int Pipeline::Init(BPU_MODEL_S *bpu_model,
+                   DataIterator *data_iterator,
+                   const std::vector<PostProcessModule *> &post_process_modules,
+                   OutputModule *output_module,
+                   const PipelineConfig &config) {
+  bpu_model_ = bpu_model;
+  data_iterator_ = data_iterator;
+  post_process_modules_ = post_process_modules;
+  output_module_ = output_module;
+  config_ = config;
+
+  if (config_.modality_num != 1 && config_.modality_num != 2) {
+    LOG(ERROR) << "Unsupported modality num:" << config_.modality_num;
+    return -1;
+  }
+
+  if (config_.modality_num > bpu_model_->input_num) {
+    LOG(ERROR) << "Modality num " << config_.modality_num
+               << " is larger than model input num " << bpu_model_->input_num;
+    return -1;
+  }
+
+  config_.infer_thread_num = std::max(config_.infer_thread_num, 1);
+  config_.post_process_thread_num = std::max(config_.post_process_thread_num, 1);
+  if (config_.enable_post_process) {
+    if (static_cast<int>(post_process_modules_.size()) !=
+            config_.post_process_thread_num ||
+        output_module_ == nullptr) {
+      LOG(ERROR) << "Output module and " << config_.post_process_thread_num
+                 << " post process modules are required, got "
+                 << post_process_modules_.size();
+      return -1;
+    }
+    for (auto *module : post_process_modules_) {
+      if (module == nullptr) {
+        LOG(ERROR) << "Post process module is null";
+        return -1;
+      }
+    }
+  }
+
+  if (!config_.capture_file.empty() &&
+      capture_writer_.Open(config_.capture_file, bpu_model_->output_num) !=
+          0) {
+    return -1;
+  }
+
+  infer_queue_.SetCapacity(config_.queue_size);
+  post_process_queue_.SetCapacity(config_.queue_size);
+  output_queue_.SetCapacity(config_.queue_size);
+
+  if (config_.task_depth > 1) {
+    async_executor_.Init(bpu_model_,
+                         config_.core_num,
+                         config_.task_depth,
+                         [this](PipelineFrame *frame, int ret_code) {
+                           LOG_IF(FATAL, ret_code != 0)
+                               << "Run model failed:"
+                               << HB_BPU_getErrorName(ret_code);
+                           frame->infer_end_ts = Stopwatch::CurrentTs();
+                           // Submit to completion, BPU queueing included
+                           Tracer::Instance()->Record(
+                               "bpu_run",
+                               frame->inputs[0].frame_id,
+                               frame->infer_start_ts,
+                               frame->infer_end_ts);
+                           post_process_queue_.Push(frame);
+                         },
+                         OutputPool());
+  }
+
+  LOG(INFO) << "Pipeline queue size:" << config_.queue_size
+            << ", infer threads:" << config_.infer_thread_num
+            << ", task depth:" << config_.task_depth
+            << ", post process threads:" << config_.post_process_thread_num;
+  return 0;
+}
+
+int Pipeline::Run() {
+  run_watch_.Start();
+  infer_running_ = config_.infer_thread_num;
+  post_process_running_ = config_.post_process_thread_num;
+
+  std::vector<std::thread> threads;
+  threads.emplace_back(&Pipeline::InputLoop, this);
+  for (int i = 0; i < config_.infer_thread_num; i++) {
+    threads.emplace_back(&Pipeline::InferLoop, this);
+  }
+  for (int i = 0; i < config_.post_process_thread_num; i++) {
+    threads.emplace_back(
+        &Pipeline::PostProcessLoop,
+        this,
+        config_.enable_post_process ? post_process_modules_[i] : nullptr);
+  }
+  threads.emplace_back(&Pipeline::OutputLoop, this);
+
+  for (auto &t : threads) {
+    t.join();
+  }
+  run_watch_.Stop();
+  return 0;
+}
+
+void Pipeline::InputLoop() {
+  // Frame id is unknown until Next returns, spans inside are attributed to
+  // the frame by nesting in input_read
+  Tracer::Instance()->SetThreadName("input");
+  Tracer::SetCurrentFrame(-1);
+  int64_t seq = 0;
+  while (data_iterator_->HasNext()) {
+    PipelineFrame *frame = new PipelineFrame;
+    frame->inputs.resize(config_.modality_num);
+    frame->input_start_ts = Stopwatch::CurrentTs();
+
+    bool has_data = false;
+    if (config_.modality_num == 2) {
+      has_data = data_iterator_->Next(&frame->inputs[0], &frame->inputs[1]);
+    } else {
+      has_data = data_iterator_->Next(&frame->inputs[0]);
+    }
+    if (!has_data) {
+      delete frame;
+      continue;
+    }
+
+    frame->input_end_ts = Stopwatch::CurrentTs();
+    Tracer::Instance()->Record("input_read",
+                               frame->inputs[0].frame_id,
+                               frame->input_start_ts,
+                               frame->input_end_ts);
+    frame->seq = seq++;
+    if (!infer_queue_.Push(frame)) {
+      for (auto &input : frame->inputs) {
+        data_iterator_->Release(&input);
+      }
+      delete frame;
+      break;
+    }
+  }
+  infer_queue_.Close();
+}
+
+void Pipeline::InferLoop() {
+  Tracer::Instance()->SetThreadName("infer");
+  PipelineFrame *frame = nullptr;
+  while (infer_queue_.Pop(&frame)) {
+    Tracer::SetCurrentFrame(frame->inputs[0].frame_id);
+    frame->infer_start_ts = Stopwatch::CurrentTs();
+    if (config_.task_depth > 1) {
+      // Finished frame goes to post process from the completion thread
+      int ret_code = async_executor_.Submit(frame);
+      LOG_IF(FATAL, ret_code != 0)
+          << "Submit model failed:" << HB_BPU_getErrorName(ret_code);
+      continue;
+    }
+    int ret_code = Infer(frame);
+    LOG_IF(FATAL, ret_code != 0)
+        << "Run model failed:" << HB_BPU_getErrorName(ret_code);
+    frame->infer_end_ts = Stopwatch::CurrentTs();
+    Tracer::Instance()->Record("bpu_run",
+                               frame->inputs[0].frame_id,
+                               frame->infer_start_ts,
+                               frame->infer_end_ts);
+    post_process_queue_.Push(frame);
+  }
+
+  if (--infer_running_ == 0) {
+    if (config_.task_depth > 1) {
+      async_executor_.Finish();
+    }
+    post_process_queue_.Close();
+  }
+}
+
+int Pipeline::Infer(PipelineFrame *frame) {
+  std::vector<BPU_TENSOR_S> input_tensors(bpu_model_->input_num);
+  for (int i = 0; i < config_.modality_num; i++) {
+    input_tensors[i] = frame->inputs[i].tensor;
+  }
+  prepare_output_tensor(frame->output_tensors, bpu_model_, OutputPool());
+
+  BPU_RUN_CTRL_S run_ctrl_s{config_.core_num};
+  BPU_TASK_HANDLE task_handle{};
+  return HB_BPU_runModel(bpu_model_,
+                         input_tensors.data(),
+                         bpu_model_->input_num,
+                         frame->output_tensors.data(),
+                         bpu_model_->output_num,
+                         &run_ctrl_s,
+                         true,
+                         &task_handle);
+}
+
+void Pipeline::PostProcessLoop(PostProcessModule *post_process_module) {
+  Tracer::Instance()->SetThreadName("post_process");
+  PipelineFrame *frame = nullptr;
+  while (post_process_queue_.Pop(&frame)) {
+    Tracer::SetCurrentFrame(frame->inputs[0].frame_id);
+    frame->post_process_start_ts = Stopwatch::CurrentTs();
+    if (config_.enable_post_process) {
+      post_process_module->PostProcess(
+          frame->output_tensors.data(), &frame->inputs[0], &frame->perception);
+    }
+    frame->post_process_end_ts = Stopwatch::CurrentTs();
+    Tracer::Instance()->Record("post_process",
+                               frame->inputs[0].frame_id,
+                               frame->post_process_start_ts,
+                               frame->post_process_end_ts);
+    output_queue_.Push(frame);
+  }
+
+  if (--post_process_running_ == 0) {
+    output_queue_.Close();
+  }
+}
+
+void Pipeline::OutputLoop() {
+  Tracer::Instance()->SetThreadName("output");
+  PipelineFrame *frame = nullptr;
+  while (output_queue_.Pop(&frame)) {
+    reorder_buffer_[frame->seq] = frame;
+    while (!reorder_buffer_.empty() &&
+           reorder_buffer_.begin()->first == next_output_seq_) {
+      PipelineFrame *ready = reorder_buffer_.begin()->second;
+      reorder_buffer_.erase(reorder_buffer_.begin());
+      WriteFrame(ready);
+      next_output_seq_++;
+    }
+  }
+
+  // Should be empty unless some frame got lost on the way
+  for (auto &it : reorder_buffer_) {
+    if (it.first != next_output_seq_) {
+      LOG(WARNING) << "Frame seq " << next_output_seq_ << " to "
+                   << it.first - 1 << " is missing";
+    }
+    WriteFrame(it.second);
+    next_output_seq_ = it.first + 1;
+  }
+  reorder_buffer_.clear();
+}
+
+void Pipeline::WriteFrame(PipelineFrame *frame) {
+  ImageTensor &image_tensor = frame->inputs[0];
+  Tracer::SetCurrentFrame(image_tensor.frame_id);
+  if (config_.enable_post_process) {
+    output_watch_.Start();
+    {
+      TraceSpan span("output_write");
+      output_module_->Write(&image_tensor, &frame->perception);
+    }
+    output_watch_.Stop();
+    post_process_watch_.Record(frame->post_process_end_ts -
+                               frame->post_process_start_ts);
+    LOG(INFO) << "Image:" << image_tensor.image_name
+              << ", infer result:" << frame->perception;
+  } else {
+    LOG(INFO) << "Image:" << image_tensor.image_name << ", infer end.";
+  }
+
+  input_watch_.Record(frame->input_end_ts - frame->input_start_ts);
+  infer_watch_.Record(frame->infer_end_ts - frame->infer_start_ts);
+  whole_watch_.Record(Stopwatch::CurrentTs() - frame->input_start_ts);
+  frame_count_++;
+
+  if (capture_writer_.IsOpen()) {
+    TraceSpan span("capture_write");
+    if (capture_writer_.Write(image_tensor, frame->output_tensors) != 0) {
+      capture_writer_.Close();
+    }
+  }
+
+  release_output_tensor(frame->output_tensors, OutputPool());
+  for (auto &input : frame->inputs) {
+    data_iterator_->Release(&input);
+  }
+  delete frame;
+}
+
+std::string Pipeline::Statistics() {
+  std::stringstream ss;
+  ss << "Pipeline frames:" << frame_count_ << ", duration:" << run_watch_.Duration()
+     << "ms, throughput:"
+     << (run_watch_.Duration() > 0
+             ? frame_count_ / (run_watch_.Duration() / 1000.0)
+             : 0)
+     << "/s" << std::endl
+     << "Whole latency statistics:" << whole_watch_
+     << ", Input stage statistics:" << input_watch_
+     << ", Infer stage statistics:" << infer_watch_;
+  if (config_.enable_post_process) {
+    ss << ", Post process stage statistics:" << post_process_watch_
+       << ", Output stage statistics:" << output_watch_;
+  }
+  if (config_.enable_tensor_pool) {
+    ss << std::endl << "Output tensor pool " << output_pool_.Statistics();
+  }
+  return ss.str();
+}
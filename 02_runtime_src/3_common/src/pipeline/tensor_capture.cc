@@ -0,0 +1,189 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "pipeline/tensor_capture.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "glog/logging.h"
+
+static void to_capture_shape(const BPU_DATA_SHAPE_S &shape,
+                             CaptureShape *capture_shape) {
+  memset(capture_shape, 0, sizeof(*capture_shape));
+  capture_shape->layout = shape.layout;
+  capture_shape->ndim = std::min<int>(shape.ndim, TENSOR_CAPTURE_MAX_DIM);
+  for (int i = 0; i < capture_shape->ndim; i++) {
+    capture_shape->d[i] = shape.d[i];
+  }
+}
+
+static int from_capture_shape(const CaptureShape &capture_shape,
+                              BPU_DATA_SHAPE_S *shape) {
+  if (capture_shape.ndim < 0 || capture_shape.ndim > TENSOR_CAPTURE_MAX_DIM ||
+      capture_shape.ndim > BPU_MODEL_MAX_SHAPE_DIM) {
+    return -1;
+  }
+  memset(shape, 0, sizeof(*shape));
+  shape->layout = static_cast<BPU_LAYOUT_E>(capture_shape.layout);
+  shape->ndim = capture_shape.ndim;
+  for (int i = 0; i < shape->ndim; i++) {
+    shape->d[i] = capture_shape.d[i];
+  }
+  return 0;
+}
+
+int TensorCaptureWriter::Open(const std::string &path, int output_num) {
+  Close();
+  ofs_.open(path, std::ios::out | std::ios::binary);
+  if (!ofs_.is_open()) {
+    LOG(ERROR) << "Open " << path << " failed";
+    return -1;
+  }
+
+  output_num_ = output_num;
+  CaptureHeader header = CaptureHeader();
+  header.magic = TENSOR_CAPTURE_MAGIC;
+  header.version = TENSOR_CAPTURE_VERSION;
+  header.output_num = output_num;
+  ofs_.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  return ofs_.good() ? 0 : -1;
+}
+
+void TensorCaptureWriter::WriteTensor(const BPU_TENSOR_S &tensor,
+                                      uint32_t data_size) {
+  CaptureTensorHeader tensor_header = CaptureTensorHeader();
+  tensor_header.data_type = tensor.data_type;
+  tensor_header.data_size = data_size;
+  to_capture_shape(tensor.data_shape, &tensor_header.data_shape);
+  to_capture_shape(tensor.aligned_shape, &tensor_header.aligned_shape);
+  ofs_.write(reinterpret_cast<const char *>(&tensor_header),
+             sizeof(tensor_header));
+  if (data_size > 0) {
+    ofs_.write(reinterpret_cast<const char *>(tensor.data.virAddr),
+               data_size);
+  }
+}
+
+int TensorCaptureWriter::Write(ImageTensor &image_tensor,
+                               std::vector<BPU_TENSOR_S> &output_tensors) {
+  if (static_cast<int>(output_tensors.size()) != output_num_) {
+    LOG(ERROR) << "Expect " << output_num_ << " output tensors, got "
+               << output_tensors.size();
+    return -1;
+  }
+
+  CaptureFrameHeader frame_header = CaptureFrameHeader();
+  frame_header.frame_id = image_tensor.frame_id;
+  frame_header.cam_id = image_tensor.cam_id;
+  frame_header.timestamp = image_tensor.timestamp;
+  frame_header.ori_image_width = image_tensor.ori_image_width;
+  frame_header.ori_image_height = image_tensor.ori_image_height;
+  frame_header.is_pad_resize = image_tensor.is_pad_resize;
+  frame_header.name_size = image_tensor.image_name.size();
+  ofs_.write(reinterpret_cast<const char *>(&frame_header),
+             sizeof(frame_header));
+  ofs_.write(image_tensor.image_name.data(), frame_header.name_size);
+
+  WriteTensor(image_tensor.tensor, 0);
+  for (auto &tensor : output_tensors) {
+    // Post process may not have run, read what the BPU wrote
+    HB_SYS_flushMemCache(&tensor.data, HB_SYS_MEM_CACHE_INVALIDATE);
+    WriteTensor(tensor, tensor.data.memSize);
+  }
+
+  if (!ofs_.good()) {
+    LOG(ERROR) << "Write tensor capture failed";
+    return -1;
+  }
+  return 0;
+}
+
+void TensorCaptureWriter::Close() {
+  if (ofs_.is_open()) {
+    ofs_.close();
+  }
+}
+
+int TensorCaptureReader::Open(const std::string &path) {
+  path_ = path;
+  ifs_.open(path, std::ios::in | std::ios::binary);
+  if (!ifs_.is_open()) {
+    LOG(ERROR) << "Open " << path << " failed";
+    return -1;
+  }
+
+  ifs_.read(reinterpret_cast<char *>(&header_), sizeof(header_));
+  if (!ifs_ || header_.magic != TENSOR_CAPTURE_MAGIC ||
+      header_.version != TENSOR_CAPTURE_VERSION) {
+    LOG(ERROR) << path << " is not a tensor capture of version "
+               << TENSOR_CAPTURE_VERSION;
+    return -1;
+  }
+  return 0;
+}
+
+int TensorCaptureReader::ReadTensor(BPU_TENSOR_S *tensor,
+                                    std::vector<char> *data) {
+  CaptureTensorHeader tensor_header;
+  if (!ifs_.read(reinterpret_cast<char *>(&tensor_header),
+                 sizeof(tensor_header))) {
+    return -1;
+  }
+
+  memset(tensor, 0, sizeof(*tensor));
+  tensor->data_type = static_cast<BPU_DATA_TYPE_E>(tensor_header.data_type);
+  if (from_capture_shape(tensor_header.data_shape, &tensor->data_shape) != 0 ||
+      from_capture_shape(tensor_header.aligned_shape,
+                         &tensor->aligned_shape) != 0) {
+    LOG(ERROR) << path_ << " has an invalid tensor shape";
+    return -1;
+  }
+
+  if (data != nullptr) {
+    data->resize(tensor_header.data_size);
+    ifs_.read(data->data(), tensor_header.data_size);
+    tensor->data.virAddr = data->data();
+    tensor->data.memSize = tensor_header.data_size;
+  } else {
+    ifs_.seekg(tensor_header.data_size, std::ios::cur);
+  }
+  return ifs_ ? 0 : -1;
+}
+
+int TensorCaptureReader::Read(CaptureFrame *frame) {
+  CaptureFrameHeader frame_header;
+  if (!ifs_.read(reinterpret_cast<char *>(&frame_header),
+                 sizeof(frame_header))) {
+    return -1;
+  }
+
+  auto &image_tensor = frame->image_tensor;
+  image_tensor.frame_id = frame_header.frame_id;
+  image_tensor.cam_id = frame_header.cam_id;
+  image_tensor.timestamp = frame_header.timestamp;
+  image_tensor.ori_image_width = frame_header.ori_image_width;
+  image_tensor.ori_image_height = frame_header.ori_image_height;
+  image_tensor.is_pad_resize = frame_header.is_pad_resize != 0;
+  image_tensor.addition_info = nullptr;
+  image_tensor.image_name.resize(frame_header.name_size);
+  ifs_.read(&image_tensor.image_name[0], frame_header.name_size);
+
+  int output_num = header_.output_num;
+  frame->output_tensors.resize(output_num);
+  frame->output_data.resize(output_num);
+  int ret_code = ReadTensor(&image_tensor.tensor, nullptr);
+  for (int i = 0; i < output_num && ret_code == 0; i++) {
+    ret_code = ReadTensor(&frame->output_tensors[i], &frame->output_data[i]);
+  }
+  if (ret_code != 0) {
+    LOG(ERROR) << path_ << " is truncated";
+    return -1;
+  }
+  return 0;
+}
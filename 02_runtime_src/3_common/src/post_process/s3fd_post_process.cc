@@ -181,7 +181,6 @@ int S3fdPostProcessModule::S3fdAnchors(std::vector<Anchor> &anchor_table,
                                        int layer,
                                        int layer_height,
                                        int layer_width) {
-  std::vector<Anchor> anchors;
   auto &min_size = s3fd_config_.min_size[layer];
   auto step = s3fd_config_.step[layer];
   for (int i = 0; i < layer_height; i++) {
@@ -190,7 +189,7 @@ int S3fdPostProcessModule::S3fdAnchors(std::vector<Anchor> &anchor_table,
       float s_ky = min_size.first;
       float cx = (j + 0.5) * step;
       float cy = (i + 0.5) * step;
-      anchors.push_back(Anchor(cx, cy, s_kx, s_ky));
+      anchor_table.push_back(Anchor(cx, cy, s_kx, s_ky));
     }
   }
   return 0;
@@ -0,0 +1,305 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "post_process/yolo5_decode.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define YOLO5_DECODE_NEON
+#elif defined(__AVX2__)
+#include <immintrin.h>
+#define YOLO5_DECODE_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#include <xmmintrin.h>
+#define YOLO5_DECODE_SSE2
+#endif
+
+#include "glog/logging.h"
+#include "utils/algorithm.h"
+
+int yolo5_decode_param(BPU_TENSOR_S *tensor,
+                       ImageTensor *frame,
+                       Yolo5DecodeParam *param) {
+  auto ret = HB_BPU_getHW(
+      tensor->data_type, &tensor->data_shape, &param->height, &param->width);
+  if (ret != 0) {
+    LOG(ERROR) << "HB_BPU_getHW failed";
+    return -1;
+  }
+
+  double h_ratio = frame->height() * 1.0 / frame->ori_height();
+  double w_ratio = frame->width() * 1.0 / frame->ori_width();
+  double resize_ratio = std::min(w_ratio, h_ratio);
+  if (frame->is_pad_resize) {
+    w_ratio = resize_ratio;
+    h_ratio = resize_ratio;
+  }
+  param->w_ratio = w_ratio;
+  param->h_ratio = h_ratio;
+  param->w_padding = (frame->width() - w_ratio * frame->ori_width()) / 2.0;
+  param->h_padding = (frame->height() - h_ratio * frame->ori_height()) / 2.0;
+  param->ori_width = frame->ori_image_width;
+  param->ori_height = frame->ori_image_height;
+  return 0;
+}
+
+/**
+ * Map box from model input to original image and append it
+ */
+static inline void emit_detection(const Yolo5DecodeParam &param,
+                                  int id,
+                                  float confidence,
+                                  double xmin,
+                                  double ymin,
+                                  double xmax,
+                                  double ymax,
+                                  std::vector<Detection> &dets) {
+  double xmin_org = (xmin - param.w_padding) / param.w_ratio;
+  double xmax_org = (xmax - param.w_padding) / param.w_ratio;
+  double ymin_org = (ymin - param.h_padding) / param.h_ratio;
+  double ymax_org = (ymax - param.h_padding) / param.h_ratio;
+
+  if (xmax_org <= 0 || ymax_org <= 0) {
+    return;
+  }
+
+  if (xmin_org > xmax_org || ymin_org > ymax_org) {
+    return;
+  }
+
+  xmin_org = std::max(xmin_org, 0.0);
+  xmax_org = std::min(xmax_org, param.ori_width - 1.0);
+  ymin_org = std::max(ymin_org, 0.0);
+  ymax_org = std::min(ymax_org, param.ori_height - 1.0);
+
+  Bbox bbox(xmin_org, ymin_org, xmax_org, ymax_org);
+  dets.push_back(
+      Detection(id, confidence, bbox, (*param.class_names)[id].c_str()));
+}
+
+void yolo5_decode_reference(const float *data,
+                            const Yolo5DecodeParam &param,
+                            std::vector<Detection> &dets) {
+  const std::vector<std::pair<double, double>> &anchors = *param.anchors;
+  int num_classes = param.class_num;
+  int num_pred = num_classes + 4 + 1;
+  int stride = param.stride;
+  int anchor_num = anchors.size();
+  std::vector<float> class_pred(num_classes, 0.0);
+
+  for (int h = 0; h < param.height; h++) {
+    for (int w = 0; w < param.width; w++) {
+      for (int k = 0; k < anchor_num; k++) {
+        double anchor_x = anchors[k].first;
+        double anchor_y = anchors[k].second;
+        const float *cur_data = data + k * num_pred;
+        float objness = cur_data[4];
+        for (int index = 0; index < num_classes; ++index) {
+          class_pred[index] = cur_data[5 + index];
+        }
+
+        float id = argmax(class_pred.begin(), class_pred.end());
+        double x1 = 1 / (1 + std::exp(-objness)) * 1;
+        double x2 = 1 / (1 + std::exp(-class_pred[id]));
+        double confidence = x1 * x2;
+
+        if (confidence < param.score_threshold) {
+          continue;
+        }
+
+        float center_x = cur_data[0];
+        float center_y = cur_data[1];
+        float scale_x = cur_data[2];
+        float scale_y = cur_data[3];
+
+        double box_center_x =
+            ((1.0 / (1.0 + std::exp(-center_x))) * 2 - 0.5 + w) * stride;
+        double box_center_y =
+            ((1.0 / (1.0 + std::exp(-center_y))) * 2 - 0.5 + h) * stride;
+
+        double box_scale_x =
+            std::pow((1.0 / (1.0 + std::exp(-scale_x))) * 2, 2) * anchor_x;
+        double box_scale_y =
+            std::pow((1.0 / (1.0 + std::exp(-scale_y))) * 2, 2) * anchor_y;
+
+        emit_detection(param,
+                       static_cast<int>(id),
+                       confidence,
+                       box_center_x - box_scale_x / 2.0,
+                       box_center_y - box_scale_y / 2.0,
+                       box_center_x + box_scale_x / 2.0,
+                       box_center_y + box_scale_y / 2.0,
+                       dets);
+      }
+      data = data + num_pred * anchors.size();
+    }
+  }
+}
+
+static inline float sigmoid(float x) { return 1.0f / (1.0f + std::exp(-x)); }
+
+/**
+ * Collect anchors whose objectness logit reaches threshold
+ * @param[in] obj: objectness of the first anchor, anchor i at obj[i * step]
+ * @param[in] count: anchor count
+ * @param[in] step: distance between two anchors in floats
+ * @param[in] threshold: objectness logit threshold
+ * @param[out] candidates: index of passed anchors
+ * @return passed anchor count
+ */
+static int filter_objectness(const float *obj,
+                             int count,
+                             int step,
+                             float threshold,
+                             int *candidates) {
+  int n = 0;
+  int i = 0;
+#if defined(YOLO5_DECODE_NEON)
+  float32x4_t thr = vdupq_n_f32(threshold);
+  for (; i + 4 <= count; i += 4) {
+    const float *p = obj + i * step;
+    float32x4_t v = vdupq_n_f32(0);
+    v = vld1q_lane_f32(p, v, 0);
+    v = vld1q_lane_f32(p + step, v, 1);
+    v = vld1q_lane_f32(p + 2 * step, v, 2);
+    v = vld1q_lane_f32(p + 3 * step, v, 3);
+    uint32x4_t m = vcgeq_f32(v, thr);
+    uint32x2_t any = vorr_u32(vget_low_u32(m), vget_high_u32(m));
+    if ((vget_lane_u32(any, 0) | vget_lane_u32(any, 1)) == 0) {
+      continue;
+    }
+    uint32_t lanes[4];
+    vst1q_u32(lanes, m);
+    for (int j = 0; j < 4; j++) {
+      if (lanes[j]) {
+        candidates[n++] = i + j;
+      }
+    }
+  }
+#elif defined(YOLO5_DECODE_AVX2)
+  __m256 thr = _mm256_set1_ps(threshold);
+  __m256i index = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                     _mm256_set1_epi32(step));
+  for (; i + 8 <= count; i += 8) {
+    __m256 v = _mm256_i32gather_ps(obj + i * step, index, 4);
+    int mask = _mm256_movemask_ps(_mm256_cmp_ps(v, thr, _CMP_GE_OQ));
+    while (mask) {
+      candidates[n++] = i + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+#elif defined(YOLO5_DECODE_SSE2)
+  __m128 thr = _mm_set1_ps(threshold);
+  for (; i + 4 <= count; i += 4) {
+    const float *p = obj + i * step;
+    __m128 v = _mm_setr_ps(p[0], p[step], p[2 * step], p[3 * step]);
+    int mask = _mm_movemask_ps(_mm_cmpge_ps(v, thr));
+    while (mask) {
+      candidates[n++] = i + __builtin_ctz(mask);
+      mask &= mask - 1;
+    }
+  }
+#endif
+  for (; i < count; i++) {
+    if (obj[i * step] >= threshold) {
+      candidates[n++] = i;
+    }
+  }
+  return n;
+}
+
+void yolo5_decode(const float *data,
+                  const Yolo5DecodeParam &param,
+                  std::vector<Detection> &dets) {
+  const std::vector<std::pair<double, double>> &anchors = *param.anchors;
+  int anchor_num = anchors.size();
+  int num_classes = param.class_num;
+  int num_pred = num_classes + 4 + 1;
+  float stride = param.stride;
+
+  // confidence = sigmoid(obj) * sigmoid(cls) <= sigmoid(obj), so an anchor
+  // can only pass if obj >= logit(score_threshold). Keep a small margin,
+  // survivors are checked again with the exact confidence.
+  float obj_threshold;
+  if (param.score_threshold <= 0) {
+    obj_threshold = -std::numeric_limits<float>::infinity();
+  } else if (param.score_threshold >= 1) {
+    return;
+  } else {
+    double t = param.score_threshold;
+    obj_threshold = static_cast<float>(std::log(t / (1.0 - t))) - 1e-4f;
+  }
+
+  int row_anchors = param.width * anchor_num;
+  int row_size = row_anchors * num_pred;
+  std::vector<int> candidates(row_anchors);
+
+  for (int h = 0; h < param.height; h++) {
+    const float *row = data + h * row_size;
+    int n = filter_objectness(
+        row + 4, row_anchors, num_pred, obj_threshold, candidates.data());
+
+    for (int c = 0; c < n; c++) {
+      int index = candidates[c];
+      int w = index / anchor_num;
+      int k = index % anchor_num;
+      const float *cur_data = row + index * num_pred;
+
+      int id = argmax(cur_data + 5, cur_data + 5 + num_classes);
+      float confidence = sigmoid(cur_data[4]) * sigmoid(cur_data[5 + id]);
+      if (confidence < param.score_threshold) {
+        continue;
+      }
+
+      float box_center_x = (sigmoid(cur_data[0]) * 2 - 0.5f + w) * stride;
+      float box_center_y = (sigmoid(cur_data[1]) * 2 - 0.5f + h) * stride;
+      float scale_x = sigmoid(cur_data[2]) * 2;
+      float scale_y = sigmoid(cur_data[3]) * 2;
+      float box_scale_x = scale_x * scale_x * anchors[k].first;
+      float box_scale_y = scale_y * scale_y * anchors[k].second;
+
+      emit_detection(param,
+                     id,
+                     confidence,
+                     box_center_x - box_scale_x / 2.0f,
+                     box_center_y - box_scale_y / 2.0f,
+                     box_center_x + box_scale_x / 2.0f,
+                     box_center_y + box_scale_y / 2.0f,
+                     dets);
+    }
+  }
+}
+
+const char *yolo5_decode_isa() {
+#if defined(YOLO5_DECODE_NEON)
+  return "neon";
+#elif defined(YOLO5_DECODE_AVX2)
+  return "avx2";
+#elif defined(YOLO5_DECODE_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+int parse_decode_impl(const std::string &name, bool *reference) {
+  if (name == "simd") {
+    *reference = false;
+  } else if (name == "reference") {
+    *reference = true;
+  } else {
+    LOG(ERROR) << "Unknown decode impl:" << name;
+    return -1;
+  }
+  return 0;
+}
@@ -14,9 +14,10 @@
 
 #include "base/perception_common.h"
 #include "glog/logging.h"
+#include "post_process/yolo5_decode.h"
 #include "rapidjson/document.h"
-#include "utils/algorithm.h"
 #include "utils/nms.h"
+#include "utils/tracer.h"
 
 //Yolo5Config default_yolo5_config = {
 //    {8, 16, 32},
@@ -82,107 +83,29 @@ void Yolo5PostProcessModule::PostProcess(BPU_TENSOR_S *tensor,
                                          ImageTensor *frame,
                                          int layer,
                                          std::vector<Detection> &dets) {
-  HB_SYS_flushMemCache(&(tensor->data), HB_SYS_MEM_CACHE_INVALIDATE);
-  auto *data = reinterpret_cast<float *>(tensor->data.virAddr);
-  int num_classes = yolo5_config_.class_num;
-  int stride = yolo5_config_.strides[layer];
-  int num_pred = yolo5_config_.class_num + 4 + 1;
-
-  std::vector<float> class_pred(yolo5_config_.class_num, 0.0);
-  std::vector<std::pair<double, double>> &anchors =
-      yolo5_config_.anchors_table[layer];
-
-  double h_ratio = frame->height() * 1.0 / frame->ori_height();
-  double w_ratio = frame->width() * 1.0 / frame->ori_width();
-  double resize_ratio = std::min(w_ratio, h_ratio);
-  if (frame->is_pad_resize) {
-    w_ratio = resize_ratio;
-    h_ratio = resize_ratio;
+  {
+    TraceSpan span("invalidate");
+    HB_SYS_flushMemCache(&(tensor->data), HB_SYS_MEM_CACHE_INVALIDATE);
   }
+  auto *data = reinterpret_cast<float *>(tensor->data.virAddr);
 
-  int *shape = tensor->data_shape.d;
-  int height, width;
-  auto ret =
-      HB_BPU_getHW(tensor->data_type, &tensor->data_shape, &height, &width);
-  if (ret != 0) {
+  Yolo5DecodeParam param;
+  if (yolo5_decode_param(tensor, frame, &param) != 0) {
     LOG(FATAL) << "HB_BPU_getHW failed";
   }
-
-  //  for (uint32_t a = 0; a < anchors.size(); a++) {
-  for (uint32_t h = 0; h < height; h++) {
-    for (uint32_t w = 0; w < height; w++) {
-      for (int k = 0; k < anchors.size(); k++) {
-        double anchor_x = anchors[k].first;
-        double anchor_y = anchors[k].second;
-        float *cur_data = data + k * num_pred;
-        float objness = cur_data[4];
-        for (int index = 0; index < num_classes; ++index) {
-          class_pred[index] = cur_data[5 + index];
-        }
-
-        float id = argmax(class_pred.begin(), class_pred.end());
-        double x1 = 1 / (1 + std::exp(-objness)) * 1;
-        double x2 = 1 / (1 + std::exp(-class_pred[id]));
-        double confidence = x1 * x2;
-
-        if (confidence < score_threshold_) {
-          continue;
-        }
-
-        float center_x = cur_data[0];
-        float center_y = cur_data[1];
-        float scale_x = cur_data[2];
-        float scale_y = cur_data[3];
-
-        double box_center_x =
-            ((1.0 / (1.0 + std::exp(-center_x))) * 2 - 0.5 + w) * stride;
-        double box_center_y =
-            ((1.0 / (1.0 + std::exp(-center_y))) * 2 - 0.5 + h) * stride;
-
-        double box_scale_x =
-            std::pow((1.0 / (1.0 + std::exp(-scale_x))) * 2, 2) * anchor_x;
-        double box_scale_y =
-            std::pow((1.0 / (1.0 + std::exp(-scale_y))) * 2, 2) * anchor_y;
-
-        double xmin = (box_center_x - box_scale_x / 2.0);
-        double ymin = (box_center_y - box_scale_y / 2.0);
-        double xmax = (box_center_x + box_scale_x / 2.0);
-        double ymax = (box_center_y + box_scale_y / 2.0);
-
-        double w_padding =
-            (frame->width() - w_ratio * frame->ori_width()) / 2.0;
-        double h_padding =
-            (frame->height() - h_ratio * frame->ori_height()) / 2.0;
-
-        double xmin_org = (xmin - w_padding) / w_ratio;
-        double xmax_org = (xmax - w_padding) / w_ratio;
-        double ymin_org = (ymin - h_padding) / h_ratio;
-        double ymax_org = (ymax - h_padding) / h_ratio;
-
-        if (xmax_org <= 0 || ymax_org <= 0) {
-          continue;
-        }
-
-        if (xmin_org > xmax_org || ymin_org > ymax_org) {
-          continue;
-        }
-
-        xmin_org = std::max(xmin_org, 0.0);
-        xmax_org = std::min(xmax_org, frame->ori_image_width - 1.0);
-        ymin_org = std::max(ymin_org, 0.0);
-        ymax_org = std::min(ymax_org, frame->ori_image_height - 1.0);
-
-        Bbox bbox(xmin_org, ymin_org, xmax_org, ymax_org);
-        dets.push_back(Detection((int)id,
-                                 confidence,
-                                 bbox,
-                                 yolo5_config_.class_names[(int)id].c_str()));
-      }
-      data = data + num_pred * anchors.size();
-    }
+  param.stride = yolo5_config_.strides[layer];
+  param.anchors = &yolo5_config_.anchors_table[layer];
+  param.class_num = yolo5_config_.class_num;
+  param.class_names = &yolo5_config_.class_names;
+  param.score_threshold = score_threshold_;
+
+  TraceSpan span("decode");
+  if (reference_decode_) {
+    yolo5_decode_reference(data, param, dets);
+  } else {
+    yolo5_decode(data, param, dets);
   }
 }
-//}
 
 int Yolo5PostProcessModule::PostProcess(BPU_TENSOR_S *tensor,
                                         ImageTensor *image_tensor,
@@ -192,7 +115,7 @@ int Yolo5PostProcessModule::PostProcess(BPU_TENSOR_S *tensor,
   for (int i = 0; i < yolo5_config_.strides.size(); i++) {
     PostProcess(&tensor[i], image_tensor, i, dets);
   }
-  yolo5_nms(dets, nms_threshold_, nms_top_k_, perception->det, false);
+  run_nms(nms_impl_, dets, nms_threshold_, nms_top_k_, perception->det, false);
   return 0;
 }
 
@@ -217,6 +140,19 @@ int Yolo5PostProcessModule::LoadConfig(std::string &config_string) {
     nms_top_k_ = document["nms_top_k"].GetFloat();
   }
 
+  if (document.HasMember("decode_impl")) {
+    if (parse_decode_impl(document["decode_impl"].GetString(),
+                          &reference_decode_) != 0) {
+      return -1;
+    }
+  }
+
+  if (document.HasMember("nms_impl")) {
+    if (parse_nms_impl(document["nms_impl"].GetString(), &nms_impl_) != 0) {
+      return -1;
+    }
+  }
+
   if (document.HasMember("yolo5")) {
     rapidjson::Value &yolo = document["yolo5"];
 
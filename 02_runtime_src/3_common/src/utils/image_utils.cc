@@ -8,38 +8,395 @@
 
 #include "utils/image_utils.h"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <fstream>
 #include <string>
 #include<iomanip>
+#include <vector>
 #include "glog/logging.h"
 
-void bgr_to_nv12(cv::Mat &bgr_mat, cv::Mat &img_nv12) {
-  auto height = bgr_mat.rows;
-  auto width = bgr_mat.cols;
+// Fixed-point bits of resize coefficients, same as OpenCV
+// INTER_RESIZE_COEF_BITS
+#define RESIZE_COEF_BITS (11)
+#define RESIZE_COEF_SCALE (1 << RESIZE_COEF_BITS)
 
-  cv::Mat yuv_mat;
-  cv::cvtColor(bgr_mat, yuv_mat, cv::COLOR_BGR2YUV_I420);
+// BT.601 fixed-point coefficients used by OpenCV COLOR_BGR2YUV_I420
+#define YUV_SHIFT (20)
+#define YUV_HALF (1 << (YUV_SHIFT - 1))
+#define YUV_CRY (269484)
+#define YUV_CGY (528482)
+#define YUV_CBY (102760)
+#define YUV_CRU (-155188)
+#define YUV_CGU (-305135)
+#define YUV_CBU (460324)
+#define YUV_CRV (460324)
+#define YUV_CGV (-385875)
+#define YUV_CBV (-74448)
 
-  uint8_t *yuv = yuv_mat.ptr<uint8_t>();
-  img_nv12 = cv::Mat(height * 3 / 2, width, CV_8UC1);
-  uint8_t *ynv12 = img_nv12.ptr<uint8_t>();
+/**
+ * Source index & coefficients of bilinear resize along one axis
+ * @param[in] src: source size
+ * @param[in] dst: destination size
+ * @param[in] clamp_border: pin border pixels to the edge (OpenCV does this
+ *            horizontally, vertically it clamps the source rows instead)
+ * @param[out] ofs: first source index, may be -1 if not clamp_border
+ * @param[out] coef: coefficient pairs
+ */
+static void linear_resize_coef(int src,
+                               int dst,
+                               bool clamp_border,
+                               std::vector<int> &ofs,
+                               std::vector<int> &coef) {
+  double scale = 1.0 / (static_cast<double>(dst) / src);
+  ofs.resize(dst);
+  coef.resize(dst * 2);
+  for (int d = 0; d < dst; d++) {
+    float f = static_cast<float>((d + 0.5) * scale - 0.5);
+    int s = static_cast<int>(std::floor(f));
+    f -= s;
+    if (clamp_border && s < 0) {
+      s = 0;
+      f = 0;
+    }
+    if (clamp_border && s >= src - 1) {
+      s = src - 1;
+      f = 0;
+    }
+    ofs[d] = s;
+    coef[d * 2] = cv::saturate_cast<short>((1.f - f) * RESIZE_COEF_SCALE);
+    coef[d * 2 + 1] = cv::saturate_cast<short>(f * RESIZE_COEF_SCALE);
+  }
+}
+
+/**
+ * Convert one BGR row to Y, and to interleaved UV if uv is not null.
+ * Chroma is taken from the even pixels like OpenCV does.
+ */
+static inline void bgr_row_to_nv12(const uint8_t *bgr,
+                                   int width,
+                                   uint8_t *y,
+                                   uint8_t *uv) {
+  for (int x = 0; x < width; x++) {
+    int b = bgr[x * 3], g = bgr[x * 3 + 1], r = bgr[x * 3 + 2];
+    y[x] = (YUV_CRY * r + YUV_CGY * g + YUV_CBY * b + (16 << YUV_SHIFT) +
+            YUV_HALF) >>
+           YUV_SHIFT;
+  }
+  if (uv == nullptr) {
+    return;
+  }
+  for (int x = 0; x + 1 < width; x += 2) {
+    int b = bgr[x * 3], g = bgr[x * 3 + 1], r = bgr[x * 3 + 2];
+    uv[x] = (YUV_CRU * r + YUV_CGU * g + YUV_CBU * b + (128 << YUV_SHIFT) +
+             YUV_HALF) >>
+            YUV_SHIFT;
+    uv[x + 1] = (YUV_CRV * r + YUV_CGV * g + YUV_CBV * b +
+                 (128 << YUV_SHIFT) + YUV_HALF) >>
+                YUV_SHIFT;
+  }
+}
+
+namespace {
+
+/**
+ * Bilinear resize of 8-bit interleaved channels producing one output row at
+ * a time, with the two horizontally resized source rows cached between
+ * output rows
+ */
+class LinearRowResizer {
+ public:
+  LinearRowResizer(const uint8_t *src,
+                   int src_width,
+                   int src_height,
+                   int src_step,
+                   int dst_width,
+                   int dst_height,
+                   int channels = 3)
+      : src_(src),
+        src_width_(src_width),
+        src_height_(src_height),
+        src_step_(src_step),
+        dst_width_(dst_width),
+        channels_(channels),
+        identity_(src_width == dst_width && src_height == dst_height) {
+    if (identity_) {
+      return;
+    }
+    linear_resize_coef(src_width, dst_width, true, x_ofs_, x_coef_);
+    linear_resize_coef(src_height, dst_height, false, y_ofs_, y_coef_);
+    line_buffer_.resize(dst_width * channels * 2);
+    lines_[0] = line_buffer_.data();
+    lines_[1] = line_buffer_.data() + dst_width * channels;
+  }
 
-  int uv_height = height / 2;
-  int uv_width = width / 2;
+  /**
+   * Resized output row
+   * @param[in] dy: output row index
+   * @param[out] out: dst_width pixels
+   */
+  void Row(int dy, uint8_t *out) {
+    int row_len = dst_width_ * channels_;
+    if (identity_) {
+      memcpy(out, src_ + dy * src_step_, row_len);
+      return;
+    }
 
-  // copy y data
-  int y_size = height * width;
-  memcpy(ynv12, yuv, y_size);
+    int sy0 = std::min(std::max(y_ofs_[dy], 0), src_height_ - 1);
+    int sy1 = std::min(std::max(y_ofs_[dy] + 1, 0), src_height_ - 1);
+    // Reuse rows cached for the previous output row
+    if (line_rows_[0] != sy0 && line_rows_[1] != sy0) {
+      Horizontal(sy0, line_rows_[0] == sy1 ? 1 : 0);
+    }
+    if (line_rows_[0] != sy1 && line_rows_[1] != sy1) {
+      Horizontal(sy1, line_rows_[0] == sy0 ? 1 : 0);
+    }
+    const int *row0 = lines_[line_rows_[0] == sy0 ? 0 : 1];
+    const int *row1 = lines_[line_rows_[0] == sy1 ? 0 : 1];
 
-  // copy uv data
-  uint8_t *nv12 = ynv12 + y_size;
-  uint8_t *u_data = yuv + y_size;
-  uint8_t *v_data = u_data + uv_height * uv_width;
+    // Same rounding as OpenCV vertical linear pass
+    int b0 = y_coef_[dy * 2], b1 = y_coef_[dy * 2 + 1];
+    for (int i = 0; i < row_len; i++) {
+      int v = (((b0 * (row0[i] >> 4)) >> 16) + ((b1 * (row1[i] >> 4)) >> 16) +
+               2) >>
+              2;
+      out[i] = cv::saturate_cast<uint8_t>(v);
+    }
+  }
 
-  for (int i = 0; i < uv_width * uv_height; i++) {
-    *nv12++ = *u_data++;
-    *nv12++ = *v_data++;
+ private:
+  void Horizontal(int sy, int slot) {
+    const uint8_t *src = src_ + sy * src_step_;
+    int *dst = lines_[slot];
+    for (int dx = 0; dx < dst_width_; dx++) {
+      int sx0 = x_ofs_[dx] * channels_;
+      int sx1 = std::min(x_ofs_[dx] + 1, src_width_ - 1) * channels_;
+      int c0 = x_coef_[dx * 2], c1 = x_coef_[dx * 2 + 1];
+      for (int c = 0; c < channels_; c++) {
+        dst[dx * channels_ + c] = src[sx0 + c] * c0 + src[sx1 + c] * c1;
+      }
+    }
+    line_rows_[slot] = sy;
   }
+
+ private:
+  const uint8_t *src_;
+  int src_width_;
+  int src_height_;
+  int src_step_;
+  int dst_width_;
+  int channels_;
+  bool identity_;
+  std::vector<int> x_ofs_;
+  std::vector<int> x_coef_;
+  std::vector<int> y_ofs_;
+  std::vector<int> y_coef_;
+  std::vector<int> line_buffer_;
+  int *lines_[2] = {nullptr, nullptr};
+  int line_rows_[2] = {-1, -1};
+};
+
+}  // namespace
+
+uint8_t bgr_to_luma(uint8_t b, uint8_t g, uint8_t r) {
+  uint8_t bgr[3] = {b, g, r};
+  uint8_t y;
+  bgr_row_to_nv12(bgr, 1, &y, nullptr);
+  return y;
+}
+
+void resize_bgr_to_nv12(const uint8_t *bgr,
+                        int src_width,
+                        int src_height,
+                        int src_step,
+                        int dst_width,
+                        int dst_height,
+                        uint8_t *y,
+                        int y_stride,
+                        uint8_t *uv,
+                        int uv_stride) {
+  int uv_height = dst_height / 2;
+  if (src_width == dst_width && src_height == dst_height) {
+    for (int dy = 0; dy < dst_height; dy++) {
+      bool has_uv = dy % 2 == 0 && dy / 2 < uv_height;
+      bgr_row_to_nv12(bgr + dy * src_step,
+                      dst_width,
+                      y + dy * y_stride,
+                      has_uv ? uv + dy / 2 * uv_stride : nullptr);
+    }
+    return;
+  }
+
+  LinearRowResizer resizer(
+      bgr, src_width, src_height, src_step, dst_width, dst_height);
+  std::vector<uint8_t> bgr_row(dst_width * 3);
+  for (int dy = 0; dy < dst_height; dy++) {
+    resizer.Row(dy, bgr_row.data());
+    bool has_uv = dy % 2 == 0 && dy / 2 < uv_height;
+    bgr_row_to_nv12(bgr_row.data(),
+                    dst_width,
+                    y + dy * y_stride,
+                    has_uv ? uv + dy / 2 * uv_stride : nullptr);
+  }
+}
+
+cv::Rect letterbox_rect(int src_width,
+                        int src_height,
+                        int dst_width,
+                        int dst_height) {
+  double scale = std::min(dst_width * 1.0 / src_width,
+                          dst_height * 1.0 / src_height);
+  int width = static_cast<int>(scale * src_width);
+  int height = static_cast<int>(scale * src_height);
+  return cv::Rect(
+      (dst_width - width) / 2, (dst_height - height) / 2, width, height);
+}
+
+void letterbox_bgr_to_nv12(const uint8_t *bgr,
+                           int src_width,
+                           int src_height,
+                           int src_step,
+                           int dst_width,
+                           int dst_height,
+                           uint8_t pad_value,
+                           uint8_t *y,
+                           int y_stride,
+                           uint8_t *uv,
+                           int uv_stride) {
+  cv::Rect roi = letterbox_rect(src_width, src_height, dst_width, dst_height);
+  LinearRowResizer resizer(
+      bgr, src_width, src_height, src_step, roi.width, roi.height);
+
+  // Padding is converted with the image, so chroma at an odd border is
+  // the same as converting the padded BGR image
+  std::vector<uint8_t> pad_row(dst_width * 3, pad_value);
+  std::vector<uint8_t> bgr_row(dst_width * 3, pad_value);
+  uint8_t *roi_row = bgr_row.data() + roi.x * 3;
+  int uv_height = dst_height / 2;
+  for (int dy = 0; dy < dst_height; dy++) {
+    const uint8_t *row = pad_row.data();
+    if (dy >= roi.y && dy < roi.y + roi.height) {
+      resizer.Row(dy - roi.y, roi_row);
+      row = bgr_row.data();
+    }
+    bool has_uv = dy % 2 == 0 && dy / 2 < uv_height;
+    bgr_row_to_nv12(row,
+                    dst_width,
+                    y + dy * y_stride,
+                    has_uv ? uv + dy / 2 * uv_stride : nullptr);
+  }
+}
+
+void yuv420p_to_nv12(const uint8_t *const planes[3],
+                     const int strides[3],
+                     int src_width,
+                     int src_height,
+                     bool full_range,
+                     const cv::Rect &roi,
+                     uint8_t pad_value,
+                     int dst_width,
+                     int dst_height,
+                     uint8_t *y,
+                     int y_stride,
+                     uint8_t *uv,
+                     int uv_stride) {
+  // JPEG (JFIF) YCbCr is full range, NV12 model input is studio range
+  // like BGR2YUV_I420
+  uint8_t y_lut[256], c_lut[256];
+  for (int i = 0; i < 256; i++) {
+    y_lut[i] = full_range ? cv::saturate_cast<uint8_t>(i * 219.f / 255 + 16)
+                          : static_cast<uint8_t>(i);
+    c_lut[i] = full_range
+                   ? cv::saturate_cast<uint8_t>((i - 128) * 224.f / 255 + 128)
+                   : static_cast<uint8_t>(i);
+  }
+  // Border converted the same way as a BGR input
+  uint8_t pad_bgr[6];
+  memset(pad_bgr, pad_value, sizeof(pad_bgr));
+  uint8_t pad_y[2], pad_uv[2];
+  bgr_row_to_nv12(pad_bgr, 2, pad_y, pad_uv);
+
+  LinearRowResizer y_resizer(planes[0],
+                             src_width,
+                             src_height,
+                             strides[0],
+                             roi.width,
+                             roi.height,
+                             1);
+  // Chroma region of the image, half of the luma region
+  int src_uv_width = (src_width + 1) / 2;
+  int src_uv_height = (src_height + 1) / 2;
+  int uv_x = roi.x / 2;
+  int uv_y = roi.y / 2;
+  int uv_width = std::max((roi.x + roi.width) / 2 - uv_x, 1);
+  int uv_height = std::max((roi.y + roi.height) / 2 - uv_y, 1);
+  LinearRowResizer u_resizer(planes[1],
+                             src_uv_width,
+                             src_uv_height,
+                             strides[1],
+                             uv_width,
+                             uv_height,
+                             1);
+  LinearRowResizer v_resizer(planes[2],
+                             src_uv_width,
+                             src_uv_height,
+                             strides[2],
+                             uv_width,
+                             uv_height,
+                             1);
+
+  std::vector<uint8_t> row(std::max(roi.width, uv_width * 2));
+  for (int dy = 0; dy < dst_height; dy++) {
+    uint8_t *dst = y + dy * y_stride;
+    if (dy < roi.y || dy >= roi.y + roi.height) {
+      memset(dst, pad_y[0], dst_width);
+      continue;
+    }
+    y_resizer.Row(dy - roi.y, row.data());
+    memset(dst, pad_y[0], roi.x);
+    for (int dx = 0; dx < roi.width; dx++) {
+      dst[roi.x + dx] = y_lut[row[dx]];
+    }
+    memset(dst + roi.x + roi.width,
+           pad_y[0],
+           dst_width - roi.x - roi.width);
+  }
+
+  uint8_t *v_row = row.data() + uv_width;
+  for (int dy = 0; dy < dst_height / 2; dy++) {
+    uint8_t *dst = uv + dy * uv_stride;
+    for (int dx = 0; dx + 1 < dst_width; dx += 2) {
+      dst[dx] = pad_uv[0];
+      dst[dx + 1] = pad_uv[1];
+    }
+    if (dy < uv_y || dy >= uv_y + uv_height) {
+      continue;
+    }
+    u_resizer.Row(dy - uv_y, row.data());
+    v_resizer.Row(dy - uv_y, v_row);
+    for (int dx = 0; dx < uv_width; dx++) {
+      dst[(uv_x + dx) * 2] = c_lut[row[dx]];
+      dst[(uv_x + dx) * 2 + 1] = c_lut[v_row[dx]];
+    }
+  }
+}
+
+void bgr_to_nv12(cv::Mat &bgr_mat, cv::Mat &img_nv12) {
+  auto height = bgr_mat.rows;
+  auto width = bgr_mat.cols;
+  img_nv12 = cv::Mat(height * 3 / 2, width, CV_8UC1);
+  uint8_t *y = img_nv12.ptr<uint8_t>();
+  resize_bgr_to_nv12(bgr_mat.ptr<uint8_t>(),
+                     width,
+                     height,
+                     bgr_mat.step,
+                     width,
+                     height,
+                     y,
+                     width,
+                     y + height * width,
+                     width);
 }
 
 int draw_perception(ImageTensor *frame, Perception *perception, cv::Mat &mat) {
@@ -146,8 +503,9 @@ int image_tensor_to_mat(ImageTensor *image_tensor, cv::Mat &mat) {
         *data++ = data0[h * stride + w];
       }
     }
-    for (int i = 0; i < height * width / 2; i++) {
-      *data++ = *data1++;
+    for (int h = 0; h < height / 2; h++) {
+      memcpy(data, data1 + h * stride, width);
+      data += width;
     }
     cv::cvtColor(nv12, resized, cv::COLOR_YUV2BGR_NV12);
     cv::resize(resized, mat, mat.size(), 0, 0);
@@ -165,8 +523,9 @@ int image_tensor_to_mat(ImageTensor *image_tensor, cv::Mat &mat) {
         *data++ = data0[h * stride + w];
       }
     }
-    for (int i = 0; i < height * width / 2; i++) {
-      *data++ = *data1++;
+    for (int h = 0; h < height / 2; h++) {
+      memcpy(data, data1 + h * stride, width);
+      data += width;
     }
     cv::cvtColor(nv12, resized, cv::COLOR_YUV2BGR_NV12);
     cv::resize(resized, mat, mat.size(), 0, 0);
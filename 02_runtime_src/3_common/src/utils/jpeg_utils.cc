@@ -0,0 +1,273 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "utils/jpeg_utils.h"
+
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <vector>
+
+#include "glog/logging.h"
+#include "turbojpeg.h"
+#include "utils/image_utils.h"
+
+// Max DCT scaling denominator, TurboJPEG scales by 1/2, 1/4 & 1/8
+#define JPEG_MAX_SCALE_DENOM (8)
+
+/**
+ * Decompress handle of current thread
+ */
+static tjhandle thread_decompressor() {
+  thread_local std::unique_ptr<void, int (*)(tjhandle)> handle(
+      tjInitDecompress(), tjDestroy);
+  return handle.get();
+}
+
+static int read_file(const std::string &path,
+                     std::vector<unsigned char> &buffer) {
+  std::ifstream ifs(path, std::ios::in | std::ios::binary);
+  if (!ifs.is_open()) {
+    LOG(ERROR) << "Open " << path << " failed";
+    return -1;
+  }
+  ifs.seekg(0, std::ios::end);
+  buffer.resize(ifs.tellg());
+  ifs.seekg(0, std::ios::beg);
+  ifs.read(reinterpret_cast<char *>(buffer.data()), buffer.size());
+  return ifs ? 0 : -1;
+}
+
+static int read_u16(const unsigned char *p, bool little_endian) {
+  return little_endian ? (p[0] | p[1] << 8) : (p[0] << 8 | p[1]);
+}
+
+static uint32_t read_u32(const unsigned char *p, bool little_endian) {
+  return little_endian ? (p[0] | p[1] << 8 | p[2] << 16 | uint32_t(p[3]) << 24)
+                       : (uint32_t(p[0]) << 24 | p[1] << 16 | p[2] << 8 | p[3]);
+}
+
+/**
+ * Orientation tag of the EXIF APP1 segment in IFD0
+ * @return 1 if the JPEG has no EXIF orientation
+ */
+static int exif_orientation(const std::vector<unsigned char> &jpeg) {
+  const unsigned char *data = jpeg.data();
+  size_t size = jpeg.size();
+  size_t pos = 2;  // SOI
+  while (pos + 4 <= size && data[pos] == 0xFF) {
+    int marker = data[pos + 1];
+    size_t length = read_u16(data + pos + 2, false);
+    // Start of scan, no EXIF before image data
+    if (marker == 0xDA || length < 2 || pos + 2 + length > size) {
+      break;
+    }
+    const unsigned char *segment = data + pos + 4;
+    size_t segment_size = length - 2;
+    if (marker == 0xE1 && segment_size >= 14 &&
+        std::memcmp(segment, "Exif\0\0", 6) == 0) {
+      const unsigned char *tiff = segment + 6;
+      size_t tiff_size = segment_size - 6;
+      bool le = tiff[0] == 'I' && tiff[1] == 'I';
+      if (!le && !(tiff[0] == 'M' && tiff[1] == 'M')) {
+        return 1;
+      }
+      size_t ifd = read_u32(tiff + 4, le);
+      if (ifd + 2 > tiff_size) {
+        return 1;
+      }
+      int entry_count = read_u16(tiff + ifd, le);
+      for (int entry = 0; entry < entry_count; entry++) {
+        size_t offset = ifd + 2 + entry * 12;
+        if (offset + 12 > tiff_size) {
+          break;
+        }
+        // Orientation, SHORT
+        if (read_u16(tiff + offset, le) == 0x0112) {
+          return read_u16(tiff + offset + 8, le);
+        }
+      }
+      return 1;
+    }
+    pos += 2 + length;
+  }
+  return 1;
+}
+
+static int decode_by_opencv(const std::string &path,
+                            const std::vector<unsigned char> &buffer,
+                            int &ori_width,
+                            int &ori_height,
+                            BPU_TENSOR_S *tensor,
+                            ResizeMode resize_mode,
+                            ColorMode color_mode) {
+  bool gray = color_mode == ColorMode::GRAY;
+  cv::Mat mat =
+      cv::imdecode(buffer, gray ? cv::IMREAD_GRAYSCALE : cv::IMREAD_COLOR);
+  if (mat.empty()) {
+    LOG(ERROR) << "Decode image failed, path: " << path;
+    return -1;
+  }
+  ori_width = mat.cols;
+  ori_height = mat.rows;
+  return gray ? gray_mat_to_tensor(mat, tensor, resize_mode)
+              : bgr_mat_to_tensor(mat, tensor, resize_mode);
+}
+
+int jpeg_scale_denom(int src_width,
+                     int src_height,
+                     int min_width,
+                     int min_height) {
+  int denom = 1;
+  while (denom < JPEG_MAX_SCALE_DENOM) {
+    tjscalingfactor factor{1, denom * 2};
+    if (TJSCALED(src_width, factor) < min_width ||
+        TJSCALED(src_height, factor) < min_height) {
+      break;
+    }
+    denom *= 2;
+  }
+  return denom;
+}
+
+int read_jpeg_tensor(const std::string &path,
+                     int &ori_width,
+                     int &ori_height,
+                     BPU_TENSOR_S *tensor,
+                     ResizeMode resize_mode,
+                     ColorMode color_mode) {
+  if (color_mode == ColorMode::RAW16) {
+    return read_image_tensor(
+        path, ori_width, ori_height, tensor, resize_mode, color_mode);
+  }
+
+  std::vector<unsigned char> jpeg;
+  if (read_file(path, jpeg) != 0) {
+    LOG(ERROR) << "Read image failed, path: " << path;
+    return -1;
+  }
+
+  tjhandle handle = thread_decompressor();
+  int subsamp, colorspace;
+  if (tjDecompressHeader3(handle,
+                          jpeg.data(),
+                          jpeg.size(),
+                          &ori_width,
+                          &ori_height,
+                          &subsamp,
+                          &colorspace) != 0 ||
+      exif_orientation(jpeg) != 1) {
+    // Not JPEG, or rotated by EXIF which OpenCV applies like cv::imread
+    return decode_by_opencv(path,
+                            jpeg,
+                            ori_width,
+                            ori_height,
+                            tensor,
+                            resize_mode,
+                            color_mode);
+  }
+
+  auto data_type = tensor->data_type;
+  int h_idx, w_idx, c_idx;
+  HB_BPU_getHWCIndex(data_type, nullptr, &h_idx, &w_idx, &c_idx);
+  auto height = tensor->data_shape.d[h_idx];
+  auto width = tensor->data_shape.d[w_idx];
+  auto stride = tensor->aligned_shape.d[w_idx];
+
+  cv::Rect roi(0, 0, width, height);
+  if (resize_mode == ResizeMode::LETTERBOX) {
+    roi = letterbox_rect(ori_width, ori_height, width, height);
+  }
+  tjscalingfactor factor{
+      1, jpeg_scale_denom(ori_width, ori_height, roi.width, roi.height)};
+  int scaled_width = TJSCALED(ori_width, factor);
+  int scaled_height = TJSCALED(ori_height, factor);
+
+  if (color_mode == ColorMode::GRAY) {
+    cv::Mat gray_mat(scaled_height, scaled_width, CV_8UC1);
+    if (tjDecompress2(handle,
+                      jpeg.data(),
+                      jpeg.size(),
+                      gray_mat.ptr<uint8_t>(),
+                      scaled_width,
+                      gray_mat.step,
+                      scaled_height,
+                      TJPF_GRAY,
+                      0) != 0) {
+      LOG(ERROR) << "Decode jpeg failed, path: " << path
+                 << ", error: " << tjGetErrorStr2(handle);
+      return -1;
+    }
+    return gray_mat_to_tensor(gray_mat, tensor, resize_mode);
+  }
+
+  bool is_nv12 = data_type == BPU_TYPE_IMG_YUV_NV12 ||
+                 data_type == BPU_TYPE_IMG_NV12_SEPARATE;
+  if (is_nv12 && subsamp == TJSAMP_420 && colorspace == TJCS_YCbCr) {
+    // Decoded planes are reused by the thread
+    thread_local std::vector<unsigned char> yuv;
+    int strides[3];
+    int plane_sizes[3];
+    for (int i = 0; i < 3; i++) {
+      strides[i] = tjPlaneWidth(i, scaled_width, subsamp);
+      plane_sizes[i] = strides[i] * tjPlaneHeight(i, scaled_height, subsamp);
+    }
+    yuv.resize(plane_sizes[0] + plane_sizes[1] + plane_sizes[2]);
+    unsigned char *planes[3] = {yuv.data(),
+                                yuv.data() + plane_sizes[0],
+                                yuv.data() + plane_sizes[0] + plane_sizes[1]};
+    if (tjDecompressToYUVPlanes(handle,
+                                jpeg.data(),
+                                jpeg.size(),
+                                planes,
+                                scaled_width,
+                                strides,
+                                scaled_height,
+                                0) != 0) {
+      LOG(ERROR) << "Decode jpeg failed, path: " << path
+                 << ", error: " << tjGetErrorStr2(handle);
+      return -1;
+    }
+
+    uint8_t *y = reinterpret_cast<uint8_t *>(tensor->data.virAddr);
+    uint8_t *uv = data_type == BPU_TYPE_IMG_YUV_NV12
+                      ? y + height * stride
+                      : reinterpret_cast<uint8_t *>(tensor->data_ext.virAddr);
+    yuv420p_to_nv12(planes,
+                    strides,
+                    scaled_width,
+                    scaled_height,
+                    true,
+                    roi,
+                    LETTERBOX_PAD_VALUE,
+                    width,
+                    height,
+                    y,
+                    stride,
+                    uv,
+                    stride);
+    return 0;
+  }
+
+  // Other sampling & tensor types still benefit from DCT scaling
+  cv::Mat bgr_mat(scaled_height, scaled_width, CV_8UC3);
+  if (tjDecompress2(handle,
+                    jpeg.data(),
+                    jpeg.size(),
+                    bgr_mat.ptr<uint8_t>(),
+                    scaled_width,
+                    bgr_mat.step,
+                    scaled_height,
+                    TJPF_BGR,
+                    0) != 0) {
+    LOG(ERROR) << "Decode jpeg failed, path: " << path
+               << ", error: " << tjGetErrorStr2(handle);
+    return -1;
+  }
+  return bgr_mat_to_tensor(bgr_mat, tensor, resize_mode);
+}
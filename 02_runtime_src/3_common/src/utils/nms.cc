@@ -13,11 +13,16 @@
 //#define NMS_MAX_INPUT (400)
 #define NMS_MAX_INPUT (600)
 #include "glog/logging.h"
+#include "utils/nms_engine.h"
+#include "utils/simd_iou.h"
+#include "utils/tracer.h"
+
 void nms(std::vector<Detection> &input,
          float iou_threshold,
          int top_k,
          std::vector<Detection> &result,
          bool suppress) {
+  TraceSpan span("nms");
   // sort order by score desc
   std::stable_sort(input.begin(), input.end(), std::greater<Detection>());
   //cout<<"--------------"<<input.size()<<endl;
@@ -132,3 +137,38 @@ void yolo5_nms(std::vector<Detection> &input,
     result.push_back(input[i]);
   }
 }
+
+int parse_nms_impl(const std::string &name, NmsImpl *impl) {
+  if (name == "default") {
+    *impl = NmsImpl::DEFAULT;
+  } else if (name == "grid") {
+    *impl = NmsImpl::GRID;
+  } else if (name == "simd") {
+    *impl = NmsImpl::SIMD;
+  } else {
+    LOG(ERROR) << "Unknown nms impl:" << name;
+    return -1;
+  }
+  return 0;
+}
+
+void run_nms(NmsImpl impl,
+             std::vector<Detection> &input,
+             float iou_threshold,
+             int top_k,
+             std::vector<Detection> &result,
+             bool suppress) {
+  TraceSpan span("nms");
+  switch (impl) {
+    case NmsImpl::GRID:
+      grid_nms(input, iou_threshold, top_k, result, suppress);
+      break;
+    case NmsImpl::SIMD:
+      simd_nms(input, iou_threshold, top_k, result, suppress);
+      break;
+    case NmsImpl::DEFAULT:
+    default:
+      yolo5_nms(input, iou_threshold, top_k, result, suppress);
+      break;
+  }
+}
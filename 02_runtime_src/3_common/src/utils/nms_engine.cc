@@ -0,0 +1,247 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "utils/nms_engine.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+// Max grid cells per axis
+#define NMS_GRID_MAX_CELLS (64)
+
+void BoxArray::Clear() {
+  xmin.clear();
+  ymin.clear();
+  xmax.clear();
+  ymax.clear();
+  area.clear();
+  score.clear();
+  index.clear();
+}
+
+void BoxArray::Reserve(size_t n) {
+  xmin.reserve(n);
+  ymin.reserve(n);
+  xmax.reserve(n);
+  ymax.reserve(n);
+  area.reserve(n);
+  score.reserve(n);
+  index.reserve(n);
+}
+
+void BoxArray::Add(const Detection &det, int det_index) {
+  xmin.push_back(det.bbox.xmin);
+  ymin.push_back(det.bbox.ymin);
+  xmax.push_back(det.bbox.xmax);
+  ymax.push_back(det.bbox.ymax);
+  area.push_back((det.bbox.xmax - det.bbox.xmin) *
+                 (det.bbox.ymax - det.bbox.ymin));
+  score.push_back(det.score);
+  index.push_back(det_index);
+}
+
+namespace {
+
+/**
+ * Uniform grid over the boxes of one class, every cell holds the kept boxes
+ * overlapping it
+ */
+class BoxGrid {
+ public:
+  void Init(const BoxArray &boxes) {
+    float x0 = boxes.xmin[0], y0 = boxes.ymin[0];
+    float x1 = boxes.xmax[0], y1 = boxes.ymax[0];
+    double sum_w = 0, sum_h = 0;
+    for (size_t i = 0; i < boxes.Size(); i++) {
+      x0 = std::min(x0, boxes.xmin[i]);
+      y0 = std::min(y0, boxes.ymin[i]);
+      x1 = std::max(x1, boxes.xmax[i]);
+      y1 = std::max(y1, boxes.ymax[i]);
+      sum_w += std::max(boxes.xmax[i] - boxes.xmin[i], 0.0f);
+      sum_h += std::max(boxes.ymax[i] - boxes.ymin[i], 0.0f);
+    }
+    // Cell about the size of an average box, so a box spans few cells
+    double mean_w = std::max(sum_w / boxes.Size(), 1e-3);
+    double mean_h = std::max(sum_h / boxes.Size(), 1e-3);
+    cols_ = Clamp(std::ceil((x1 - x0) / mean_w), 1, NMS_GRID_MAX_CELLS);
+    rows_ = Clamp(std::ceil((y1 - y0) / mean_h), 1, NMS_GRID_MAX_CELLS);
+    x0_ = x0;
+    y0_ = y0;
+    inv_cell_w_ = x1 > x0 ? cols_ / (x1 - x0) : 0;
+    inv_cell_h_ = y1 > y0 ? rows_ / (y1 - y0) : 0;
+    cells_.assign(rows_ * cols_, std::vector<int>());
+  }
+
+  /**
+   * Cell range covered by a box, inclusive
+   */
+  void Range(const BoxArray &boxes,
+             int i,
+             int *cx0,
+             int *cy0,
+             int *cx1,
+             int *cy1) const {
+    *cx0 = Clamp((boxes.xmin[i] - x0_) * inv_cell_w_, 0, cols_ - 1);
+    *cx1 = Clamp((boxes.xmax[i] - x0_) * inv_cell_w_, 0, cols_ - 1);
+    *cy0 = Clamp((boxes.ymin[i] - y0_) * inv_cell_h_, 0, rows_ - 1);
+    *cy1 = Clamp((boxes.ymax[i] - y0_) * inv_cell_h_, 0, rows_ - 1);
+  }
+
+  std::vector<int> &Cell(int cx, int cy) { return cells_[cy * cols_ + cx]; }
+
+ private:
+  static int Clamp(double v, int lo, int hi) {
+    if (!(v >= lo)) {
+      return lo;
+    }
+    return v > hi ? hi : static_cast<int>(v);
+  }
+
+ private:
+  int rows_ = 1;
+  int cols_ = 1;
+  float x0_ = 0;
+  float y0_ = 0;
+  double inv_cell_w_ = 0;
+  double inv_cell_h_ = 0;
+  std::vector<std::vector<int>> cells_;
+};
+
+/**
+ * NMS inside one class
+ * @param[in] boxes: boxes of the class
+ * @param[in] iou_threshold: suppress if IoU is larger than threshold
+ * @param[in] top_k: max kept count
+ * @param[out] kept: index in input detections of kept boxes
+ */
+void class_nms(const BoxArray &boxes,
+               float iou_threshold,
+               int top_k,
+               std::vector<int> &kept) {
+  int n = boxes.Size();
+  // Highest score first, lower input index first on tie (stable order)
+  auto less = [&boxes](int a, int b) {
+    if (boxes.score[a] != boxes.score[b]) {
+      return boxes.score[a] < boxes.score[b];
+    }
+    return boxes.index[a] > boxes.index[b];
+  };
+  std::vector<int> heap(n);
+  std::iota(heap.begin(), heap.end(), 0);
+  std::make_heap(heap.begin(), heap.end(), less);
+
+  BoxGrid grid;
+  grid.Init(boxes);
+  // Last candidate a kept box was compared with, kept boxes may be in
+  // several cells
+  std::vector<int> visited(n, -1);
+
+  int kept_count = 0;
+  while (!heap.empty() && kept_count < top_k) {
+    std::pop_heap(heap.begin(), heap.end(), less);
+    int i = heap.back();
+    heap.pop_back();
+
+    int cx0, cy0, cx1, cy1;
+    grid.Range(boxes, i, &cx0, &cy0, &cx1, &cy1);
+    bool suppressed = false;
+    for (int cy = cy0; !suppressed && cy <= cy1; cy++) {
+      for (int cx = cx0; !suppressed && cx <= cx1; cx++) {
+        for (int k : grid.Cell(cx, cy)) {
+          if (visited[k] == i) {
+            continue;
+          }
+          visited[k] = i;
+          float xx1 = std::max(boxes.xmin[k], boxes.xmin[i]);
+          float yy1 = std::max(boxes.ymin[k], boxes.ymin[i]);
+          float xx2 = std::min(boxes.xmax[k], boxes.xmax[i]);
+          float yy2 = std::min(boxes.ymax[k], boxes.ymax[i]);
+          if (xx2 > xx1 && yy2 > yy1) {
+            float area_intersection = (xx2 - xx1) * (yy2 - yy1);
+            float iou_ratio = area_intersection /
+                              (boxes.area[i] + boxes.area[k] - area_intersection);
+            if (iou_ratio > iou_threshold) {
+              suppressed = true;
+              break;
+            }
+          }
+        }
+      }
+    }
+    if (suppressed) {
+      continue;
+    }
+
+    kept.push_back(boxes.index[i]);
+    kept_count++;
+    for (int cy = cy0; cy <= cy1; cy++) {
+      for (int cx = cx0; cx <= cx1; cx++) {
+        grid.Cell(cx, cy).push_back(i);
+      }
+    }
+  }
+}
+
+}  // namespace
+
+void grid_nms(const std::vector<Detection> &input,
+              float iou_threshold,
+              int top_k,
+              std::vector<Detection> &result,
+              bool suppress) {
+  int n = input.size();
+  if (n == 0 || top_k <= 0) {
+    return;
+  }
+
+  // Partition by class, input order is kept inside a class
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  if (!suppress) {
+    std::stable_sort(order.begin(), order.end(), [&input](int a, int b) {
+      return input[a].id < input[b].id;
+    });
+  }
+
+  std::vector<int> kept;
+  BoxArray boxes;
+  boxes.Reserve(n);
+  for (int begin = 0; begin < n;) {
+    int end = begin + 1;
+    if (!suppress) {
+      while (end < n && input[order[end]].id == input[order[begin]].id) {
+        end++;
+      }
+    } else {
+      end = n;
+    }
+
+    boxes.Clear();
+    for (int i = begin; i < end; i++) {
+      boxes.Add(input[order[i]], order[i]);
+    }
+    class_nms(boxes, iou_threshold, top_k, kept);
+    begin = end;
+  }
+
+  // Classes are independent, merge them in score order
+  std::sort(kept.begin(), kept.end(), [&input](int a, int b) {
+    if (input[a].score != input[b].score) {
+      return input[a].score > input[b].score;
+    }
+    return a < b;
+  });
+  if (kept.size() > static_cast<size_t>(top_k)) {
+    kept.resize(top_k);
+  }
+  result.reserve(result.size() + kept.size());
+  for (int i : kept) {
+    result.push_back(input[i]);
+  }
+}
@@ -0,0 +1,215 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "utils/simd_iou.h"
+
+#include <algorithm>
+#include <numeric>
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SIMD_IOU_NEON
+#elif defined(__AVX512F__)
+#include <immintrin.h>
+#define SIMD_IOU_AVX512
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define SIMD_IOU_AVX
+#elif defined(__SSE2__)
+#include <xmmintrin.h>
+#define SIMD_IOU_SSE2
+#endif
+
+#include "utils/nms_engine.h"
+
+// IoU computed per batch_iou call in simd_nms
+#define SIMD_NMS_BATCH (256)
+
+void batch_iou(const Bbox &box,
+               float box_area,
+               const float *xmin,
+               const float *ymin,
+               const float *xmax,
+               const float *ymax,
+               const float *area,
+               int count,
+               float *iou) {
+  int i = 0;
+  // Exact division in every variant, same value as the scalar IoU
+#if defined(SIMD_IOU_AVX512)
+  __m512 bx1 = _mm512_set1_ps(box.xmin), by1 = _mm512_set1_ps(box.ymin);
+  __m512 bx2 = _mm512_set1_ps(box.xmax), by2 = _mm512_set1_ps(box.ymax);
+  __m512 barea = _mm512_set1_ps(box_area), zero = _mm512_setzero_ps();
+  for (; i + 16 <= count; i += 16) {
+    __m512 w = _mm512_sub_ps(_mm512_min_ps(bx2, _mm512_loadu_ps(xmax + i)),
+                             _mm512_max_ps(bx1, _mm512_loadu_ps(xmin + i)));
+    __m512 h = _mm512_sub_ps(_mm512_min_ps(by2, _mm512_loadu_ps(ymax + i)),
+                             _mm512_max_ps(by1, _mm512_loadu_ps(ymin + i)));
+    __m512 inter = _mm512_mul_ps(_mm512_max_ps(w, zero), _mm512_max_ps(h, zero));
+    __m512 sum = _mm512_sub_ps(_mm512_add_ps(_mm512_loadu_ps(area + i), barea),
+                               inter);
+    _mm512_storeu_ps(iou + i, _mm512_div_ps(inter, sum));
+  }
+#elif defined(SIMD_IOU_AVX)
+  __m256 bx1 = _mm256_set1_ps(box.xmin), by1 = _mm256_set1_ps(box.ymin);
+  __m256 bx2 = _mm256_set1_ps(box.xmax), by2 = _mm256_set1_ps(box.ymax);
+  __m256 barea = _mm256_set1_ps(box_area), zero = _mm256_setzero_ps();
+  for (; i + 8 <= count; i += 8) {
+    __m256 w = _mm256_sub_ps(_mm256_min_ps(bx2, _mm256_loadu_ps(xmax + i)),
+                             _mm256_max_ps(bx1, _mm256_loadu_ps(xmin + i)));
+    __m256 h = _mm256_sub_ps(_mm256_min_ps(by2, _mm256_loadu_ps(ymax + i)),
+                             _mm256_max_ps(by1, _mm256_loadu_ps(ymin + i)));
+    __m256 inter = _mm256_mul_ps(_mm256_max_ps(w, zero), _mm256_max_ps(h, zero));
+    __m256 sum = _mm256_sub_ps(_mm256_add_ps(_mm256_loadu_ps(area + i), barea),
+                               inter);
+    _mm256_storeu_ps(iou + i, _mm256_div_ps(inter, sum));
+  }
+#elif defined(SIMD_IOU_SSE2)
+  __m128 bx1 = _mm_set1_ps(box.xmin), by1 = _mm_set1_ps(box.ymin);
+  __m128 bx2 = _mm_set1_ps(box.xmax), by2 = _mm_set1_ps(box.ymax);
+  __m128 barea = _mm_set1_ps(box_area), zero = _mm_setzero_ps();
+  for (; i + 4 <= count; i += 4) {
+    __m128 w = _mm_sub_ps(_mm_min_ps(bx2, _mm_loadu_ps(xmax + i)),
+                          _mm_max_ps(bx1, _mm_loadu_ps(xmin + i)));
+    __m128 h = _mm_sub_ps(_mm_min_ps(by2, _mm_loadu_ps(ymax + i)),
+                          _mm_max_ps(by1, _mm_loadu_ps(ymin + i)));
+    __m128 inter = _mm_mul_ps(_mm_max_ps(w, zero), _mm_max_ps(h, zero));
+    __m128 sum = _mm_sub_ps(_mm_add_ps(_mm_loadu_ps(area + i), barea), inter);
+    _mm_storeu_ps(iou + i, _mm_div_ps(inter, sum));
+  }
+#elif defined(SIMD_IOU_NEON)
+  float32x4_t bx1 = vdupq_n_f32(box.xmin), by1 = vdupq_n_f32(box.ymin);
+  float32x4_t bx2 = vdupq_n_f32(box.xmax), by2 = vdupq_n_f32(box.ymax);
+  float32x4_t barea = vdupq_n_f32(box_area), zero = vdupq_n_f32(0);
+  for (; i + 4 <= count; i += 4) {
+    float32x4_t w = vsubq_f32(vminq_f32(bx2, vld1q_f32(xmax + i)),
+                              vmaxq_f32(bx1, vld1q_f32(xmin + i)));
+    float32x4_t h = vsubq_f32(vminq_f32(by2, vld1q_f32(ymax + i)),
+                              vmaxq_f32(by1, vld1q_f32(ymin + i)));
+    float32x4_t inter = vmulq_f32(vmaxq_f32(w, zero), vmaxq_f32(h, zero));
+    float32x4_t sum = vsubq_f32(vaddq_f32(vld1q_f32(area + i), barea), inter);
+    vst1q_f32(iou + i, vdivq_f32(inter, sum));
+  }
+#endif
+  for (; i < count; i++) {
+    float xx1 = std::max(box.xmin, xmin[i]);
+    float yy1 = std::max(box.ymin, ymin[i]);
+    float xx2 = std::min(box.xmax, xmax[i]);
+    float yy2 = std::min(box.ymax, ymax[i]);
+    if (xx2 > xx1 && yy2 > yy1) {
+      float area_intersection = (xx2 - xx1) * (yy2 - yy1);
+      iou[i] = area_intersection / (area[i] + box_area - area_intersection);
+    } else {
+      iou[i] = 0;
+    }
+  }
+}
+
+int batch_iou_lanes() {
+#if defined(SIMD_IOU_AVX512)
+  return 16;
+#elif defined(SIMD_IOU_AVX)
+  return 8;
+#elif defined(SIMD_IOU_SSE2) || defined(SIMD_IOU_NEON)
+  return 4;
+#else
+  return 1;
+#endif
+}
+
+/**
+ * Greedy NMS inside one class, boxes order by score desc
+ */
+static void class_simd_nms(const BoxArray &boxes,
+                           float iou_threshold,
+                           int top_k,
+                           std::vector<int> &kept) {
+  int n = boxes.Size();
+  std::vector<unsigned char> skip(n, 0);
+  float iou[SIMD_NMS_BATCH];
+
+  int count = 0;
+  for (int i = 0; count < top_k && i < n; i++) {
+    if (skip[i]) {
+      continue;
+    }
+    kept.push_back(boxes.index[i]);
+    count++;
+
+    Bbox box(boxes.xmin[i], boxes.ymin[i], boxes.xmax[i], boxes.ymax[i]);
+    for (int j = i + 1; j < n; j += SIMD_NMS_BATCH) {
+      int batch = std::min(SIMD_NMS_BATCH, n - j);
+      batch_iou(box,
+                boxes.area[i],
+                &boxes.xmin[j],
+                &boxes.ymin[j],
+                &boxes.xmax[j],
+                &boxes.ymax[j],
+                &boxes.area[j],
+                batch,
+                iou);
+      for (int k = 0; k < batch; k++) {
+        skip[j + k] |= iou[k] > iou_threshold;
+      }
+    }
+  }
+}
+
+void simd_nms(const std::vector<Detection> &input,
+              float iou_threshold,
+              int top_k,
+              std::vector<Detection> &result,
+              bool suppress) {
+  int n = input.size();
+  if (n == 0 || top_k <= 0) {
+    return;
+  }
+
+  // Group by class, score desc inside a class, stable on tie
+  std::vector<int> order(n);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(
+      order.begin(), order.end(), [&input, suppress](int a, int b) {
+        if (!suppress && input[a].id != input[b].id) {
+          return input[a].id < input[b].id;
+        }
+        return input[a].score > input[b].score;
+      });
+
+  std::vector<int> kept;
+  BoxArray boxes;
+  boxes.Reserve(n);
+  for (int begin = 0; begin < n;) {
+    int end = begin + 1;
+    while (end < n &&
+           (suppress || input[order[end]].id == input[order[begin]].id)) {
+      end++;
+    }
+
+    boxes.Clear();
+    for (int i = begin; i < end; i++) {
+      boxes.Add(input[order[i]], order[i]);
+    }
+    class_simd_nms(boxes, iou_threshold, top_k, kept);
+    begin = end;
+  }
+
+  std::sort(kept.begin(), kept.end(), [&input](int a, int b) {
+    if (input[a].score != input[b].score) {
+      return input[a].score > input[b].score;
+    }
+    return a < b;
+  });
+  if (kept.size() > static_cast<size_t>(top_k)) {
+    kept.resize(top_k);
+  }
+  result.reserve(result.size() + kept.size());
+  for (int i : kept) {
+    result.push_back(input[i]);
+  }
+}
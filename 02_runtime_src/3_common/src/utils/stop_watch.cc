@@ -12,6 +12,74 @@
 #include <iomanip>
 #include <sstream>
 
+int LatencyHistogram::BucketIndex(u_int64_t value) {
+  const u_int64_t max_value = (1ull << MAX_VALUE_BITS) - 1;
+  value = std::min(value, max_value);
+  if (value < (1ull << SUB_BUCKET_BITS)) {
+    return static_cast<int>(value);
+  }
+  // Keep the SUB_BUCKET_BITS highest bits, the leading one included
+  int msb = 63 - __builtin_clzll(value);
+  int shift = msb - (SUB_BUCKET_BITS - 1);
+  return (shift << (SUB_BUCKET_BITS - 1)) + static_cast<int>(value >> shift);
+}
+
+u_int64_t LatencyHistogram::BucketUpper(int index) {
+  if (index < (1 << SUB_BUCKET_BITS)) {
+    return index;
+  }
+  const int half = 1 << (SUB_BUCKET_BITS - 1);
+  int shift = (index >> (SUB_BUCKET_BITS - 1)) - 1;
+  u_int64_t mantissa = (index & (half - 1)) + half;
+  return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::Record(u_int64_t value) {
+  if (counts_.empty()) {
+    counts_.resize(BUCKET_COUNT, 0);
+  }
+  counts_[BucketIndex(value)]++;
+  count_++;
+  max_ = std::max(max_, value);
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+  if (other.count_ == 0) {
+    return;
+  }
+  if (counts_.empty()) {
+    counts_.resize(BUCKET_COUNT, 0);
+  }
+  for (int i = 0; i < BUCKET_COUNT; i++) {
+    counts_[i] += other.counts_[i];
+  }
+  count_ += other.count_;
+  max_ = std::max(max_, other.max_);
+}
+
+void LatencyHistogram::Reset() {
+  std::fill(counts_.begin(), counts_.end(), 0);
+  count_ = 0;
+  max_ = 0;
+}
+
+u_int64_t LatencyHistogram::Percentile(double percentile) const {
+  if (count_ == 0) {
+    return 0;
+  }
+  // Nearest rank, at least the first record
+  double rank = std::min(std::max(percentile, 0.0), 100.0) / 100.0 * count_;
+  u_int64_t target = std::max<u_int64_t>(static_cast<u_int64_t>(rank + 0.5), 1);
+  u_int64_t seen = 0;
+  for (int i = 0; i < BUCKET_COUNT; i++) {
+    seen += counts_[i];
+    if (seen >= target) {
+      return std::min(BucketUpper(i), max_);
+    }
+  }
+  return max_;
+}
+
 u_int64_t Stopwatch::CurrentTs() {
   return static_cast<uint64_t>(
       std::chrono::duration_cast<std::chrono::microseconds>(
@@ -26,17 +94,41 @@ Stopwatch::Stopwatch()
       total_duration_(0),
       last_duration_(0),
       min_duration_(INT32_MAX),
-      max_duration_(0) {}
+      max_duration_(0),
+      percentiles_({50, 95, 99}) {}
 
 void Stopwatch::Start() { start_ = std::chrono::steady_clock::now(); }
 
 void Stopwatch::Stop() {
   stop_ = std::chrono::steady_clock::now();
-  last_duration_ = std::chrono::duration_cast<Micro>(stop_ - start_);
+  Record(std::chrono::duration_cast<Micro>(stop_ - start_).count());
+}
+
+void Stopwatch::Record(u_int64_t duration) {
+  last_duration_ = Micro(duration);
   total_duration_ += last_duration_;
   min_duration_ = std::min(min_duration_, last_duration_);
   max_duration_ = std::max(max_duration_, last_duration_);
   timing_count_++;
+  if (window_us_ > 0) {
+    RollWindow(CurrentTs());
+  }
+  histogram_.Record(duration);
+}
+
+void Stopwatch::RollWindow(u_int64_t now) {
+  u_int64_t elapsed = now - window_start_;
+  if (elapsed < window_us_) {
+    return;
+  }
+  if (elapsed < 2 * window_us_) {
+    std::swap(previous_histogram_, histogram_);
+  } else {
+    // Idle for more than a window, previous records are stale as well
+    previous_histogram_.Reset();
+  }
+  histogram_.Reset();
+  window_start_ += elapsed / window_us_ * window_us_;
 }
 
 void Stopwatch::Reset() {
@@ -47,6 +139,41 @@ void Stopwatch::Reset() {
   min_duration_ = Micro(INT32_MAX);
   max_duration_ = Micro(0);
   timing_count_ = 0;
+  histogram_.Reset();
+  previous_histogram_.Reset();
+  window_start_ = CurrentTs();
+}
+
+void Stopwatch::Merge(const Stopwatch &other) {
+  if (other.timing_count_ == 0) {
+    return;
+  }
+  total_duration_ += other.total_duration_;
+  min_duration_ = std::min(min_duration_, other.min_duration_);
+  max_duration_ = std::max(max_duration_, other.max_duration_);
+  timing_count_ += other.timing_count_;
+  histogram_.Merge(other.histogram_);
+  previous_histogram_.Merge(other.previous_histogram_);
+}
+
+void Stopwatch::SetPercentiles(const std::vector<double> &percentiles) {
+  percentiles_ = percentiles;
+}
+
+void Stopwatch::SetWindow(u_int64_t window_us) {
+  window_us_ = window_us;
+  window_start_ = CurrentTs();
+  previous_histogram_.Reset();
+}
+
+float Stopwatch::Percentile(double percentile) {
+  if (window_us_ == 0) {
+    return histogram_.Percentile(percentile) / 1000.0;
+  }
+  RollWindow(CurrentTs());
+  LatencyHistogram histogram = previous_histogram_;
+  histogram.Merge(histogram_);
+  return histogram.Percentile(percentile) / 1000.0;
 }
 
 float Stopwatch::Duration() { return total_duration_.count() / 1000.0; }
@@ -76,8 +203,12 @@ std::ostream& operator<<(std::ostream& os, Stopwatch& stop_watch) {
      << ", duration:" << std::setprecision(6) << stop_watch.Duration() << "ms"
      << ", min:" << std::setprecision(6) << stop_watch.Min() << "ms"
      << ", max:" << std::setprecision(6) << stop_watch.Max() << "ms"
-     << ", average:" << std::setprecision(6) << stop_watch.Average() << "ms"
-     << ", fps:" << std::setprecision(6) << stop_watch.Fps() << "/s"
+     << ", average:" << std::setprecision(6) << stop_watch.Average() << "ms";
+  for (double percentile : stop_watch.Percentiles()) {
+    os << ", p" << percentile << ":" << std::setprecision(6)
+       << stop_watch.Percentile(percentile) << "ms";
+  }
+  os << ", fps:" << std::setprecision(6) << stop_watch.Fps() << "/s"
      << std::endl;
   return os;
 }
@@ -10,19 +10,176 @@
 
 #include <memory.h>
 
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 
 #include "glog/logging.h"
 #include "opencv2/core/core.hpp"
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/imgproc.hpp"
+#include "rapidjson/document.h"
 #include "utils/image_utils.h"
+#include "utils/tracer.h"
 #include "utils/utils.h"
 
+BpuMemAllocator default_bpu_mem_allocator() {
+  BpuMemAllocator allocator;
+  allocator.alloc = [](const char *name,
+                       int size,
+                       bool cachable,
+                       BPU_MEMORY_S *mem) {
+    return HB_SYS_bpuMemAlloc(name, size, cachable, mem);
+  };
+  allocator.free = [](BPU_MEMORY_S *mem) { return HB_SYS_bpuMemFree(mem); };
+  return allocator;
+}
+
+TensorPool::TensorPool(BpuMemAllocator allocator, int max_cached)
+    : allocator_(allocator), max_cached_(max_cached) {}
+
+int TensorPool::Acquire(BPU_TENSOR_S *tensor,
+                        int data_size,
+                        int data_ext_size) {
+  Key key{tensor->data_type, tensor->aligned_shape.ndim};
+  for (int i = 0; i < tensor->aligned_shape.ndim; i++) {
+    key.push_back(tensor->aligned_shape.d[i]);
+  }
+  key.push_back(data_size);
+  key.push_back(data_ext_size);
+
+  Buffer buffer{};
+  bool hit = false;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = cached_.find(key);
+    if (it != cached_.end() && !it->second.empty()) {
+      buffer = it->second.back();
+      it->second.pop_back();
+      hit = true;
+      hit_count_++;
+    } else {
+      miss_count_++;
+    }
+  }
+
+  if (!hit) {
+    int ret_code =
+        allocator_.alloc("pool_data0", data_size, true, &buffer.data);
+    if (ret_code != 0) {
+      LOG(ERROR) << "Alloc bpu memory failed, size:" << data_size;
+      return ret_code;
+    }
+    if (data_ext_size > 0) {
+      ret_code = allocator_.alloc(
+          "pool_data1", data_ext_size, true, &buffer.data_ext);
+      if (ret_code != 0) {
+        LOG(ERROR) << "Alloc bpu memory failed, size:" << data_ext_size;
+        allocator_.free(&buffer.data);
+        return ret_code;
+      }
+    }
+  }
+
+  tensor->data = buffer.data;
+  if (data_ext_size > 0) {
+    tensor->data_ext = buffer.data_ext;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  in_use_[buffer.data.virAddr] = key;
+  return 0;
+}
+
+void TensorPool::Recycle(BPU_TENSOR_S *tensor) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  auto it = in_use_.find(tensor->data.virAddr);
+  if (it == in_use_.end()) {
+    lock.unlock();
+    LOG(WARNING) << "Tensor memory is not from pool, free it";
+    allocator_.free(&tensor->data);
+    if (tensor->data_type == BPU_TYPE_IMG_NV12_SEPARATE) {
+      allocator_.free(&tensor->data_ext);
+    }
+    return;
+  }
+
+  Key key = it->second;
+  in_use_.erase(it);
+  Buffer buffer{tensor->data, tensor->data_ext};
+  auto &buffers = cached_[key];
+  if (static_cast<int>(buffers.size()) < max_cached_) {
+    buffers.push_back(buffer);
+    return;
+  }
+  lock.unlock();
+  FreeBuffer(buffer, key);
+}
+
+void TensorPool::FreeBuffer(Buffer &buffer, const Key &key) {
+  allocator_.free(&buffer.data);
+  // Last element of key is data_ext size
+  if (key.back() > 0) {
+    allocator_.free(&buffer.data_ext);
+  }
+}
+
+void TensorPool::Clear() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  for (auto &it : cached_) {
+    for (auto &buffer : it.second) {
+      FreeBuffer(buffer, it.first);
+    }
+  }
+  cached_.clear();
+}
+
+int64_t TensorPool::HitCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return hit_count_;
+}
+
+int64_t TensorPool::MissCount() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return miss_count_;
+}
+
+std::string TensorPool::Statistics() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  size_t cached_count = 0;
+  for (auto &it : cached_) {
+    cached_count += it.second.size();
+  }
+  std::stringstream ss;
+  ss << "hit:" << hit_count_ << ", miss:" << miss_count_
+     << ", in use:" << in_use_.size() << ", cached:" << cached_count;
+  return ss.str();
+}
+
+TensorPool::~TensorPool() {
+  Clear();
+  LOG_IF(WARNING, !in_use_.empty())
+      << in_use_.size() << " pooled tensors are not recycled";
+}
+
+static void alloc_tensor_memory(BPU_TENSOR_S *tensor,
+                                int data_size,
+                                int data_ext_size,
+                                TensorPool *pool) {
+  if (pool != nullptr) {
+    pool->Acquire(tensor, data_size, data_ext_size);
+    return;
+  }
+  HB_SYS_bpuMemAlloc("in_data0", data_size, true, &tensor->data);
+  if (data_ext_size > 0) {
+    HB_SYS_bpuMemAlloc("in_data1", data_ext_size, true, &tensor->data_ext);
+  }
+}
+
 void prepare_image_tensor(int height,
                           int width,
                           hb_BPU_DATA_TYPE_E data_type,
-                          BPU_TENSOR_S *tensor) {
+                          BPU_TENSOR_S *tensor,
+                          TensorPool *pool) {
   BPU_DATA_TYPE_E image_data_type = data_type;
   tensor->data_type = image_data_type;
   int h_idx, w_idx, c_idx;
@@ -38,51 +195,54 @@ void prepare_image_tensor(int height,
   tensor->data_shape.d[w_idx] = width;
   tensor->data_shape.d[c_idx] = 3;
   tensor->aligned_shape = tensor->data_shape;
+  int data_size = 0;
+  int data_ext_size = 0;
   if (image_data_type == BPU_TYPE_IMG_Y) {
     tensor->data_shape.d[c_idx] = 1;
     // Align by 16 bytes
     int stride = ALIGN_16(width);
     tensor->aligned_shape.d[w_idx] = stride;
     tensor->aligned_shape.d[c_idx] = 1;
-    HB_SYS_bpuMemAlloc("in_data0", height * stride, true, &tensor->data);
+    data_size = height * stride;
   } else if (image_data_type == BPU_TYPE_IMG_YUV444 ||
              image_data_type == BPU_TYPE_IMG_BGR ||
              image_data_type == BPU_TYPE_IMG_RGB) {
-    HB_SYS_bpuMemAlloc("in_data0", height * width * 3, true, &tensor->data);
+    data_size = height * width * 3;
   } else if (image_data_type == BPU_TYPE_IMG_YUV_NV12) {
     // Align by 16 bytes
     int stride = ALIGN_16(width);
     int y_length = height * stride;
     int uv_length = height / 2 * stride;
     tensor->aligned_shape.d[w_idx] = stride;
-    HB_SYS_bpuMemAlloc("in_data0", y_length + uv_length, true, &tensor->data);
+    data_size = y_length + uv_length;
   } else if (image_data_type == BPU_TYPE_IMG_NV12_SEPARATE) {
     // Align by 16 bytes
     int stride = ALIGN_16(width);
     int y_length = height * stride;
     int uv_length = height / 2 * stride;
     tensor->aligned_shape.d[w_idx] = stride;
-    HB_SYS_bpuMemAlloc("in_data0", y_length, true, &tensor->data);
-    HB_SYS_bpuMemAlloc("in_data1", uv_length, true, &tensor->data_ext);
+    data_size = y_length;
+    data_ext_size = uv_length;
   } else if (image_data_type == BPU_TYPE_IMG_BGRP ||
              image_data_type == BPU_TYPE_IMG_RGBP) {
-    int planar_length = height * width * 3;
-    HB_SYS_bpuMemAlloc("in_data0", planar_length, true, &tensor->data);
+    data_size = height * width * 3;
   } else if (image_data_type == BPU_TYPE_TENSOR_F32 ||
              image_data_type == BPU_TYPE_TENSOR_S32 ||
              image_data_type == BPU_TYPE_TENSOR_U32) {
-    HB_SYS_bpuMemAlloc("in_data0", height * width * 4, true, &tensor->data);
+    data_size = height * width * 4;
   } else if (image_data_type == BPU_TYPE_TENSOR_U8 ||
              image_data_type == BPU_TYPE_TENSOR_S8) {
-    HB_SYS_bpuMemAlloc("in_data0", height * width, true, &tensor->data);
+    data_size = height * width;
   } else {
     LOG(FATAL) << "Unimplemented for data type:" << image_data_type;
   }
+  alloc_tensor_memory(tensor, data_size, data_ext_size, pool);
 }
 
 void prepare_feature_tensor(std::vector<int> &dims,
                             hb_BPU_DATA_TYPE_E data_type,
-                            BPU_TENSOR_S *tensor) {
+                            BPU_TENSOR_S *tensor,
+                            TensorPool *pool) {
   // make sure the layout is BPU_LAYOUT_NHWC
   tensor->data_shape.layout = BPU_LAYOUT_NHWC;
   tensor->data_type = data_type;
@@ -106,17 +266,106 @@ void prepare_feature_tensor(std::vector<int> &dims,
     default:
       break;
   }
-  HB_SYS_bpuMemAlloc("in_data0", length, true, &tensor->data);
+  alloc_tensor_memory(tensor, length, 0, pool);
+}
+
+int parse_resize_mode(const std::string &name, ResizeMode *mode) {
+  if (name == "stretch") {
+    *mode = ResizeMode::STRETCH;
+  } else if (name == "letterbox") {
+    *mode = ResizeMode::LETTERBOX;
+  } else {
+    LOG(ERROR) << "Unknown resize mode:" << name;
+    return -1;
+  }
+  return 0;
+}
+
+int parse_color_mode(const std::string &name, ColorMode *mode) {
+  if (name == "bgr") {
+    *mode = ColorMode::BGR;
+  } else if (name == "gray") {
+    *mode = ColorMode::GRAY;
+  } else if (name == "raw16") {
+    *mode = ColorMode::RAW16;
+  } else {
+    LOG(ERROR) << "Unknown color mode:" << name;
+    return -1;
+  }
+  return 0;
+}
+
+int parse_color_modes(const std::string &config_string,
+                      std::vector<ColorMode> *modes) {
+  rapidjson::Document document;
+  document.Parse(config_string.data());
+  if (!document.IsObject() || !document.HasMember("color_modes")) {
+    return 0;
+  }
+
+  auto &color_modes = document["color_modes"];
+  if (!color_modes.IsArray()) {
+    LOG(ERROR) << "color_modes should be an array of color mode names";
+    return -1;
+  }
+  modes->resize(color_modes.Size());
+  for (int i = 0; i < static_cast<int>(color_modes.Size()); i++) {
+    if (!color_modes[i].IsString()) {
+      LOG(ERROR) << "color_modes[" << i << "] should be a string";
+      return -1;
+    }
+    if (parse_color_mode(color_modes[i].GetString(), &(*modes)[i]) != 0) {
+      return -1;
+    }
+  }
+  return 0;
 }
 
-int read_image_tensor(std::string &path,
+int read_image_tensor(const std::string &path,
                       int &ori_width,
                       int &ori_height,
-                      BPU_TENSOR_S *tensor) {
-  cv::Mat bgr_mat = cv::imread(path);
-  ori_width = bgr_mat.cols;
-  ori_height = bgr_mat.rows;
+                      BPU_TENSOR_S *tensor,
+                      ResizeMode resize_mode,
+                      ColorMode color_mode) {
+  int flags = cv::IMREAD_COLOR;
+  if (color_mode == ColorMode::GRAY) {
+    flags = cv::IMREAD_GRAYSCALE;
+  } else if (color_mode == ColorMode::RAW16) {
+    flags = cv::IMREAD_ANYDEPTH;
+  }
+  cv::Mat mat = cv::imread(path, flags);
+  if (mat.empty()) {
+    LOG(ERROR) << "Read image failed, path: " << path;
+    return -1;
+  }
+  ori_width = mat.cols;
+  ori_height = mat.rows;
+  return mat_to_tensor(mat, tensor, resize_mode, color_mode);
+}
+
+int mat_to_tensor(cv::Mat &mat,
+                  BPU_TENSOR_S *tensor,
+                  ResizeMode resize_mode,
+                  ColorMode color_mode) {
+  if (color_mode == ColorMode::BGR) {
+    return bgr_mat_to_tensor(mat, tensor, resize_mode);
+  }
+
+  cv::Mat gray_mat = mat;
+  if (gray_mat.channels() == 3) {
+    cv::cvtColor(mat, gray_mat, cv::COLOR_BGR2GRAY);
+  }
+  if (gray_mat.depth() != CV_8U) {
+    cv::Mat raw_mat = gray_mat;
+    cv::normalize(raw_mat, gray_mat, 0, 255, cv::NORM_MINMAX, CV_8U);
+  }
+  return gray_mat_to_tensor(gray_mat, tensor, resize_mode);
+}
 
+int bgr_mat_to_tensor(cv::Mat &bgr_mat,
+                      BPU_TENSOR_S *tensor,
+                      ResizeMode resize_mode) {
+  TraceSpan span("preprocess");
   auto data_type = tensor->data_type;
   int h_idx, w_idx, c_idx;
   HB_BPU_getHWCIndex(tensor->data_type, nullptr, &h_idx, &w_idx, &c_idx);
@@ -125,8 +374,54 @@ int read_image_tensor(std::string &path,
   auto width = tensor->data_shape.d[w_idx];
   auto stride = tensor->aligned_shape.d[w_idx];
 
-  cv::Mat resized_mat(height, width, bgr_mat.type());
-  cv::resize(bgr_mat, resized_mat, resized_mat.size(), 0, 0);
+  // NV12 is resized & converted straight into tensor memory
+  if (data_type == BPU_TYPE_IMG_YUV_NV12 ||
+      data_type == BPU_TYPE_IMG_NV12_SEPARATE) {
+    uint8_t *y = reinterpret_cast<uint8_t *>(tensor->data.virAddr);
+    uint8_t *uv = data_type == BPU_TYPE_IMG_YUV_NV12
+                      ? y + height * stride
+                      : reinterpret_cast<uint8_t *>(tensor->data_ext.virAddr);
+    if (resize_mode == ResizeMode::LETTERBOX) {
+      letterbox_bgr_to_nv12(bgr_mat.ptr<uint8_t>(),
+                            bgr_mat.cols,
+                            bgr_mat.rows,
+                            bgr_mat.step,
+                            width,
+                            height,
+                            LETTERBOX_PAD_VALUE,
+                            y,
+                            stride,
+                            uv,
+                            stride);
+    } else {
+      resize_bgr_to_nv12(bgr_mat.ptr<uint8_t>(),
+                         bgr_mat.cols,
+                         bgr_mat.rows,
+                         bgr_mat.step,
+                         width,
+                         height,
+                         y,
+                         stride,
+                         uv,
+                         stride);
+    }
+    return 0;
+  }
+
+  cv::Mat resized_mat;
+  if (resize_mode == ResizeMode::LETTERBOX) {
+    resized_mat = cv::Mat(height,
+                          width,
+                          bgr_mat.type(),
+                          cv::Scalar::all(LETTERBOX_PAD_VALUE));
+    cv::Rect roi = letterbox_rect(bgr_mat.cols, bgr_mat.rows, width, height);
+    // Resize into the center region of the padded image
+    cv::Mat roi_mat = resized_mat(roi);
+    cv::resize(bgr_mat, roi_mat, roi.size(), 0, 0);
+  } else {
+    resized_mat = cv::Mat(height, width, bgr_mat.type());
+    cv::resize(bgr_mat, resized_mat, resized_mat.size(), 0, 0);
+  }
   if (data_type == BPU_TYPE_IMG_Y) {
     cv::Mat gray;
     cv::cvtColor(resized_mat, gray, cv::COLOR_BGR2GRAY);
@@ -138,39 +433,6 @@ int read_image_tensor(std::string &path,
         *raw++ = *data++;
       }
     }
-  } else if (data_type == BPU_TYPE_IMG_YUV_NV12) {
-    cv::Mat nv12;
-    bgr_to_nv12(resized_mat, nv12);
-    uint8_t *data = nv12.data;
-
-    // Copy y data to data0
-    uint8_t *y = reinterpret_cast<uint8_t *>(tensor->data.virAddr);
-    for (int h = 0; h < height; ++h) {
-      auto *raw = y + h * stride;
-      for (int w = 0; w < width; ++w) {
-        *raw++ = *data++;
-      }
-    }
-    // Copy uv data to data1
-    uint8_t *uv =
-        reinterpret_cast<uint8_t *>(tensor->data.virAddr) + height * stride;
-    memcpy(uv, nv12.data + height * width, height * width / 2);
-  } else if (data_type == BPU_TYPE_IMG_NV12_SEPARATE) {
-    cv::Mat nv12;
-    bgr_to_nv12(resized_mat, nv12);
-    uint8_t *data = nv12.data;
-
-    // Copy y data to data0
-    uint8_t *y = reinterpret_cast<uint8_t *>(tensor->data.virAddr);
-    for (int h = 0; h < height; ++h) {
-      auto *raw = y + h * stride;
-      for (int w = 0; w < width; ++w) {
-        *raw++ = *data++;
-      }
-    }
-    // Copy uv data to data1
-    uint8_t *uv = reinterpret_cast<uint8_t *>(tensor->data_ext.virAddr);
-    memcpy(uv, nv12.data + height * width, height * width / 2);
   } else if (data_type == BPU_TYPE_IMG_YUV444) {
     cv::Mat yuv_mat;
     cv::cvtColor(resized_mat, yuv_mat, cv::COLOR_BGR2YUV);
@@ -211,7 +473,86 @@ int read_image_tensor(std::string &path,
   return 0;
 }
 
+int gray_mat_to_tensor(cv::Mat &gray_mat,
+                       BPU_TENSOR_S *tensor,
+                       ResizeMode resize_mode) {
+  TraceSpan span("preprocess");
+  auto data_type = tensor->data_type;
+  if (data_type != BPU_TYPE_IMG_Y && data_type != BPU_TYPE_IMG_YUV_NV12 &&
+      data_type != BPU_TYPE_IMG_NV12_SEPARATE) {
+    cv::Mat bgr_mat;
+    cv::cvtColor(gray_mat, bgr_mat, cv::COLOR_GRAY2BGR);
+    return bgr_mat_to_tensor(bgr_mat, tensor, resize_mode);
+  }
+
+  int h_idx, w_idx, c_idx;
+  HB_BPU_getHWCIndex(data_type, nullptr, &h_idx, &w_idx, &c_idx);
+  auto height = tensor->data_shape.d[h_idx];
+  auto width = tensor->data_shape.d[w_idx];
+  auto stride = tensor->aligned_shape.d[w_idx];
+
+  cv::Rect roi(0, 0, width, height);
+  if (resize_mode == ResizeMode::LETTERBOX) {
+    roi = letterbox_rect(gray_mat.cols, gray_mat.rows, width, height);
+  }
+
+  // Resize straight into the Y plane
+  uint8_t *y = reinterpret_cast<uint8_t *>(tensor->data.virAddr);
+  cv::Mat y_mat(height, width, CV_8UC1, y, stride);
+  cv::Mat roi_mat = y_mat(roi);
+  if (data_type == BPU_TYPE_IMG_Y) {
+    if (roi.width != width || roi.height != height) {
+      y_mat.setTo(cv::Scalar::all(LETTERBOX_PAD_VALUE));
+    }
+    cv::resize(gray_mat, roi_mat, roi.size(), 0, 0);
+    return 0;
+  }
+
+  // Luma of the equivalent BGR pixel, chroma of a gray pixel is 128
+  static const cv::Mat luma_lut = [] {
+    cv::Mat lut(1, 256, CV_8UC1);
+    for (int i = 0; i < 256; i++) {
+      lut.ptr<uint8_t>()[i] = bgr_to_luma(i, i, i);
+    }
+    return lut;
+  }();
+  if (roi.width != width || roi.height != height) {
+    y_mat.setTo(cv::Scalar::all(luma_lut.ptr<uint8_t>()[LETTERBOX_PAD_VALUE]));
+  }
+  cv::resize(gray_mat, roi_mat, roi.size(), 0, 0);
+  cv::LUT(roi_mat, luma_lut, roi_mat);
+
+  uint8_t *uv = data_type == BPU_TYPE_IMG_YUV_NV12
+                    ? y + height * stride
+                    : reinterpret_cast<uint8_t *>(tensor->data_ext.virAddr);
+  for (int h = 0; h < height / 2; h++) {
+    memset(uv + h * stride, 128, width);
+  }
+  return 0;
+}
+
+int copy_to_tensor(const void *data, uint64_t size, BPU_TENSOR_S *tensor) {
+  uint64_t data_size = tensor->data.memSize;
+  uint64_t data_ext_size = tensor->data_type == BPU_TYPE_IMG_NV12_SEPARATE
+                               ? tensor->data_ext.memSize
+                               : 0;
+  if (size > data_size + data_ext_size) {
+    LOG(ERROR) << "Data size " << size << " is larger than tensor size "
+               << data_size + data_ext_size;
+    return -1;
+  }
+  uint64_t head_size = std::min(size, data_size);
+  memcpy(tensor->data.virAddr, data, head_size);
+  if (size > head_size) {
+    memcpy(tensor->data_ext.virAddr,
+           static_cast<const uint8_t *>(data) + head_size,
+           size - head_size);
+  }
+  return 0;
+}
+
 void flush_tensor(BPU_TENSOR_S *tensor) {
+  TraceSpan span("flush");
   switch (tensor->data_type) {
     case BPU_TYPE_IMG_BGRP:
     case BPU_TYPE_IMG_RGBP:
@@ -236,7 +577,11 @@ void flush_tensor(BPU_TENSOR_S *tensor) {
   }
 }
 
-void release_tensor(BPU_TENSOR_S *tensor) {
+void release_tensor(BPU_TENSOR_S *tensor, TensorPool *pool) {
+  if (pool != nullptr) {
+    pool->Recycle(tensor);
+    return;
+  }
   switch (tensor->data_type) {
     case BPU_TYPE_IMG_BGRP:
     case BPU_TYPE_IMG_RGBP:
@@ -262,7 +607,8 @@ void release_tensor(BPU_TENSOR_S *tensor) {
 }
 
 void prepare_output_tensor(std::vector<BPU_TENSOR_S> &output,
-                           BPU_MODEL_S *model) {
+                           BPU_MODEL_S *model,
+                           TensorPool *pool) {
   int out_num = model->output_num;
   output.resize(out_num);
   std::string name_prefix("out_mem");
@@ -279,13 +625,22 @@ void prepare_output_tensor(std::vector<BPU_TENSOR_S> &output,
     output[i].aligned_shape = out_node.aligned_shape;
     output[i].data_type = out_node.data_type;
     // TODO(@horizon.ai): shifts data for tensor (only need by quanti model)
+    if (pool != nullptr) {
+      pool->Acquire(&output[i], out_aligned_size);
+      continue;
+    }
     auto &tensor_data = output[i].data;
     HB_SYS_bpuMemAlloc(mem_name.data(), out_aligned_size, true, &tensor_data);
   }
 }
 
-void release_output_tensor(std::vector<BPU_TENSOR_S> &output) {
+void release_output_tensor(std::vector<BPU_TENSOR_S> &output,
+                           TensorPool *pool) {
   for (auto tensor : output) {
+    if (pool != nullptr) {
+      pool->Recycle(&tensor);
+      continue;
+    }
     HB_SYS_bpuMemFree(&(tensor.data));
   }
 }
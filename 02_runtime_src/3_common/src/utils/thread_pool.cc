@@ -0,0 +1,102 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "utils/thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+ThreadPool::ThreadPool(int thread_num) {
+  for (int i = 0; i < thread_num; i++) {
+    threads_.emplace_back(&ThreadPool::WorkLoop, this);
+  }
+}
+
+void ThreadPool::Submit(std::function<void()> task) {
+  if (threads_.empty()) {
+    task();
+    return;
+  }
+  std::lock_guard<std::mutex> lock(mutex_);
+  tasks_.push_back(std::move(task));
+  cv_.notify_one();
+}
+
+void ThreadPool::WorkLoop() {
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stop_ || !tasks_.empty(); });
+      if (tasks_.empty()) {
+        return;
+      }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+
+namespace {
+struct ParallelForState {
+  explicit ParallelForState(int count) : count(count) {}
+  const int count;
+  std::atomic<int> next{0};
+  int done = 0;
+  std::mutex mutex;
+  std::condition_variable cv;
+};
+}  // namespace
+
+void ThreadPool::ParallelFor(int count, const std::function<void(int)> &func) {
+  if (count <= 0) {
+    return;
+  }
+
+  // Helpers may start after the call returned, the state outlives the call
+  // and a late helper just finds no index left
+  auto state = std::make_shared<ParallelForState>(count);
+  auto run = [state, &func]() {
+    int finished = 0;
+    for (int i = state->next++; i < state->count; i = state->next++) {
+      func(i);
+      finished++;
+    }
+    if (finished > 0) {
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->done += finished;
+      if (state->done == state->count) {
+        state->cv.notify_all();
+      }
+    }
+  };
+
+  int helper_num = std::min(count - 1, ThreadNum());
+  for (int i = 0; i < helper_num; i++) {
+    // func is only touched while an index is left, which implies the caller
+    // is still waiting
+    Submit(run);
+  }
+  run();
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->cv.wait(lock, [&state] { return state->done == state->count; });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+    cv_.notify_all();
+  }
+  for (auto &t : threads_) {
+    t.join();
+  }
+}
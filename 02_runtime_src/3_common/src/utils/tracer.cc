@@ -0,0 +1,140 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "utils/tracer.h"
+
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+
+#include "glog/logging.h"
+
+static thread_local TraceRing *thread_ring = nullptr;
+static thread_local int64_t current_frame = -1;
+// Kept until the ring is created by the first span of the thread
+static thread_local std::string thread_name;
+
+void TraceRing::Snapshot(std::vector<TraceEvent> *events) {
+  u_int64_t capacity = slots_.size();
+  u_int64_t head = head_.load(std::memory_order_acquire);
+  u_int64_t begin = head > capacity ? head - capacity : 0;
+  std::vector<TraceEvent> copied;
+  copied.reserve(head - begin);
+  for (u_int64_t i = begin; i < head; i++) {
+    Slot &slot = slots_[i % capacity];
+    copied.push_back({slot.name.load(std::memory_order_relaxed),
+                      slot.frame_id.load(std::memory_order_relaxed),
+                      slot.start_ts.load(std::memory_order_relaxed),
+                      slot.end_ts.load(std::memory_order_relaxed)});
+  }
+
+  // Span `index` is overwritten while span `index + capacity` is pushed,
+  // which may have started as soon as the head reached `index + capacity`
+  std::atomic_thread_fence(std::memory_order_acquire);
+  u_int64_t new_head = head_.load(std::memory_order_relaxed);
+  u_int64_t valid_begin = new_head >= capacity ? new_head - capacity + 1 : 0;
+  for (u_int64_t i = std::max(begin, valid_begin); i < head; i++) {
+    events->push_back(copied[i - begin]);
+  }
+}
+
+Tracer *Tracer::Instance() {
+  static Tracer tracer;
+  return &tracer;
+}
+
+void Tracer::Enable(int capacity) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    capacity_ = capacity;
+  }
+  enabled_.store(true, std::memory_order_relaxed);
+}
+
+TraceRing *Tracer::ThreadRing() {
+  if (thread_ring == nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    rings_.emplace_back(new TraceRing(rings_.size() + 1, capacity_));
+    thread_ring = rings_.back().get();
+    thread_ring->SetThreadName(thread_name);
+  }
+  return thread_ring;
+}
+
+void Tracer::SetThreadName(const std::string &name) {
+  thread_name = name;
+  if (thread_ring != nullptr) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    thread_ring->SetThreadName(name);
+  }
+}
+
+void Tracer::SetCurrentFrame(int64_t frame_id) { current_frame = frame_id; }
+
+int64_t Tracer::CurrentFrame() { return current_frame; }
+
+void Tracer::Record(const char *name,
+                    int64_t frame_id,
+                    u_int64_t start_ts,
+                    u_int64_t end_ts) {
+  if (!IsEnabled()) {
+    return;
+  }
+  ThreadRing()->Push({name, frame_id, start_ts, end_ts});
+}
+
+std::string Tracer::ToJson() {
+  std::stringstream ss;
+  int pid = getpid();
+  bool first = true;
+  auto separator = [&first, &ss]() {
+    ss << (first ? "\n" : ",\n");
+    first = false;
+  };
+
+  ss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+  std::lock_guard<std::mutex> lock(mutex_);
+  std::vector<TraceEvent> events;
+  for (auto &ring : rings_) {
+    if (!ring->ThreadName().empty()) {
+      separator();
+      ss << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid
+         << ",\"tid\":" << ring->Tid() << ",\"args\":{\"name\":\""
+         << ring->ThreadName() << "\"}}";
+    }
+
+    events.clear();
+    ring->Snapshot(&events);
+    for (auto &event : events) {
+      separator();
+      ss << "{\"name\":\"" << event.name << "\",\"cat\":\"pipeline\""
+         << ",\"ph\":\"X\",\"pid\":" << pid << ",\"tid\":" << ring->Tid()
+         << ",\"ts\":" << event.start_ts
+         << ",\"dur\":" << event.end_ts - event.start_ts
+         << ",\"args\":{\"frame_id\":" << event.frame_id << "}}";
+    }
+  }
+  ss << "\n]}\n";
+  return ss.str();
+}
+
+int Tracer::Dump(const std::string &path) {
+  std::ofstream ofs(path);
+  if (!ofs.is_open()) {
+    LOG(ERROR) << "Open " << path << " failed";
+    return -1;
+  }
+  ofs << ToJson();
+  if (!ofs.good()) {
+    LOG(ERROR) << "Write trace " << path << " failed";
+    return -1;
+  }
+  LOG(INFO) << "Trace is written to " << path;
+  return 0;
+}
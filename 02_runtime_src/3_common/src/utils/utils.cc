@@ -154,7 +154,7 @@ std::string layout_type_enum_to_string(BPU_LAYOUT_E layout) {
   }
 }
 
-std::string get_file_name(std::string &path) {
+std::string get_file_name(const std::string &path) {
   int slash_pos = path.rfind('/');
   return path.substr(slash_pos + 1);
 }
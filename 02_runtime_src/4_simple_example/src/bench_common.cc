@@ -0,0 +1,548 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Micro-benchmarks of 3_common kernels on synthetic data: nms, post process
+// decode of every model, image conversion, drawing and client serialization.
+// Every case is named "<kernel>/<parameters>", runs `warmup` untimed samples
+// and `iterations` timed samples. Fast kernels are repeated within a sample
+// until it takes `min_sample_us`, reported times are per call. With
+// --json_file the results are written as
+//   {"context": {...}, "benchmarks": [{"name": ..., "p50_ms": ...}, ...]}
+// to track regressions across releases.
+
+#include <unistd.h>
+
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <vector>
+
+#include "base/perception_common.h"
+#include "bench_utils.h"
+#include "bpu_predict_extension.h"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "opencv2/opencv.hpp"
+#include "output/client_output.h"
+#include "post_process/post_process.h"
+#include "post_process/yolo5_decode.h"
+#include "utils/image_utils.h"
+#include "utils/nms.h"
+#include "utils/tensor_utils.h"
+#include "utils/utils.h"
+
+#define EMPTY ""
+
+DEFINE_string(filter, EMPTY, "Run cases whose name contains it, all if empty");
+DEFINE_bool(list, false, "List case names and exit");
+DEFINE_int32(iterations, 100, "Timed samples of every case");
+DEFINE_int32(warmup, 5, "Untimed samples before timing");
+DEFINE_int32(min_sample_us,
+             200,
+             "Repeat fast kernels within a sample until it takes this long");
+DEFINE_string(json_file, EMPTY, "Write results as json to this file");
+DEFINE_string(candidate_nums,
+              "100,1000,10000",
+              "NMS candidate counts, separated by comma");
+DEFINE_string(resolutions,
+              "640x384,1280x720,1920x1080",
+              "Image sizes (WIDTHxHEIGHT) of image kernels");
+DEFINE_string(post_process_models,
+              "yolov2,yolov3,yolov5,yolov5_mutil_modal,ssd,s3fd,fasterrcnn,"
+              "rfcn,classification,segment",
+              "Post process modules, see PostProcessModule::GetImpl");
+DEFINE_int32(detection_num, 50, "Detections drawn and serialized");
+
+// Returns the timed body, inputs are built only if the case is selected
+typedef std::function<std::function<void()>()> CaseSetup;
+
+struct BenchmarkCase {
+  std::string name;
+  // Items processed per call (candidates, pixels), 0 if not meaningful
+  int64_t items;
+  CaseSetup setup;
+};
+
+static std::vector<int> parse_ints(std::string str) {
+  std::vector<std::string> items;
+  split(str, ',', items);
+  std::vector<int> values;
+  for (auto &item : items) {
+    values.push_back(std::stoi(item));
+  }
+  return values;
+}
+
+static std::vector<std::pair<int, int>> parse_resolutions(std::string str) {
+  std::vector<std::string> items;
+  split(str, ',', items);
+  std::vector<std::pair<int, int>> resolutions;
+  for (auto &item : items) {
+    auto pos = item.find('x');
+    LOG_IF(FATAL, pos == std::string::npos) << "Invalid resolution:" << item;
+    resolutions.emplace_back(std::stoi(item.substr(0, pos)),
+                             std::stoi(item.substr(pos + 1)));
+  }
+  return resolutions;
+}
+
+/**
+ * Gradient BGR image, so resize & color conversion see varying pixels
+ */
+static cv::Mat synthetic_bgr(int width, int height) {
+  cv::Mat bgr(height, width, CV_8UC3);
+  for (int h = 0; h < height; h++) {
+    uint8_t *row = bgr.ptr<uint8_t>(h);
+    for (int w = 0; w < width; w++) {
+      row[w * 3] = static_cast<uint8_t>(w);
+      row[w * 3 + 1] = static_cast<uint8_t>(h);
+      row[w * 3 + 2] = static_cast<uint8_t>(w + h);
+    }
+  }
+  return bgr;
+}
+
+/**
+ * NV12 image tensor of the given size with a BGR frame converted into it
+ */
+static std::shared_ptr<ImageTensor> synthetic_image_tensor(int width,
+                                                           int height) {
+  std::shared_ptr<ImageTensor> image_tensor(new ImageTensor,
+                                            [](ImageTensor *image_tensor) {
+                                              release_tensor(
+                                                  &image_tensor->tensor,
+                                                  nullptr);
+                                              delete image_tensor;
+                                            });
+  prepare_image_tensor(
+      height, width, BPU_TYPE_IMG_YUV_NV12, &image_tensor->tensor, nullptr);
+  cv::Mat bgr = synthetic_bgr(width, height);
+  bgr_mat_to_tensor(bgr, &image_tensor->tensor, ResizeMode::STRETCH);
+  image_tensor->ori_image_width = width;
+  image_tensor->ori_image_height = height;
+  image_tensor->image_name = "synthetic";
+  return image_tensor;
+}
+
+static Perception synthetic_perception(int num, int width, int height) {
+  static const char *class_names[] = {"cyclist", "person", "people"};
+  std::mt19937 rng(0);
+  std::vector<Detection> candidates;
+  generate_candidates(num, width, height, 3, rng, candidates);
+  Perception perception;
+  perception.type = Perception::DET;
+  for (auto &det : candidates) {
+    det.class_name = class_names[det.id];
+    perception.det.push_back(det);
+  }
+  return perception;
+}
+
+/**
+ * Synthetic model outputs of a post process module
+ */
+struct SyntheticModel {
+  int input_width;
+  int input_height;
+  // NHWC dims of every output
+  std::vector<std::vector<int>> outputs;
+  // Fill output i, count is the float count
+  std::function<void(int i, float *data, int count, std::mt19937 &rng)> fill;
+};
+
+static void fill_normal(float *data, int count, std::mt19937 &rng) {
+  std::normal_distribution<float> value(0.0f, 1.5f);
+  for (int i = 0; i < count; i++) {
+    data[i] = value(rng);
+  }
+}
+
+static std::vector<std::vector<int>> yolo_outputs(int input_size,
+                                                  std::vector<int> strides,
+                                                  int channel) {
+  std::vector<std::vector<int>> outputs;
+  for (int stride : strides) {
+    outputs.push_back(
+        {1, input_size / stride, input_size / stride, channel});
+  }
+  return outputs;
+}
+
+/**
+ * Output layout of every model with the default config of its module
+ * @param[in] model_name: model name of PostProcessModule::GetImpl
+ * @param[out] model: synthetic model
+ * @return 0 if success
+ */
+static int synthetic_model(const std::string &model_name,
+                           SyntheticModel *model) {
+  using std::placeholders::_2;
+  using std::placeholders::_3;
+  using std::placeholders::_4;
+  if (model_name == "yolov2") {
+    // 5 anchors, 80 classes, stride 32
+    int num_pred = 80 + 5;
+    model->input_width = model->input_height = 416;
+    model->outputs = yolo_outputs(416, {32}, 5 * num_pred);
+    model->fill = std::bind(fill_yolo_head, num_pred, 0.005f, _2, _3, _4);
+  } else if (model_name == "yolov3") {
+    // 3 anchors per layer, 10 classes
+    int num_pred = 10 + 5;
+    model->input_width = model->input_height = 416;
+    model->outputs = yolo_outputs(416, {32, 16, 8}, 3 * num_pred);
+    model->fill = std::bind(fill_yolo_head, num_pred, 0.005f, _2, _3, _4);
+  } else if (model_name == "yolov5" || model_name == "yolov5_mutil_modal") {
+    // 3 anchors per layer, 3 classes, visible & lwir heads if mutil modal
+    int num_pred = 3 + 5;
+    model->input_width = model->input_height = 672;
+    model->outputs = yolo_outputs(672, {8, 16, 32}, 3 * num_pred);
+    if (model_name == "yolov5_mutil_modal") {
+      auto lwir_outputs = model->outputs;
+      model->outputs.insert(
+          model->outputs.end(), lwir_outputs.begin(), lwir_outputs.end());
+    }
+    model->fill = std::bind(fill_yolo_head, num_pred, 0.005f, _2, _3, _4);
+  } else if (model_name == "ssd") {
+    // (box, class) per layer, 4 or 6 anchors per pixel, 20 classes + 1
+    model->input_width = model->input_height = 300;
+    std::vector<int> sizes{38, 19, 10, 5, 3, 1};
+    std::vector<int> anchor_nums{4, 6, 6, 6, 4, 4};
+    for (size_t i = 0; i < sizes.size(); i++) {
+      model->outputs.push_back({1, sizes[i], sizes[i], 4 * anchor_nums[i]});
+      model->outputs.push_back({1, sizes[i], sizes[i], 21 * anchor_nums[i]});
+    }
+    model->fill = std::bind(fill_normal, _2, _3, _4);
+  } else if (model_name == "s3fd") {
+    // (box, face/background) per layer, steps 4 to 128
+    model->input_width = model->input_height = 640;
+    for (int step = 4; step <= 128; step *= 2) {
+      model->outputs.push_back({1, 640 / step, 640 / step, 4});
+      model->outputs.push_back({1, 640 / step, 640 / step, 2});
+    }
+    model->fill = std::bind(fill_normal, _2, _3, _4);
+  } else if (model_name == "fasterrcnn" || model_name == "rfcn") {
+    // Rows of (score, id, x1, y1, x2, y2) by descending score, 20 classes
+    model->input_width = 1000;
+    model->input_height = 600;
+    model->outputs.push_back({1, 300, 1, 6});
+    model->fill = [](int i, float *data, int count, std::mt19937 &rng) {
+      std::uniform_int_distribution<int> id_dist(0, 19);
+      std::uniform_real_distribution<float> x_dist(0, 900);
+      std::uniform_real_distribution<float> y_dist(0, 500);
+      int row_num = count / 6;
+      for (int row = 0; row < row_num; row++) {
+        float *cur = data + row * 6;
+        float x = x_dist(rng), y = y_dist(rng);
+        cur[0] = 1.0f - static_cast<float>(row) / row_num;
+        cur[1] = id_dist(rng);
+        cur[2] = x;
+        cur[3] = y;
+        cur[4] = x + 100;
+        cur[5] = y + 100;
+      }
+    };
+  } else if (model_name == "classification") {
+    // 1000 classes
+    model->input_width = model->input_height = 224;
+    model->outputs.push_back({1, 1000, 1, 1});
+    model->fill = std::bind(fill_normal, _2, _3, _4);
+  } else if (model_name == "segment") {
+    // Class id per pixel, resized to the original image
+    model->input_width = 1024;
+    model->input_height = 512;
+    model->outputs.push_back({1, 512, 1024, 1});
+    model->fill = [](int i, float *data, int count, std::mt19937 &rng) {
+      std::uniform_int_distribution<int> id_dist(0, 18);
+      for (int k = 0; k < count; k++) {
+        data[k] = id_dist(rng);
+      }
+    };
+  } else {
+    LOG(ERROR) << "No synthetic outputs for model:" << model_name;
+    return -1;
+  }
+  return 0;
+}
+
+static CaseSetup post_process_case(const std::string &model_name) {
+  return [model_name]() -> std::function<void()> {
+    SyntheticModel model;
+    LOG_IF(FATAL, synthetic_model(model_name, &model) != 0);
+    std::shared_ptr<PostProcessModule> module(
+        PostProcessModule::GetImpl(model_name));
+    LOG_IF(FATAL, module == nullptr || module->Init("", "") != 0)
+        << "Init post process module " << model_name << " failed";
+
+    auto image_tensor =
+        synthetic_image_tensor(model.input_width, model.input_height);
+    image_tensor->ori_image_width = 1280;
+    image_tensor->ori_image_height = 720;
+
+    std::shared_ptr<std::vector<BPU_TENSOR_S>> outputs(
+        new std::vector<BPU_TENSOR_S>(model.outputs.size()),
+        [](std::vector<BPU_TENSOR_S> *outputs) {
+          for (auto &tensor : *outputs) {
+            release_tensor(&tensor, nullptr);
+          }
+          delete outputs;
+        });
+    std::mt19937 rng(0);
+    for (size_t i = 0; i < model.outputs.size(); i++) {
+      auto &tensor = (*outputs)[i];
+      prepare_feature_tensor(
+          model.outputs[i], BPU_TYPE_TENSOR_F32, &tensor, nullptr);
+      model.fill(i,
+                 reinterpret_cast<float *>(tensor.data.virAddr),
+                 tensor.data.memSize / sizeof(float),
+                 rng);
+      flush_tensor(&tensor);
+    }
+
+    return [module, image_tensor, outputs]() {
+      Perception perception;
+      module->PostProcess(outputs->data(), image_tensor.get(), &perception);
+    };
+  };
+}
+
+/**
+ * Serialization part of ClientOutputModule::Write, which also converts the
+ * image and needs a connected sender
+ */
+class ClientOutputBenchmark {
+ public:
+  static int Serialize(ClientOutputModule *output,
+                       ImageTensor *image_tensor,
+                       Perception *perception,
+                       char **pb,
+                       int *pb_length) {
+    return output->Serialize(image_tensor, perception, pb, pb_length);
+  }
+};
+
+static std::vector<BenchmarkCase> benchmark_cases() {
+  std::vector<BenchmarkCase> cases;
+
+  // The candidates are copied in every call, nms sorts its input in place
+  std::vector<std::pair<std::string, NmsImpl>> nms_impls{
+      {"default", NmsImpl::DEFAULT},
+      {"grid", NmsImpl::GRID},
+      {"simd", NmsImpl::SIMD}};
+  for (int num : parse_ints(FLAGS_candidate_nums)) {
+    auto candidates = [num]() {
+      std::mt19937 rng(0);
+      std::shared_ptr<std::vector<Detection>> dets(new std::vector<Detection>);
+      generate_candidates(num, 640, 512, 3, rng, *dets);
+      return dets;
+    };
+    std::string suffix = "/" + std::to_string(num);
+    cases.push_back({"nms" + suffix, num, [candidates]() {
+                       auto dets = candidates();
+                       return [dets]() {
+                         std::vector<Detection> input = *dets;
+                         std::vector<Detection> result;
+                         nms(input, 0.45, 5000, result, false);
+                       };
+                     }});
+    for (auto &impl : nms_impls) {
+      NmsImpl nms_impl = impl.second;
+      cases.push_back(
+          {"yolo5_nms/" + impl.first + suffix, num, [candidates, nms_impl]() {
+             auto dets = candidates();
+             return [dets, nms_impl]() {
+               std::vector<Detection> input = *dets;
+               std::vector<Detection> result;
+               run_nms(nms_impl, input, 0.45, 5000, result, false);
+             };
+           }});
+    }
+  }
+
+  std::vector<std::string> models;
+  split(FLAGS_post_process_models, ',', models);
+  for (auto &model_name : models) {
+    cases.push_back(
+        {"post_process/" + model_name, 0, post_process_case(model_name)});
+  }
+
+  for (auto &resolution : parse_resolutions(FLAGS_resolutions)) {
+    int width = resolution.first;
+    int height = resolution.second;
+    int64_t pixels = static_cast<int64_t>(width) * height;
+    std::string suffix = "/" + std::to_string(width) + "x" +
+                         std::to_string(height);
+
+    cases.push_back({"bgr_to_nv12" + suffix, pixels, [width, height]() {
+                       cv::Mat bgr = synthetic_bgr(width, height);
+                       return [bgr]() mutable {
+                         cv::Mat nv12;
+                         bgr_to_nv12(bgr, nv12);
+                       };
+                     }});
+
+    cases.push_back({"nhwc_to_nchw" + suffix, pixels, [width, height]() {
+                       cv::Mat bgr = synthetic_bgr(width, height);
+                       std::shared_ptr<std::vector<uint8_t>> planar(
+                           new std::vector<uint8_t>(bgr.total() * 3));
+                       return [bgr, planar, width, height]() {
+                         uint8_t *out = planar->data();
+                         nhwc_to_nchw(out,
+                                      out + width * height,
+                                      out + width * height * 2,
+                                      bgr.data,
+                                      height,
+                                      width);
+                       };
+                     }});
+
+    cases.push_back({"nchw_to_nhwc" + suffix, pixels, [width, height]() {
+                       cv::Mat bgr = synthetic_bgr(width, height);
+                       uint8_t *end = bgr.data + bgr.total() * 3;
+                       std::shared_ptr<std::vector<uint8_t>> planar(
+                           new std::vector<uint8_t>(bgr.data, end));
+                       return [bgr, planar, width, height]() mutable {
+                         uint8_t *in = planar->data();
+                         nchw_to_nhwc(bgr.data,
+                                      in,
+                                      in + width * height,
+                                      in + width * height * 2,
+                                      height,
+                                      width);
+                       };
+                     }});
+
+    cases.push_back({"image_tensor_to_mat" + suffix, pixels, [width, height]() {
+                       auto image_tensor =
+                           synthetic_image_tensor(width, height);
+                       return [image_tensor]() {
+                         cv::Mat mat;
+                         image_tensor_to_mat(image_tensor.get(), mat);
+                       };
+                     }});
+
+    cases.push_back({"draw_perception" + suffix, pixels, [width, height]() {
+                       auto image_tensor =
+                           synthetic_image_tensor(width, height);
+                       std::shared_ptr<Perception> perception(new Perception(
+                           synthetic_perception(FLAGS_detection_num,
+                                                width,
+                                                height)));
+                       return [image_tensor, perception]() {
+                         cv::Mat mat;
+                         draw_perception(
+                             image_tensor.get(), perception.get(), mat);
+                       };
+                     }});
+  }
+
+  cases.push_back(
+      {"client_serialize/" + std::to_string(FLAGS_detection_num),
+       FLAGS_detection_num,
+       []() {
+         // Serialize does not touch the network, Init is not needed
+         std::shared_ptr<ClientOutputModule> output(new ClientOutputModule);
+         auto image_tensor = synthetic_image_tensor(640, 384);
+         std::shared_ptr<Perception> perception(new Perception(
+             synthetic_perception(FLAGS_detection_num, 640, 384)));
+         return [output, image_tensor, perception]() {
+           char *pb = nullptr;
+           int pb_length = 0;
+           ClientOutputBenchmark::Serialize(output.get(),
+                                            image_tensor.get(),
+                                            perception.get(),
+                                            &pb,
+                                            &pb_length);
+           delete[] pb;
+         };
+       }});
+  return cases;
+}
+
+static BenchmarkResult run_case(BenchmarkCase &benchmark_case) {
+  return run_benchmark(benchmark_case.name,
+                       benchmark_case.items,
+                       benchmark_case.setup(),
+                       FLAGS_warmup,
+                       FLAGS_iterations,
+                       FLAGS_min_sample_us);
+}
+
+static std::string to_json(std::vector<BenchmarkResult> &results) {
+  char host[256] = {0};
+  gethostname(host, sizeof(host) - 1);
+  char date[32] = {0};
+  time_t now = time(nullptr);
+  strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+  std::stringstream ss;
+  ss << "{\n  \"context\": {\"date\": \"" << date << "\", \"host\": \""
+     << host << "\", \"yolo5_decode_isa\": \"" << yolo5_decode_isa()
+     << "\", \"iterations\": " << FLAGS_iterations
+     << ", \"min_sample_us\": " << FLAGS_min_sample_us << "},\n"
+     << "  \"benchmarks\": [";
+  for (size_t i = 0; i < results.size(); i++) {
+    auto &result = results[i];
+    ss << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << result.name
+       << "\", \"iterations\": " << result.iterations
+       << ", \"batch\": " << result.batch << ", \"items\": " << result.items
+       << ", \"mean_ms\": " << result.mean_ms
+       << ", \"min_ms\": " << result.min_ms
+       << ", \"max_ms\": " << result.max_ms
+       << ", \"p50_ms\": " << result.p50_ms
+       << ", \"p95_ms\": " << result.p95_ms
+       << ", \"p99_ms\": " << result.p99_ms;
+    if (result.items > 0 && result.mean_ms > 0) {
+      ss << ", \"items_per_second\": "
+         << result.items / (result.mean_ms / 1000.0);
+    }
+    ss << "}";
+  }
+  ss << "\n  ]\n}\n";
+  return ss.str();
+}
+
+int main(int argc, char **argv) {
+  gflags::SetUsageMessage(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging("");
+  FLAGS_logtostderr = true;
+
+  std::vector<BenchmarkResult> results;
+  for (auto &benchmark_case : benchmark_cases()) {
+    if (!FLAGS_filter.empty() &&
+        benchmark_case.name.find(FLAGS_filter) == std::string::npos) {
+      continue;
+    }
+    if (FLAGS_list) {
+      std::cout << benchmark_case.name << std::endl;
+      continue;
+    }
+
+    BenchmarkResult result = run_case(benchmark_case);
+    std::cout << result.name << ": mean:" << result.mean_ms
+              << "ms, p50:" << result.p50_ms << "ms, p95:" << result.p95_ms
+              << "ms, p99:" << result.p99_ms << "ms, batch:" << result.batch
+              << std::endl;
+    results.push_back(result);
+  }
+
+  if (!FLAGS_json_file.empty() && !FLAGS_list) {
+    std::ofstream ofs(FLAGS_json_file);
+    if (!ofs.is_open()) {
+      LOG(ERROR) << "Open " << FLAGS_json_file << " failed";
+      return -1;
+    }
+    ofs << to_json(results);
+    LOG(INFO) << "Results are written to " << FLAGS_json_file;
+  }
+  return 0;
+}
@@ -0,0 +1,105 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+#include "bench_utils.h"
+
+#include <algorithm>
+
+#include "utils/stop_watch.h"
+
+BenchmarkResult run_benchmark(const std::string &name,
+                              int64_t items,
+                              const std::function<void()> &body,
+                              int warmup,
+                              int iterations,
+                              int min_sample_us) {
+  // Calls per sample, so that the microsecond stopwatch resolves fast kernels
+  int batch = 1;
+  for (int i = 0; i < std::max(warmup, 1); i++) {
+    auto start = Stopwatch::CurrentTs();
+    body();
+    auto duration = std::max<u_int64_t>(Stopwatch::CurrentTs() - start, 1);
+    batch = std::max<int>(batch, min_sample_us / duration);
+  }
+
+  Stopwatch watch;
+  for (int i = 0; i < iterations; i++) {
+    watch.Start();
+    for (int k = 0; k < batch; k++) {
+      body();
+    }
+    watch.Stop();
+  }
+
+  BenchmarkResult result;
+  result.name = name;
+  result.items = items;
+  result.batch = batch;
+  result.iterations = watch.TimingCount();
+  result.mean_ms = watch.Duration() / watch.TimingCount() / batch;
+  result.min_ms = watch.Min() / batch;
+  result.max_ms = watch.Max() / batch;
+  result.p50_ms = watch.Percentile(50) / batch;
+  result.p95_ms = watch.Percentile(95) / batch;
+  result.p99_ms = watch.Percentile(99) / batch;
+  return result;
+}
+
+void generate_candidates(int num,
+                         int width,
+                         int height,
+                         int class_num,
+                         std::mt19937 &rng,
+                         std::vector<Detection> &dets) {
+  int object_num = std::max(num / 20, 1);
+  std::uniform_real_distribution<float> x_dist(0, width);
+  std::uniform_real_distribution<float> y_dist(0, height);
+  std::uniform_real_distribution<float> size_dist(8, 96);
+  std::normal_distribution<float> jitter(0, 0.1);
+  std::uniform_real_distribution<float> score_dist(0.05, 1.0);
+  std::uniform_int_distribution<int> object_dist(0, object_num - 1);
+  std::uniform_int_distribution<int> class_dist(0, class_num - 1);
+
+  std::vector<Bbox> objects;
+  std::vector<int> object_ids;
+  for (int i = 0; i < object_num; i++) {
+    float w = size_dist(rng), h = size_dist(rng) * 2;
+    float x = x_dist(rng), y = y_dist(rng);
+    objects.push_back(Bbox(x, y, x + w, y + h));
+    object_ids.push_back(class_dist(rng));
+  }
+
+  dets.clear();
+  for (int i = 0; i < num; i++) {
+    int o = object_dist(rng);
+    auto &box = objects[o];
+    float w = box.xmax - box.xmin, h = box.ymax - box.ymin;
+    float xmin = box.xmin + jitter(rng) * w, ymin = box.ymin + jitter(rng) * h;
+    float xmax = box.xmax + jitter(rng) * w, ymax = box.ymax + jitter(rng) * h;
+    dets.push_back(Detection(
+        object_ids[o], score_dist(rng), Bbox(xmin, ymin, xmax, ymax), ""));
+  }
+}
+
+void fill_yolo_head(int num_pred,
+                    float positive_ratio,
+                    float *data,
+                    int count,
+                    std::mt19937 &rng) {
+  // Background stays below the default score threshold 0.001 (logit -6.9)
+  std::normal_distribution<float> low_obj(-12.0f, 1.5f);
+  std::normal_distribution<float> high_obj(2.0f, 1.0f);
+  std::normal_distribution<float> value(0.0f, 1.5f);
+  std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+  for (int i = 0; i < count; i++) {
+    data[i] = value(rng);
+  }
+  for (int i = 4; i < count; i += num_pred) {
+    data[i] = uniform(rng) < positive_ratio ? high_obj(rng) : low_obj(rng);
+  }
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Synthetic data & timing shared by bench_common, nms_benchmark and
+// yolo5_decode_benchmark
+
+#ifndef _BENCH_UTILS_H_
+#define _BENCH_UTILS_H_
+
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "base/perception_common.h"
+
+struct BenchmarkResult {
+  std::string name;
+  int64_t items;
+  int batch;
+  int iterations;
+  float mean_ms;
+  float min_ms;
+  float max_ms;
+  float p50_ms;
+  float p95_ms;
+  float p99_ms;
+};
+
+/**
+ * Time body, fast bodies are repeated within a sample until it takes
+ * min_sample_us, reported times are per call
+ * @param[in] name: case name
+ * @param[in] items: items processed per call, 0 if not meaningful
+ * @param[in] body: timed body
+ * @param[in] warmup: untimed samples before timing, at least one
+ * @param[in] iterations: timed samples
+ * @param[in] min_sample_us: min sample duration, 0 for one call per sample
+ * @return timing result
+ */
+BenchmarkResult run_benchmark(const std::string &name,
+                              int64_t items,
+                              const std::function<void()> &body,
+                              int warmup,
+                              int iterations,
+                              int min_sample_us);
+
+/**
+ * Candidates around random objects, like the decoder output of a crowd
+ * @param[in] num: candidate count
+ * @param[in] width: image width
+ * @param[in] height: image height
+ * @param[in] class_num: class number
+ * @param[in] rng: random generator
+ * @param[out] dets: candidates
+ */
+void generate_candidates(int num,
+                         int width,
+                         int height,
+                         int class_num,
+                         std::mt19937 &rng,
+                         std::vector<Detection> &dets);
+
+/**
+ * YOLO head of (x, y, w, h, objectness, classes...) per anchor, few
+ * anchors have a high objectness like a real frame
+ * @param[in] num_pred: values per anchor
+ * @param[in] positive_ratio: ratio of anchors with high objectness
+ * @param[out] data: head data
+ * @param[in] count: float count of data
+ * @param[in] rng: random generator
+ */
+void fill_yolo_head(int num_pred,
+                    float positive_ratio,
+                    float *data,
+                    int count,
+                    std::mt19937 &rng);
+
+#endif  // _BENCH_UTILS_H_
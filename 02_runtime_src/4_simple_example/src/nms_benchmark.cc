@@ -0,0 +1,114 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Compare NMS implementations on synthetic clustered candidates,
+// sweeping the candidate count.
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "bench_utils.h"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "utils/nms.h"
+#include "utils/utils.h"
+
+DEFINE_string(candidate_nums,
+              "100,500,1000,5000,10000,50000",
+              "Candidate counts to sweep, separated by comma");
+DEFINE_string(nms_impls,
+              "default,grid,simd",
+              "NMS implementations to compare");
+DEFINE_int32(iterations, 10, "Iterations of every candidate count");
+DEFINE_int32(class_num, 3, "Class number");
+DEFINE_double(iou_threshold, 0.45, "IoU threshold");
+DEFINE_int32(top_k, 5000, "Max output count");
+DEFINE_int32(image_width, 640, "Image width");
+DEFINE_int32(image_height, 512, "Image height");
+
+static bool same_result(std::vector<Detection> &lhs,
+                        std::vector<Detection> &rhs) {
+  if (lhs.size() != rhs.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < lhs.size(); i++) {
+    if (lhs[i].id != rhs[i].id || lhs[i].score != rhs[i].score ||
+        lhs[i].bbox.xmin != rhs[i].bbox.xmin ||
+        lhs[i].bbox.ymin != rhs[i].bbox.ymin) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  gflags::SetUsageMessage(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging("");
+  FLAGS_logtostderr = true;
+
+  std::vector<NmsImpl> impls;
+  std::vector<std::string> impl_names;
+  split(FLAGS_nms_impls, ',', impl_names);
+  for (auto &name : impl_names) {
+    NmsImpl impl;
+    if (parse_nms_impl(name, &impl) != 0) {
+      return -1;
+    }
+    impls.push_back(impl);
+  }
+
+  std::vector<std::string> nums;
+  split(FLAGS_candidate_nums, ',', nums);
+
+  bool all_match = true;
+  std::mt19937 rng(0);
+  for (auto &num_str : nums) {
+    int num = std::stoi(num_str);
+    std::vector<Detection> candidates;
+    generate_candidates(num,
+                        FLAGS_image_width,
+                        FLAGS_image_height,
+                        FLAGS_class_num,
+                        rng,
+                        candidates);
+
+    std::vector<std::vector<Detection>> results(impls.size());
+    std::cout << "candidates:" << num;
+    for (size_t k = 0; k < impls.size(); k++) {
+      auto &result = results[k];
+      auto impl = impls[k];
+      // Some implementations sort the input in place, the copy is timed
+      // for every implementation alike
+      auto benchmark = run_benchmark(
+          impl_names[k],
+          num,
+          [&candidates, &result, impl]() {
+            std::vector<Detection> input = candidates;
+            result.clear();
+            run_nms(impl,
+                    input,
+                    FLAGS_iou_threshold,
+                    FLAGS_top_k,
+                    result,
+                    false);
+          },
+          1,
+          FLAGS_iterations,
+          0);
+      bool match = same_result(results[0], results[k]);
+      all_match = all_match && match;
+      std::cout << ", " << impl_names[k] << ":" << benchmark.mean_ms << "ms"
+                << " (kept " << results[k].size()
+                << (match ? "" : ", MISMATCH") << ")";
+    }
+    std::cout << std::endl;
+  }
+  return all_match ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Feed model outputs captured by the pipeline (--capture_file of example)
+// through a post process module in a loop and report per-frame latency.
+
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "bpu_predict_extension.h"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "pipeline/tensor_capture.h"
+#include "post_process/post_process.h"
+#include "utils/stop_watch.h"
+
+#define EMPTY ""
+
+DEFINE_string(capture_file, EMPTY, "Tensor capture written by the pipeline");
+DEFINE_string(model_name, EMPTY, "Model name of the post process module");
+DEFINE_string(post_process_config_string,
+              EMPTY,
+              "Json config for post process module");
+DEFINE_string(post_process_config_file,
+              EMPTY,
+              "Json config file for post process module");
+DEFINE_int32(loop_count, 10, "Times every captured frame is post processed");
+DEFINE_int32(frame_count, -1, "Max frames read from capture, -1 for all");
+DEFINE_bool(print_result, false, "Log perception of the first loop");
+
+/**
+ * Captured frame with its outputs copied into BPU memory
+ */
+struct ReplayFrame {
+  CaptureFrame capture;
+  std::vector<BPU_TENSOR_S> output_tensors;
+};
+
+int main(int argc, char **argv) {
+  gflags::SetUsageMessage(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging("");
+  FLAGS_logtostderr = true;
+
+  TensorCaptureReader reader;
+  if (reader.Open(FLAGS_capture_file) != 0) {
+    return -1;
+  }
+
+  // Load every frame up front so only post process is timed
+  std::vector<ReplayFrame> frames;
+  while (FLAGS_frame_count < 0 ||
+         frames.size() < static_cast<size_t>(FLAGS_frame_count)) {
+    // Read in place, captured tensors point into capture.output_data
+    frames.emplace_back();
+    ReplayFrame &frame = frames.back();
+    if (reader.Read(&frame.capture) != 0) {
+      frames.pop_back();
+      break;
+    }
+    for (auto &captured : frame.capture.output_tensors) {
+      BPU_TENSOR_S tensor = captured;
+      int ret_code = HB_SYS_bpuMemAlloc(
+          "replay_out", captured.data.memSize, true, &tensor.data);
+      LOG_IF(FATAL, ret_code != 0)
+          << "Alloc output tensor failed:" << HB_BPU_getErrorName(ret_code);
+      frame.output_tensors.push_back(tensor);
+    }
+  }
+  if (frames.empty()) {
+    LOG(ERROR) << FLAGS_capture_file << " has no frame";
+    return -1;
+  }
+  LOG(INFO) << "Replay " << frames.size() << " frames with "
+            << reader.OutputNum() << " outputs, " << FLAGS_loop_count
+            << " loops";
+
+  PostProcessModule *post_process_module =
+      PostProcessModule::GetImpl(FLAGS_model_name);
+  if (post_process_module->Init(FLAGS_post_process_config_file,
+                                FLAGS_post_process_config_string) != 0) {
+    LOG(ERROR) << "Init post process module failed";
+    return -1;
+  }
+
+  Stopwatch watch;
+  for (int loop = 0; loop < FLAGS_loop_count; loop++) {
+    for (auto &frame : frames) {
+      // Post process modules may decode in place, start from the capture
+      for (size_t i = 0; i < frame.output_tensors.size(); i++) {
+        auto &tensor = frame.output_tensors[i];
+        memcpy(tensor.data.virAddr,
+               frame.capture.output_data[i].data(),
+               tensor.data.memSize);
+        HB_SYS_flushMemCache(&tensor.data, HB_SYS_MEM_CACHE_CLEAN);
+      }
+
+      Perception perception;
+      auto start = Stopwatch::CurrentTs();
+      post_process_module->PostProcess(frame.output_tensors.data(),
+                                       &frame.capture.image_tensor,
+                                       &perception);
+      watch.Record(Stopwatch::CurrentTs() - start);
+
+      LOG_IF(INFO, FLAGS_print_result && loop == 0)
+          << "Image:" << frame.capture.image_tensor.image_name
+          << ", infer result:" << perception;
+    }
+  }
+
+  std::cout << "frames:" << watch.TimingCount()
+            << ", average:" << watch.Average()
+            << "ms, p50:" << watch.Percentile(50)
+            << "ms, p90:" << watch.Percentile(90)
+            << "ms, p99:" << watch.Percentile(99) << "ms, max:" << watch.Max()
+            << "ms" << std::endl;
+
+  for (auto &frame : frames) {
+    for (auto &tensor : frame.output_tensors) {
+      HB_SYS_bpuMemFree(&tensor.data);
+    }
+  }
+  delete post_process_module;
+  return 0;
+}
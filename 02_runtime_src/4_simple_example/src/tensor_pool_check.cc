@@ -0,0 +1,168 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Check TensorPool acquire, recycle and reuse, exit code is the number of
+// failed checks. BPU memory comes from HB_SYS_bpuMemAlloc, which is
+// bpu_stub on x86 with PLATFORM=stub.
+
+#include <vector>
+
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "utils/tensor_utils.h"
+
+static int failed_count = 0;
+
+#define EXPECT(condition)                                    \
+  do {                                                       \
+    if (!(condition)) {                                      \
+      LOG(ERROR) << "Line " << __LINE__ << ": " #condition;  \
+      failed_count++;                                        \
+    }                                                        \
+  } while (0)
+
+/**
+ * Default allocator counting live allocations
+ */
+struct CountingAllocator {
+  BpuMemAllocator allocator;
+  int alloc_count = 0;
+  int free_count = 0;
+
+  CountingAllocator() {
+    BpuMemAllocator base = default_bpu_mem_allocator();
+    allocator.alloc = [this, base](const char *name,
+                                   int size,
+                                   bool cachable,
+                                   BPU_MEMORY_S *mem) {
+      alloc_count++;
+      return base.alloc(name, size, cachable, mem);
+    };
+    allocator.free = [this, base](BPU_MEMORY_S *mem) {
+      free_count++;
+      return base.free(mem);
+    };
+  }
+
+  int Live() { return alloc_count - free_count; }
+};
+
+static void init_tensor(BPU_TENSOR_S *tensor, int height, int width) {
+  *tensor = {};
+  tensor->data_type = BPU_TYPE_TENSOR_F32;
+  tensor->data_shape.layout = BPU_LAYOUT_NHWC;
+  tensor->data_shape.ndim = 4;
+  tensor->data_shape.d[0] = 1;
+  tensor->data_shape.d[1] = height;
+  tensor->data_shape.d[2] = width;
+  tensor->data_shape.d[3] = 1;
+  tensor->aligned_shape = tensor->data_shape;
+}
+
+static void check_reuse() {
+  CountingAllocator counter;
+  {
+    TensorPool pool(counter.allocator);
+    BPU_TENSOR_S tensor;
+    init_tensor(&tensor, 16, 16);
+    EXPECT(pool.Acquire(&tensor, 16 * 16 * 4) == 0);
+    EXPECT(tensor.data.virAddr != nullptr);
+    EXPECT(pool.MissCount() == 1 && pool.HitCount() == 0);
+    void *first_addr = tensor.data.virAddr;
+    pool.Recycle(&tensor);
+
+    // Same key, the recycled buffer is handed out again
+    init_tensor(&tensor, 16, 16);
+    EXPECT(pool.Acquire(&tensor, 16 * 16 * 4) == 0);
+    EXPECT(tensor.data.virAddr == first_addr);
+    EXPECT(pool.MissCount() == 1 && pool.HitCount() == 1);
+    EXPECT(counter.alloc_count == 1);
+
+    // Other shape or size misses while the first buffer is in use
+    BPU_TENSOR_S other;
+    init_tensor(&other, 16, 32);
+    EXPECT(pool.Acquire(&other, 16 * 32 * 4) == 0);
+    EXPECT(other.data.virAddr != first_addr);
+    EXPECT(pool.MissCount() == 2);
+    pool.Recycle(&other);
+    pool.Recycle(&tensor);
+    EXPECT(counter.Live() == 2);
+
+    pool.Clear();
+    EXPECT(counter.Live() == 0);
+  }
+  EXPECT(counter.Live() == 0);
+}
+
+static void check_max_cached() {
+  CountingAllocator counter;
+  {
+    TensorPool pool(counter.allocator, 2);
+    std::vector<BPU_TENSOR_S> tensors(4);
+    for (auto &tensor : tensors) {
+      init_tensor(&tensor, 8, 8);
+      EXPECT(pool.Acquire(&tensor, 8 * 8 * 4) == 0);
+    }
+    EXPECT(counter.Live() == 4);
+    // Only max_cached buffers are kept, the rest are freed on recycle
+    for (auto &tensor : tensors) {
+      pool.Recycle(&tensor);
+    }
+    EXPECT(counter.Live() == 2);
+  }
+  EXPECT(counter.Live() == 0);
+}
+
+static void check_foreign_memory() {
+  CountingAllocator counter;
+  TensorPool pool(counter.allocator);
+  BPU_TENSOR_S tensor;
+  init_tensor(&tensor, 4, 4);
+  EXPECT(HB_SYS_bpuMemAlloc("foreign", 4 * 4 * 4, true, &tensor.data) == 0);
+  // Not from the pool, freed instead of cached
+  pool.Recycle(&tensor);
+  EXPECT(counter.free_count == 1);
+  EXPECT(pool.HitCount() == 0 && pool.MissCount() == 0);
+}
+
+static void check_image_tensor() {
+  CountingAllocator counter;
+  {
+    TensorPool pool(counter.allocator);
+    BPU_TENSOR_S tensor;
+    for (int i = 0; i < 3; i++) {
+      prepare_image_tensor(64, 96, BPU_TYPE_IMG_NV12_SEPARATE, &tensor, &pool);
+      EXPECT(tensor.data.virAddr != nullptr);
+      EXPECT(tensor.data_ext.virAddr != nullptr);
+      release_tensor(&tensor, &pool);
+    }
+    // Y and UV planes are allocated once
+    EXPECT(counter.alloc_count == 2);
+    EXPECT(pool.MissCount() == 1 && pool.HitCount() == 2);
+  }
+  EXPECT(counter.Live() == 0);
+}
+
+int main(int argc, char **argv) {
+  gflags::SetUsageMessage(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_logtostderr = true;
+
+  check_reuse();
+  check_max_cached();
+  check_foreign_memory();
+  check_image_tensor();
+
+  if (failed_count == 0) {
+    LOG(INFO) << "Tensor pool check passed";
+  } else {
+    LOG(ERROR) << failed_count << " tensor pool checks failed";
+  }
+  return failed_count;
+}
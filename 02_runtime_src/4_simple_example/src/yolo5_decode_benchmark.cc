@@ -0,0 +1,120 @@
+// Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+//
+// The material in this file is confidential and contains trade secrets
+// of Horizon Robotics Inc. This is proprietary information owned by
+// Horizon Robotics Inc. No part of this work may be disclosed,
+// reproduced, copied, transmitted, or used in any way for any purpose,
+// without the express written permission of Horizon Robotics Inc.
+
+// Compare yolo5_decode_reference and yolo5_decode on synthetic
+// 84x84 / 42x42 / 21x21 heads (672x672 input, strides 8 / 16 / 32).
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "bench_utils.h"
+#include "gflags/gflags.h"
+#include "glog/logging.h"
+#include "post_process/yolo5_decode.h"
+
+DEFINE_int32(iterations, 200, "Decode iterations of every implementation");
+DEFINE_int32(class_num, 3, "Class number");
+DEFINE_double(score_threshold, 0.3, "Score threshold");
+DEFINE_double(positive_ratio,
+              0.005,
+              "Ratio of anchors with high objectness in synthetic data");
+DEFINE_int32(input_size, 672, "Model input size");
+
+int main(int argc, char **argv) {
+  gflags::SetUsageMessage(argv[0]);
+  gflags::ParseCommandLineFlags(&argc, &argv, true);
+  google::InitGoogleLogging("");
+  FLAGS_logtostderr = true;
+
+  std::vector<int> strides{8, 16, 32};
+  std::vector<std::vector<std::pair<double, double>>> anchors_table{
+      {{10, 13}, {16, 30}, {33, 23}},
+      {{30, 61}, {62, 45}, {59, 119}},
+      {{116, 90}, {156, 198}, {373, 326}}};
+  std::vector<std::string> class_names;
+  for (int i = 0; i < FLAGS_class_num; i++) {
+    class_names.push_back("class_" + std::to_string(i));
+  }
+  int num_pred = FLAGS_class_num + 4 + 1;
+
+  std::mt19937 rng(0);
+  std::vector<std::vector<float>> heads(strides.size());
+  std::vector<Yolo5DecodeParam> params(strides.size());
+  for (size_t i = 0; i < strides.size(); i++) {
+    auto &param = params[i];
+    param.height = FLAGS_input_size / strides[i];
+    param.width = FLAGS_input_size / strides[i];
+    param.stride = strides[i];
+    param.anchors = &anchors_table[i];
+    param.class_num = FLAGS_class_num;
+    param.class_names = &class_names;
+    param.score_threshold = FLAGS_score_threshold;
+    param.ori_width = FLAGS_input_size;
+    param.ori_height = FLAGS_input_size;
+    heads[i].resize(param.height * param.width * anchors_table[i].size() *
+                    num_pred);
+    fill_yolo_head(num_pred,
+                   FLAGS_positive_ratio,
+                   heads[i].data(),
+                   heads[i].size(),
+                   rng);
+  }
+
+  std::vector<Detection> reference_dets;
+  std::vector<Detection> dets;
+  auto reference = run_benchmark(
+      "reference",
+      0,
+      [&]() {
+        reference_dets.clear();
+        for (size_t i = 0; i < strides.size(); i++) {
+          yolo5_decode_reference(heads[i].data(), params[i], reference_dets);
+        }
+      },
+      1,
+      FLAGS_iterations,
+      0);
+  auto decode = run_benchmark(
+      "simd",
+      0,
+      [&]() {
+        dets.clear();
+        for (size_t i = 0; i < strides.size(); i++) {
+          yolo5_decode(heads[i].data(), params[i], dets);
+        }
+      },
+      1,
+      FLAGS_iterations,
+      0);
+
+  // Same anchors in the same order, boxes differ only by float rounding
+  float max_diff = 0;
+  bool match = reference_dets.size() == dets.size();
+  for (size_t i = 0; match && i < dets.size(); i++) {
+    match = reference_dets[i].id == dets[i].id;
+    max_diff = std::max(
+        max_diff, std::abs(reference_dets[i].bbox.xmin - dets[i].bbox.xmin));
+    max_diff = std::max(
+        max_diff, std::abs(reference_dets[i].bbox.ymax - dets[i].bbox.ymax));
+  }
+
+  std::cout << "isa:" << yolo5_decode_isa()
+            << ", detections:" << dets.size()
+            << ", reference detections:" << reference_dets.size()
+            << ", match:" << (match ? "true" : "false")
+            << ", max box diff:" << max_diff << std::endl
+            << "reference decode: mean:" << reference.mean_ms
+            << "ms, p50:" << reference.p50_ms << "ms, p99:" << reference.p99_ms
+            << "ms" << std::endl
+            << "simd decode: mean:" << decode.mean_ms << "ms, p50:"
+            << decode.p50_ms << "ms, p99:" << decode.p99_ms << "ms"
+            << std::endl
+            << "speedup:" << reference.mean_ms / decode.mean_ms << std::endl;
+  return match ? 0 : 1;
+}
@@ -0,0 +1,117 @@
+# Copyright (c) 2020 Horizon Robotics.All Rights Reserved.
+#
+# The material in this file is confidential and contains trade secrets
+# of Horizon Robotics Inc. This is proprietary information owned by
+# Horizon Robotics Inc. No part of this work may be disclosed,
+# reproduced, copied, transmitted, or used in any way for any purpose,
+# without the express written permission of Horizon Robotics Inc.
+
+# Pack the .bin files of a preprocessed image list or feature list into one
+# file for the `packed` data iterator, layout is in input/packed_dataset.h
+
+import functools
+import os
+import struct
+from absl import flags
+from absl import logging
+from absl import app
+
+FLAGS = flags.FLAGS
+
+flags.DEFINE_string(
+    'input_list_file', None,
+    help='List of .bin files, one per line, same as image_list_file of '
+    'preprocessed_image or feature_list_file of feature iterator')
+flags.DEFINE_enum(
+    'kind', 'image', ['image', 'feature'],
+    help='image: {name}_{org_h}_{org_w}_{dst_h}_{dst_w}.bin, '
+    'feature: {name}_{dim0}_{dim1}_{...}.bin')
+flags.DEFINE_string('output_file', None, help='Output pack file')
+flags.DEFINE_integer(
+    'feature_ndim', 4,
+    help='Dim count at the end of feature file names, the name itself may '
+    'contain _')
+flags.DEFINE_bool(
+    'pad_resize', True,
+    help='Images are resized keeping aspect ratio and padded, like '
+    'PadResizeTransformer of the yolo preprocessing')
+
+MAGIC = 0x4b503358
+VERSION = 2
+RECORD_ALIGN = 64
+MAX_DIMS = 8
+NAME_SIZE = 128
+KINDS = {'image': 0, 'feature': 1}
+FLAG_PAD_RESIZE = 1 << 0
+
+# PackedHeader: magic, version, kind, record_count, index_offset, reserved
+HEADER = struct.Struct('<IIIIQ40x')
+# PackedRecord: offset, size, ori_height, ori_width, ndim, dims, name, flags
+RECORD = struct.Struct('<QQiii%di%dsi' % (MAX_DIMS, NAME_SIZE))
+
+
+def parse_image_name(file_name):
+    # {name}_{org_h}_{org_w}_{dst_h}_{dst_w}.bin
+    tokens = os.path.splitext(file_name)[0].rsplit('_', 4)
+    name = tokens[0]
+    org_h, org_w, dst_h, dst_w = [int(t) for t in tokens[1:]]
+    return name, org_h, org_w, [dst_h, dst_w]
+
+
+def parse_feature_name(file_name, ndim):
+    # {name}_{dim0}_{dim1}_{...}.bin
+    tokens = os.path.splitext(file_name)[0].rsplit('_', ndim)
+    if len(tokens) != ndim + 1:
+        logging.fatal('{} does not end with {} dims'.format(file_name, ndim))
+    return tokens[0], 0, 0, [int(t) for t in tokens[1:]]
+
+
+def pack_dataset(input_list_file, kind, output_file, pad_resize,
+                 feature_ndim):
+    with open(input_list_file) as f:
+        files = [line.strip() for line in f if line.strip()]
+
+    if kind == 'image':
+        parse = parse_image_name
+    else:
+        parse = functools.partial(parse_feature_name, ndim=feature_ndim)
+    record_flags = FLAG_PAD_RESIZE if kind == 'image' and pad_resize else 0
+    records = []
+    with open(output_file, 'wb') as w:
+        w.write(bytes(HEADER.size))
+        for path in files:
+            name, org_h, org_w, dims = parse(os.path.basename(path))
+            if len(dims) > MAX_DIMS:
+                logging.fatal('{} has more than {} dims'.format(path, MAX_DIMS))
+            name = name.encode()[:NAME_SIZE - 1]
+
+            offset = w.tell()
+            with open(path, 'rb') as r:
+                data = r.read()
+            w.write(data)
+            w.write(bytes(-w.tell() % RECORD_ALIGN))
+            records.append(
+                RECORD.pack(offset, len(data), org_h, org_w, len(dims),
+                            *(dims + [0] * (MAX_DIMS - len(dims))), name,
+                            record_flags))
+
+        index_offset = w.tell()
+        for record in records:
+            w.write(record)
+        w.seek(0)
+        w.write(
+            HEADER.pack(MAGIC, VERSION, KINDS[kind], len(records),
+                        index_offset))
+    logging.info('Packed {} records into {}'.format(len(records), output_file))
+
+
+def main(_):
+    logging.set_verbosity(logging.INFO)
+    pack_dataset(FLAGS.input_list_file, FLAGS.kind, FLAGS.output_file,
+                 FLAGS.pad_resize, FLAGS.feature_ndim)
+
+
+if __name__ == "__main__":
+    flags.mark_flag_as_required('input_list_file')
+    flags.mark_flag_as_required('output_file')
+    app.run(main)
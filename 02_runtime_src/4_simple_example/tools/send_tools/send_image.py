@@ -17,8 +17,13 @@ import time
 import ast
 import os
 import argparse
+import struct
 from data_loader import *
 
+# Optional first part of a message, the receiver takes frame id & capture
+# timestamp (us) of the frame from it
+FRAME_HEADER_MAGIC = b'HBFH'
+
 
 class ZmqSenderClient:
     def __init__(self, end_point):
@@ -31,8 +36,8 @@ class ZmqSenderClient:
         self.socket.close()
         self.context.destroy()
 
-    def send_image_msg(self, img, image_name, image_type, org_h, org_w, dst_h,
-                       dst_w):
+    @staticmethod
+    def image_msg(img, image_name, image_type, org_h, org_w, dst_h, dst_w):
         zmq_msg = zmq_msg_pb2.ZMQMsg()
         image_msg = zmq_msg.img_msg
         image_msg.image_data = img.tobytes()
@@ -43,11 +48,44 @@ class ZmqSenderClient:
         image_msg.image_dst_width = dst_w
         image_msg.image_dst_height = dst_h
         zmq_msg.msg_type = zmq_msg_pb2.ZMQMsg.IMAGE_MSG
+        return zmq_msg.SerializeToString()
+
+    @staticmethod
+    def frame_header(frame_id, timestamp):
+        return struct.pack('<4siQ', FRAME_HEADER_MAGIC, frame_id, timestamp)
 
-        msg = zmq_msg.SerializeToString()
+    def send_image_msg(self, img, image_name, image_type, org_h, org_w, dst_h,
+                       dst_w, frame_id, timestamp):
+        msgs = [
+            self.frame_header(frame_id, timestamp),
+            self.image_msg(img, image_name, image_type, org_h, org_w, dst_h,
+                           dst_w)
+        ]
         while True:
             try:
-                self.socket.send(msg, zmq.NOBLOCK)
+                self.socket.send_multipart(msgs, zmq.NOBLOCK)
+                break
+            except zmq.ZMQError:
+                continue
+        return 0
+
+    def send_pair_msg(self, visible, lwir, image_type, lwir_image_type,
+                      frame_id, timestamp):
+        """
+        Send visible & lwir images of one frame as a three part message,
+        frame header first, each of visible and lwir is (data, image_name,
+        org_h, org_w, dst_h, dst_w)
+        """
+        msgs = [self.frame_header(frame_id, timestamp)]
+        for (data, image_name, org_h, org_w, dst_h,
+             dst_w), part_image_type in [(visible, image_type),
+                                         (lwir, lwir_image_type)]:
+            msgs.append(
+                self.image_msg(data, image_name, part_image_type, org_h,
+                               org_w, dst_h, dst_w))
+        while True:
+            try:
+                self.socket.send_multipart(msgs, zmq.NOBLOCK)
                 break
             except zmq.ZMQError:
                 continue
@@ -66,8 +104,31 @@ class ZmqSenderClient:
                 continue
 
 
+def load_image(input_file_path, file_name, algo_name, is_input_preprocessed,
+               image_type):
+    path = os.path.join(input_file_path, file_name)
+    if os.path.isdir(path):
+        print("input path contains a dir !!!")
+        return None
+    if not is_input_preprocessed:
+        org_h, org_w, dst_h, dst_w, data = image_loader(
+            path, algo_name, image_type)
+        image_name = file_name.encode('utf-8')
+    else:
+        res = str.split(file_name, '_')
+        data = np.fromfile(path, dtype=np.float32)
+        # {name}_{org_h}_{org_w}_{dst_h}_{dst_w}.bin
+        image_name = '_'.join(res[:-4]).encode('utf-8')
+        org_h = int(res[-4])
+        org_w = int(res[-3])
+        dst_h = int(res[-2])
+        dst_w = int(res[-1].split('.')[0])
+    return data, image_name, org_h, org_w, dst_h, dst_w
+
+
 def send_images(ip, algo_name, input_file_path, is_input_preprocessed,
-                image_count, image_type):
+                image_count, image_type, lwir_file_path=None,
+                lwir_image_type=None):
     end_point = "tcp://" + ip + ":6680"
 
     print("start to send data to %s ..." % end_point)
@@ -75,6 +136,11 @@ def send_images(ip, algo_name, input_file_path, is_input_preprocessed,
     zmq_sender = ZmqSenderClient(end_point)
 
     paths = os.listdir(input_file_path)  # 列出文件夹下所有的目录
+    if lwir_file_path:
+        # lwir image of a pair has the same file name as the visible one
+        paths = sorted(paths)
+        if lwir_image_type is None:
+            lwir_image_type = image_type
 
     if image_count > len(paths):
         print('image count is too large')
@@ -84,31 +150,27 @@ def send_images(ip, algo_name, input_file_path, is_input_preprocessed,
     path_list = np.arange(image_count)
     current_count = 0
     for i in path_list:
-        path = os.path.join(input_file_path, paths[i])
-        if os.path.isdir(path):
-            print("input path contains a dir !!!")
+        visible = load_image(input_file_path, paths[i], algo_name,
+                             is_input_preprocessed, image_type)
+        if visible is None:
             return
-        if not is_input_preprocessed:
-            org_h, org_w, dst_h, dst_w, data = image_loader(
-                path, algo_name, image_type)
-            image_name = paths[i].encode('utf-8')
-        else:
-            res = str.split(paths[i], '_')
-            data = np.fromfile(path, dtype=np.float32)
-            # {name}_{org_h}_{org_w}_{dst_h}_{dst_w}.bin
-            image_name = '_'.join(res[:-4]).encode('utf-8')
-            org_h = int(res[-4])
-            org_w = int(res[-3])
-            dst_h = int(res[-2])
-            dst_w = int(res[-1].split('.')[0])
         t = time.time()
         start_time = int(round(t * 1000))
-        zmq_sender.send_image_msg(data, image_name, image_type, org_h, org_w,
-                                  dst_h, dst_w)
+        timestamp = int(t * 1000000)
+        if lwir_file_path:
+            lwir = load_image(lwir_file_path, paths[i], algo_name,
+                              is_input_preprocessed, lwir_image_type)
+            if lwir is None:
+                return
+            zmq_sender.send_pair_msg(visible, lwir, image_type,
+                                     lwir_image_type, int(i), timestamp)
+        else:
+            zmq_sender.send_image_msg(visible[0], visible[1], image_type,
+                                      *visible[2:], int(i), timestamp)
         end_time = int(round(t * 1000))
         current_count = current_count + 1
         print(
-            current_count, 'image name is: %s' % image_name.decode('utf-8'),
+            current_count, 'image name is: %s' % visible[1].decode('utf-8'),
             ' send image data message done, take %d ms' %
             (end_time - start_time))
     zmq_sender.over()
@@ -150,9 +212,23 @@ if __name__ == "__main__":
     parser.add_argument(
         '--image-type', type=int, required=False, help='image type')
 
+    parser.add_argument(
+        '--lwir-file-path',
+        type=str,
+        required=False,
+        help='lwir files dir path, if set every visible file is sent with '
+        'the lwir file of the same name as one pair')
+
+    parser.add_argument(
+        '--lwir-image-type',
+        type=int,
+        required=False,
+        help='image type of lwir files, same as --image-type by default')
+
     args = parser.parse_args()
 
     print(args)
     # TODO random seed
     send_images(args.ip, args.algo_name, args.input_file_path,
-                args.is_input_preprocessed, args.image_count, args.image_type)
+                args.is_input_preprocessed, args.image_count, args.image_type,
+                args.lwir_file_path, args.lwir_image_type)